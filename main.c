@@ -6,6 +6,10 @@
  * 支持Windows和Linux平台
  */
 
+#ifndef _WIN32
+#define _GNU_SOURCE // 用于pthread_setaffinity_np和CPU_SET等接口
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,8 +20,19 @@
 #include <locale.h>
 #include <math.h>
 #include <stdint.h>
+#include <stdatomic.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(_WIN32)
+#include <immintrin.h> // AVX2/AVX-512 FMA内核
+#endif
 
 #ifdef _WIN32
+#include <winsock2.h> // 必须在windows.h之前
+#include <ws2tcpip.h>
 #include <windows.h>
 #include <psapi.h>
 #include <process.h>
@@ -25,12 +40,23 @@
 #include <tlhelp32.h> // 用于Process32First/Next函数
 #else
 #include <pthread.h>
+#include <sched.h>
 #include <sys/resource.h>
 #include <sys/sysinfo.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/times.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <errno.h> // 用于strerror函数
 #endif
@@ -53,16 +79,128 @@ double pid_kp = 1.5;  // 比例系数(增强以加强响应)
 double pid_ki = 0.3;  // 积分系数(增加积分作用加强长期误差修正)
 double pid_kd = 0.05; // 微分系数(降低微分作用减少阻尼)
 double filter_alpha = 0.5; // 低通滤波系数(增加以更快响应变化)
+double cpu_share_scale = 1.0; // 每个工作线程份额对应的核心数，按cgroup计算时为 容量/工作线程数
 bool verbose_mode = false; // 详细输出模式
 int update_interval = 1;   // 状态更新间隔（秒）
 bool save_config = false;  // 是否保存配置
 char config_file[256] = "cmm.conf"; // 配置文件名
+long long cycle_period_us = 5000; // 工作线程PWM周期(微秒)
+bool phase_stagger = false;       // 工作线程相位错开，避免同时唤醒
+unsigned long long pwm_epoch_ns = 0; // 所有工作线程共用的截止时间网格原点
+int burn_kernel_index = 0;        // 工作线程使用的CPU占用内核(burn_kernels中的序号)
+bool ballast_mlock = false;       // 锁定压载内存，防止被换出
+int ballast_fill_mode = 0;        // 压载内容填充方式(FILL_RANDOM/FILL_TOUCH)
+int ballast_backing = 0;          // 压载区的内存来源(BALLAST_ANON/BALLAST_MEMFD)
+bool ballast_unmergeable = false; // 将压载区标记为MADV_UNMERGEABLE，禁止KSM合并
+int fill_threads = 0;             // 压载填充线程数(0表示自动)
+int worker_sched = 0;             // 工作线程调度策略(WORKER_SCHED_*)
+double probe_hz = 0.0;            // 唤醒延迟探针频率(0表示不启用)
+double backoff_stall_ms = 0.0;    // 压力退让阈值: 每500ms窗口内其他任务的CPU等待时间(毫秒，0表示不启用)
+double mem_backoff_stall_ms = 0.0; // 内存压力释放阈值: 每500ms窗口内的内存等待时间(毫秒，0表示不启用)
+int metrics_port = 0;             // Prometheus指标导出端口(0表示不启用)
+char metrics_addr[64] = "127.0.0.1"; // 指标导出监听地址，默认只监听回环地址
 
-#ifdef _WIN32
-CRITICAL_SECTION cpu_load_cs;
-#else
-pthread_mutex_t cpu_load_mutex = PTHREAD_MUTEX_INITIALIZER;
-#endif
+// 核心分组目标，例如 "0-7:80,8-63:20"
+#define MAX_CPU_GROUPS 64
+typedef struct {
+    int first_cpu;  // 起始CPU编号
+    int last_cpu;   // 结束CPU编号(包含)
+    int target;     // 该组目标使用率(%)
+} cpu_group_t;
+
+cpu_group_t cpu_groups[MAX_CPU_GROUPS];
+int num_cpu_groups = 0;
+char cpu_groups_spec[256] = ""; // 原始分组配置字符串，用于保存配置
+
+// 发布给指标导出和状态画面的核心控制状态
+enum {
+    CORE_STAT_USAGE, CORE_STAT_FILTERED, CORE_STAT_EXTERNAL, CORE_STAT_SETPOINT, CORE_STAT_BUSY,
+    CORE_STAT_OWN, CORE_STAT_FEED_FORWARD, CORE_STAT_INTEGRAL, CORE_STAT_TRIM, CORE_STAT_ERROR,
+    CORE_STAT_COMMANDED, CORE_STATS
+};
+
+// 单个核心的控制状态，每个工作线程绑定一个核心
+typedef struct {
+    int cpu_id;               // 绑定的逻辑CPU编号
+    double target;            // 该核心的目标使用率(%)
+    double setpoint;          // 重新分配后的实际设定值(%)
+    double usage;             // 最近一次采样的使用率(%)
+    double filtered;          // 滤波后的使用率(%)
+    double integral;          // PID积分项
+    double feed_forward;      // 前馈项: 设定值减外部负载(%)
+    double trim;              // PID比例和微分修正(%)
+    double prev_error;        // PID上次误差
+    double busy;              // 繁忙百分比(0-100)
+    double own;               // 本核心工作线程实际消耗的CPU(%)
+    double commanded;         // 下发给工作线程的CPU份额(%)，与own对比可看出内环误差
+    double external;          // 滤波后的外部负载估计(%)，即使用率减去自身占用
+    double delivery;          // 滤波后的 实际/指令 比例，工作线程让出CPU时小于1
+    int node;                 // 核心所在的NUMA节点
+    unsigned long long prev_cpu_ns; // 上次读取的工作线程CPU时间
+    unsigned long long prev_cmd_ns; // 上次读取的工作线程指令CPU时间
+    long long prev_idle;      // 上次采样的空闲时间
+    long long prev_total;     // 上次采样的总时间
+    _Atomic double stats[CORE_STATS]; // CPU调整线程每步发布的副本，由core_stats_seq保护
+} core_ctrl_t;
+
+core_ctrl_t* core_ctrls = NULL; // 每个核心一个控制状态
+
+// 核心控制状态副本的seqlock，以及同时发布的整体滤波值和目标
+atomic_uint core_stats_seq;
+_Atomic double published_cpu_filtered;
+_Atomic double published_cpu_target;
+
+#define CACHE_LINE_SIZE 64
+
+// 控制线程下发给工作线程的命令
+typedef struct {
+    double duty;                  // 占空比(0-1)
+    unsigned long long period_ns; // PWM周期
+    unsigned long long phase_ns;  // 相对网格原点的相位偏移
+    int kernel;                   // 忙等使用的CPU占用内核
+} worker_cmd_t;
+
+// 工作线程的热路径直方图: 第i个桶统计[2^i, 2^(i+1))纳秒，只有工作线程写入，读取时按需汇总
+typedef struct {
+    atomic_ullong buckets[64];
+    atomic_ullong count;
+    atomic_ullong sum;
+    atomic_ullong max;
+} worker_hist_t;
+
+// 工作线程状态，按缓存行对齐，避免不同线程之间的伪共享
+typedef struct {
+    // 控制线程写入、工作线程读取的命令，使用seqlock保护，读取无锁
+    _Alignas(CACHE_LINE_SIZE) atomic_uint cmd_seq;
+    _Atomic double cmd_duty;
+    atomic_ullong cmd_period_ns;
+    atomic_ullong cmd_phase_ns;
+    atomic_int cmd_kernel;
+    atomic_int stop;                 // 请求单个工作线程退出(基准测试使用)
+    _Atomic double backoff_share;    // 压力退让后保留的占空比比例(0-1)，由退让线程写入
+    atomic_uint backoff_gen;         // 每次触发退让加1，正在忙等的工作线程立即结束本周期
+    atomic_int tid;                  // 线程ID，退让线程据此读取它的运行队列等待时间
+    
+    // 工作线程私有状态，独占缓存行；只有工作线程写入，其他线程可随时读取
+    _Alignas(CACHE_LINE_SIZE) atomic_ullong cycles; // 已完成的周期数
+    atomic_ullong late_ns_sum;       // 唤醒晚于截止时间的累计值
+    atomic_ullong late_ns_max;       // 最大唤醒延迟
+    atomic_ullong busy_ns_sum;       // 累计忙等时间
+    atomic_ullong missed_cycles;     // 整个错过的周期数
+    atomic_ullong work_ops;          // 内核完成的运算次数，用于计算工作速率
+    atomic_ullong cpu_ns;            // 线程累计CPU时间(每个周期更新)
+    atomic_ullong cmd_ns_sum;        // 累计的指令CPU时间(占空比 * 周期)
+    atomic_ullong busy_since;        // 最近一次忙等窗口的开始时刻(唤醒延迟探针据此区分样本)
+    atomic_ullong busy_until;        // 最近一次忙等窗口的结束时刻，小于busy_since时正在忙等
+    
+    // 每个周期的偏差分布，区分误差来自控制器还是工作线程没有按时完成
+    _Alignas(CACHE_LINE_SIZE) worker_hist_t wake_hist; // 睡眠过冲: 唤醒时间 - 网格点
+    worker_hist_t late_hist;         // 周期延迟: 忙等结束 - (网格点 + 指令忙等时间)
+    worker_hist_t short_hist;        // 本周期实际CPU时间少于指令的差额
+    worker_hist_t over_hist;         // 本周期实际CPU时间多于指令的差额(补足上周期的欠账)
+} worker_t;
+
+worker_t* workers = NULL; // 与core_ctrls一一对应
 
 // 清屏函数
 void clear_screen() {
@@ -120,975 +258,5186 @@ int get_cpu_cores() {
 #endif
 }
 
-// 获取系统CPU使用率
-double get_system_cpu_usage() {
+// 分配按缓存行对齐的内存
+void* alloc_cache_aligned(size_t size) {
 #ifdef _WIN32
-    static ULARGE_INTEGER last_idle_time = {0};
-    static ULARGE_INTEGER last_kernel_time = {0};
-    static ULARGE_INTEGER last_user_time = {0};
-    
-    FILETIME idle_time, kernel_time, user_time;
-    if (!GetSystemTimes(&idle_time, &kernel_time, &user_time)) {
-        return 0.0;
-    }
-    
-    ULARGE_INTEGER now_idle_time, now_kernel_time, now_user_time;
-    now_idle_time.LowPart = idle_time.dwLowDateTime;
-    now_idle_time.HighPart = idle_time.dwHighDateTime;
-    now_kernel_time.LowPart = kernel_time.dwLowDateTime;
-    now_kernel_time.HighPart = kernel_time.dwHighDateTime;
-    now_user_time.LowPart = user_time.dwLowDateTime;
-    now_user_time.HighPart = user_time.dwHighDateTime;
-    
-    if (last_idle_time.QuadPart == 0) {
-        last_idle_time = now_idle_time;
-        last_kernel_time = now_kernel_time;
-        last_user_time = now_user_time;
-        Sleep(1000);
-        return get_system_cpu_usage();
-    }
-    
-    ULONGLONG idle_diff = now_idle_time.QuadPart - last_idle_time.QuadPart;
-    ULONGLONG kernel_diff = now_kernel_time.QuadPart - last_kernel_time.QuadPart;
-    ULONGLONG user_diff = now_user_time.QuadPart - last_user_time.QuadPart;
-    
-    ULONGLONG total_diff = kernel_diff + user_diff;
-    ULONGLONG used_diff = total_diff - idle_diff;
-    
-    last_idle_time = now_idle_time;
-    last_kernel_time = now_kernel_time;
-    last_user_time = now_user_time;
-    
-    if (total_diff == 0) return 0.0;
-    
-    double usage = used_diff * 100.0 / total_diff;
-    if (isnan(usage) || usage < 0 || usage > 100) {
-        return 0.0;
-    }
-    
-    return usage;
+    return _aligned_malloc(size, CACHE_LINE_SIZE);
 #else
-    // Linux通过/proc/stat获取CPU使用率
-    static long long prev_idle = 0, prev_total = 0;
-    FILE* fp = fopen("/proc/stat", "r");
-    if (fp == NULL) return 0.0;
-    
-    char buffer[1024];
-    if (fgets(buffer, sizeof(buffer), fp) == NULL) {
-        fclose(fp);
-        return 0.0;
-    }
-    fclose(fp);
-    
-    long long user, nice, system, idle, iowait, irq, softirq, steal;
-    sscanf(buffer, "cpu %lld %lld %lld %lld %lld %lld %lld %lld", 
-        &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal);
-    
-    long long current_idle = idle + iowait;
-    long long current_total = user + nice + system + idle + iowait + irq + softirq + steal;
-    
-    long long idle_diff = current_idle - prev_idle;
-    long long total_diff = current_total - prev_total;
-    
-    prev_idle = current_idle;
-    prev_total = current_total;
-    
-    if (total_diff == 0) return 0.0;
-    
-    double usage = 100.0 * (1.0 - (double)idle_diff / total_diff);
-    if (isnan(usage) || usage < 0 || usage > 100) {
-        return 0.0;
-    }
-    
-    return usage;
+    void* ptr = NULL;
+    if (posix_memalign(&ptr, CACHE_LINE_SIZE, size) != 0) return NULL;
+    return ptr;
 #endif
 }
 
-// 获取系统内存使用率
-double get_system_mem_usage() {
+// 释放按缓存行对齐的内存
+void free_cache_aligned(void* ptr) {
 #ifdef _WIN32
-    MEMORYSTATUSEX memInfo;
-    memInfo.dwLength = sizeof(MEMORYSTATUSEX);
-    if (!GlobalMemoryStatusEx(&memInfo)) {
-        return 0.0;
-    }
-    return (double)memInfo.dwMemoryLoad;
+    _aligned_free(ptr);
 #else
-    // 使用/proc/meminfo读取，确保与free -m命令输出对齐
-    FILE* fp = fopen("/proc/meminfo", "r");
-    if (fp == NULL) {
-        // 如果无法打开/proc/meminfo，回退到sysinfo方法
-        struct sysinfo info;
-        if (sysinfo(&info) != 0) {
-            return 0.0;
+    free(ptr);
+#endif
+}
+
+// 自旋等待时降低功耗并让出流水线
+void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// 发布新命令(只有控制线程写入)
+void worker_publish_cmd(worker_t* worker, const worker_cmd_t* cmd) {
+    unsigned int seq = atomic_load_explicit(&worker->cmd_seq, memory_order_relaxed);
+    // 序号为奇数表示正在写入
+    atomic_store_explicit(&worker->cmd_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&worker->cmd_duty, cmd->duty, memory_order_relaxed);
+    atomic_store_explicit(&worker->cmd_period_ns, cmd->period_ns, memory_order_relaxed);
+    atomic_store_explicit(&worker->cmd_phase_ns, cmd->phase_ns, memory_order_relaxed);
+    atomic_store_explicit(&worker->cmd_kernel, cmd->kernel, memory_order_relaxed);
+    atomic_store_explicit(&worker->cmd_seq, seq + 2, memory_order_release);
+}
+
+// 读取当前命令，写入过程中读到的数据会被丢弃重读
+void worker_read_cmd(worker_t* worker, worker_cmd_t* cmd) {
+    unsigned int seq1, seq2;
+    do {
+        seq1 = atomic_load_explicit(&worker->cmd_seq, memory_order_acquire);
+        while (seq1 & 1) {
+            cpu_relax();
+            seq1 = atomic_load_explicit(&worker->cmd_seq, memory_order_acquire);
         }
-        
-        long long total_mem = info.totalram;
-        long long free_mem = info.freeram + info.bufferram + info.sharedram;
-        long long used_mem = total_mem - free_mem;
-        
-        return (double)used_mem * 100.0 / total_mem;
-    }    // 从/proc/meminfo读取
-    char buffer[256];
-    unsigned long long mem_total = 0;
-    unsigned long long mem_free = 0;
-    unsigned long long mem_available = 0; // 新的指标，更准确
-    unsigned long long buffers = 0;
-    unsigned long long cached = 0;
-    unsigned long long slab = 0;
-    
-    while (fgets(buffer, sizeof(buffer), fp)) {
-        unsigned long long value;
-        
-        if (sscanf(buffer, "%*[^:]: %llu", &value) == 1) {
-            if (strncmp(buffer, "MemTotal:", 9) == 0) {
-                mem_total = value;
-            } else if (strncmp(buffer, "MemFree:", 8) == 0) {
-                mem_free = value;
-            } else if (strncmp(buffer, "MemAvailable:", 13) == 0) {
-                mem_available = value;
-            } else if (strncmp(buffer, "Buffers:", 8) == 0) {
-                buffers = value;
-            } else if (strncmp(buffer, "Cached:", 7) == 0) {
-                cached = value;
-            } else if (strncmp(buffer, "Slab:", 5) == 0) {
-                slab = value;
-            }
+        cmd->duty = atomic_load_explicit(&worker->cmd_duty, memory_order_relaxed);
+        cmd->period_ns = atomic_load_explicit(&worker->cmd_period_ns, memory_order_relaxed);
+        cmd->phase_ns = atomic_load_explicit(&worker->cmd_phase_ns, memory_order_relaxed);
+        cmd->kernel = atomic_load_explicit(&worker->cmd_kernel, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        seq2 = atomic_load_explicit(&worker->cmd_seq, memory_order_relaxed);
+    } while (seq1 != seq2);
+}
+
+// 发布各核心控制状态的副本(只有CPU调整线程写入)，其他线程读取副本而不是正在更新的控制状态
+void core_stats_publish(double cpu_filtered, double cpu_target) {
+    unsigned int seq = atomic_load_explicit(&core_stats_seq, memory_order_relaxed);
+    atomic_store_explicit(&core_stats_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (int i = 0; i < num_cpu_cores; i++) {
+        core_ctrl_t* core = &core_ctrls[i];
+        const double values[CORE_STATS] = {
+            [CORE_STAT_USAGE] = core->usage,
+            [CORE_STAT_FILTERED] = core->filtered,
+            [CORE_STAT_EXTERNAL] = core->external,
+            [CORE_STAT_SETPOINT] = core->setpoint,
+            [CORE_STAT_BUSY] = core->busy,
+            [CORE_STAT_OWN] = core->own,
+            [CORE_STAT_FEED_FORWARD] = core->feed_forward,
+            [CORE_STAT_INTEGRAL] = core->integral,
+            [CORE_STAT_TRIM] = core->trim,
+            [CORE_STAT_ERROR] = core->prev_error,
+            [CORE_STAT_COMMANDED] = core->commanded,
+        };
+        for (int k = 0; k < CORE_STATS; k++) {
+            atomic_store_explicit(&core->stats[k], values[k], memory_order_relaxed);
         }
     }
-    
-    fclose(fp);
-    
-    // 如果没有读到有效内存信息，回退到sysinfo方法
-    if (mem_total == 0) {
-        struct sysinfo info;
-        if (sysinfo(&info) != 0) {
-            return 0.0;
+    atomic_store_explicit(&published_cpu_filtered, cpu_filtered, memory_order_relaxed);
+    atomic_store_explicit(&published_cpu_target, cpu_target, memory_order_relaxed);
+    atomic_store_explicit(&core_stats_seq, seq + 2, memory_order_release);
+}
+
+// 读取各核心控制状态的副本到out(num_cpu_cores * CORE_STATS)，写入过程中读到的数据会被丢弃重读
+void core_stats_read(double* out, double* cpu_filtered, double* cpu_target) {
+    unsigned int seq1, seq2;
+    do {
+        seq1 = atomic_load_explicit(&core_stats_seq, memory_order_acquire);
+        while (seq1 & 1) {
+            cpu_relax();
+            seq1 = atomic_load_explicit(&core_stats_seq, memory_order_acquire);
         }
-        
-        long long total_mem = info.totalram;
-        long long free_mem = info.freeram + info.bufferram + info.sharedram;
-        long long used_mem = total_mem - free_mem;
-        
-        return (double)used_mem * 100.0 / total_mem;
-    }
-    
-    // 计算与free -m对齐的内存使用率
-    // 如果有MemAvailable，优先使用它(更精确，Linux 3.14+)
-    unsigned long long used_mem;
-    if (mem_available > 0) {
-        used_mem = mem_total - mem_available;
-    } else {
-        // 兼容老版本内核的计算方式
-        used_mem = mem_total - mem_free - buffers - cached - slab;
-    }
-    
-    // 确保不出现负值
-    if (used_mem > mem_total) {
-        used_mem = mem_total;
+        for (int i = 0; i < num_cpu_cores; i++) {
+            for (int k = 0; k < CORE_STATS; k++) {
+                out[i * CORE_STATS + k] = atomic_load_explicit(&core_ctrls[i].stats[k], memory_order_relaxed);
+            }
+        }
+        *cpu_filtered = atomic_load_explicit(&published_cpu_filtered, memory_order_relaxed);
+        *cpu_target = atomic_load_explicit(&published_cpu_target, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        seq2 = atomic_load_explicit(&core_stats_seq, memory_order_relaxed);
+    } while (seq1 != seq2);
+}
+
+// 工作线程累加自己的计数器(单一写者，不需要原子读改写)
+void counter_add(atomic_ullong* counter, unsigned long long value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+// 工作线程更新自己的最大值计数器
+void counter_max(atomic_ullong* counter, unsigned long long value) {
+    if (value > atomic_load_explicit(counter, memory_order_relaxed)) {
+        atomic_store_explicit(counter, value, memory_order_relaxed);
     }
-    
-    return (double)used_mem * 100.0 / mem_total;
-#endif
 }
 
-// 获取系统总内存大小(MB)
-unsigned long long get_total_system_memory() {
-#ifdef _WIN32
-    MEMORYSTATUSEX memInfo;
-    memInfo.dwLength = sizeof(MEMORYSTATUSEX);
-    if (!GlobalMemoryStatusEx(&memInfo)) {
-        return 0;
+// 工作线程记录一个值到自己的直方图，单写者，不需要原子读改写
+void worker_hist_record(worker_hist_t* hist, unsigned long long value) {
+    int bucket = value ? 63 - __builtin_clzll(value) : 0;
+    counter_add(&hist->buckets[bucket], 1);
+    counter_add(&hist->count, 1);
+    counter_add(&hist->sum, value);
+    counter_max(&hist->max, value);
+}
+
+// 分配并初始化工作线程状态数组
+worker_t* alloc_workers(int count) {
+    worker_t* array = (worker_t*)alloc_cache_aligned((size_t)count * sizeof(worker_t));
+    if (!array) return NULL;
+    
+    memset(array, 0, (size_t)count * sizeof(worker_t));
+    for (int i = 0; i < count; i++) {
+        atomic_init(&array[i].cmd_seq, 0);
+        atomic_init(&array[i].cmd_duty, 0.0);
+        atomic_init(&array[i].cmd_period_ns, (unsigned long long)cycle_period_us * 1000ULL);
+        atomic_init(&array[i].cmd_phase_ns, 0);
+        atomic_init(&array[i].cmd_kernel, 0);
+        atomic_init(&array[i].stop, 0);
+        atomic_init(&array[i].backoff_share, 1.0);
+        atomic_init(&array[i].backoff_gen, 0);
+        atomic_init(&array[i].tid, 0);
+        atomic_init(&array[i].cycles, 0);
+        atomic_init(&array[i].late_ns_sum, 0);
+        atomic_init(&array[i].late_ns_max, 0);
+        atomic_init(&array[i].busy_ns_sum, 0);
+        atomic_init(&array[i].missed_cycles, 0);
+        atomic_init(&array[i].work_ops, 0);
     }
-    return (unsigned long long)memInfo.ullTotalPhys / (1024 * 1024);
-#else
-    // 优先使用/proc/meminfo以确保与free -m一致
-    FILE* fp = fopen("/proc/meminfo", "r");
-    if (fp != NULL) {
-        char buffer[256];
-        unsigned long long mem_total = 0;
+    return array;
+}
+
+// 构造第index个工作线程的命令，周期和相位来自配置
+worker_cmd_t make_worker_cmd(int index, int count, double duty) {
+    worker_cmd_t cmd;
+    cmd.duty = duty;
+    cmd.period_ns = (unsigned long long)cycle_period_us * 1000ULL;
+    // 相位错开时各线程均匀分布在一个周期内
+    cmd.phase_ns = (phase_stagger && count > 0) ? cmd.period_ns * (unsigned long long)index / (unsigned long long)count : 0;
+    cmd.kernel = burn_kernel_index;
+    return cmd;
+}
+
+// 解析核心分组配置，格式: "0-7:80,8-63:20"，单个核心可写作 "5:50"
+bool parse_cpu_groups(const char* spec) {
+    int count = 0;
+    const char* p = spec;
+    
+    while (*p) {
+        int first, last, target, consumed = 0;
+        if (sscanf(p, "%d-%d:%d%n", &first, &last, &target, &consumed) == 3) {
+            // 范围写法
+        } else if (sscanf(p, "%d:%d%n", &first, &target, &consumed) == 2) {
+            last = first;
+        } else {
+            printf("无法解析核心分组: %s\n", p);
+            return false;
+        }
         
-        while (fgets(buffer, sizeof(buffer), fp)) {
-            if (strncmp(buffer, "MemTotal:", 9) == 0) {
-                sscanf(buffer, "MemTotal: %llu", &mem_total);
-                break;
-            }
+        if (first < 0 || last < first || target < 0 || target > 100) {
+            printf("核心分组无效: %.*s\n", consumed, p);
+            return false;
+        }
+        if (count >= MAX_CPU_GROUPS) {
+            printf("核心分组过多，最多支持 %d 个\n", MAX_CPU_GROUPS);
+            return false;
         }
         
-        fclose(fp);
+        cpu_groups[count].first_cpu = first;
+        cpu_groups[count].last_cpu = last;
+        cpu_groups[count].target = target;
+        count++;
         
-        if (mem_total > 0) {
-            // MemTotal以KB为单位，转换为MB
-            return mem_total / 1024;
+        p += consumed;
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            printf("无法解析核心分组: %s\n", p);
+            return false;
         }
     }
     
-    // 如果/proc/meminfo方法失败，回退到sysinfo
-    struct sysinfo info;
-    if (sysinfo(&info) != 0) {
-        return 0;
-    }
-    return (unsigned long long)info.totalram * info.mem_unit / (1024 * 1024);
-#endif
+    num_cpu_groups = count;
+    strncpy(cpu_groups_spec, spec, sizeof(cpu_groups_spec) - 1);
+    return true;
 }
 
-// 处理中断信号
-void signal_handler(int sig) {
-    printf("\n收到中断信号，程序即将退出...\n");
-    running = 0;
+// 查找CPU所属的分组，返回-1表示不在任何分组中
+int find_cpu_group(int cpu_id) {
+    for (int i = 0; i < num_cpu_groups; i++) {
+        if (cpu_id >= cpu_groups[i].first_cpu && cpu_id <= cpu_groups[i].last_cpu) {
+            return i;
+        }
+    }
+    return -1;
 }
 
-// 直接CPU占用函数 - 纯计算模式，不休息
-void spinCPU(unsigned long long cycles) {
-    volatile unsigned long long i;
-    volatile double result = 0.0;
-    
-    for (i = 0; i < cycles; i++) {
-        result += i * 3.14159265358979323846 * 1.732050807568877;
-        // 增加一些额外计算，提高工作强度
-        result = result / (1.0 + (i % 5) * 0.01) + sqrt(i % 10);
-    }
+// 获取某个CPU的目标使用率，不在任何分组中的核心使用全局目标
+int get_core_target(int cpu_id) {
+    int group = find_cpu_group(cpu_id);
+    return group >= 0 ? cpu_groups[group].target : target_cpu_usage;
 }
 
-// 调整CPU负载线程
-void* adjust_cpu_load_thread(void* arg) {
-    // PID控制算法参数从全局变量获取
-    const double Kp = pid_kp;   // 比例系数
-    const double Ki = pid_ki;   // 积分系数
-    const double Kd = pid_kd;   // 微分系数
-    
-    // 保存历史误差
-    double prev_error = 0.0;
-    double integral = 0.0;
-    
-    // 初始负载设置
-    thread_cpu_load = 0.7;  // 初始值提高到70%，更快接近目标
-    target_cpu_load = target_cpu_usage;
-    busy_percentage = 70;   // 从70%开始
-    
-    // 预热CPU
-    printf("CPU负载控制初始化中...\n");
-    
-    // 等待预热完成并初始化滤波值
+// 初始化每个核心的控制状态，工作线程数量与可用核心一致，max_count>0时最多max_count个
+bool init_core_ctrls(int max_count) {
 #ifdef _WIN32
-    Sleep(1000);
+    int count = num_cpu_cores;
 #else
-    usleep(1000 * 1000);
+    // 只绑定进程允许运行的核心(taskset/cpuset限制后的集合)
+    cpu_set_t allowed;
+    int count = 0;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        count = CPU_COUNT(&allowed);
+    }
+    if (count < 1) {
+        CPU_ZERO(&allowed);
+        for (int i = 0; i < num_cpu_cores && i < CPU_SETSIZE; i++) {
+            CPU_SET(i, &allowed);
+        }
+        count = num_cpu_cores;
+    }
 #endif
-    filtered_cpu_usage = get_system_cpu_usage();
+    if (count < 1) count = 1;
     
-    // 加入自适应PID系数调整
-    double max_adjustment = 20.0; // 最大调整幅度限制(提高以增强响应能力)
+    if (max_count > 0 && count > max_count) count = max_count;
     
-    while (running) {
-        // 获取当前系统CPU使用率
-        double system_cpu_usage = get_system_cpu_usage();
-        
-        // 应用低通滤波器平滑CPU使用率波动
-        filtered_cpu_usage = filter_alpha * system_cpu_usage + (1 - filter_alpha) * filtered_cpu_usage;
-        
-        // 更新当前CPU负载（用于显示）
-        current_cpu_load = system_cpu_usage;
-        
-        // 计算误差 - 使用滤波后的CPU使用率
-        double error = target_cpu_usage - filtered_cpu_usage;
-        
-        // 积分项计算 - 使用衰减以避免积分饱和
-        integral = integral * 0.95 + error;
-        
-        // 对积分进行自适应限制，防止积分饱和
-        double integral_limit = 25.0 / Ki; // 基于积分系数的自适应积分限制
-        if (integral > integral_limit) integral = integral_limit;
-        if (integral < -integral_limit) integral = -integral_limit;
-        
-        // 微分项计算
-        double derivative = error - prev_error;
-        prev_error = error;
-        
-        // 计算PID输出，加入自适应限制
-        double pid_output = Kp * error + Ki * integral + Kd * derivative;
-        
-        // 限制单次调整幅度，提高稳定性
-        if (pid_output > max_adjustment) pid_output = max_adjustment;
-        if (pid_output < -max_adjustment) pid_output = -max_adjustment;
-        
-        // 更积极地调整CPU繁忙百分比
-        busy_percentage += (int)(pid_output * 0.2); // 提高到20%，更快速达到目标
-        
-        // 限制CPU繁忙百分比在有效范围内
-        if (busy_percentage < 0) busy_percentage = 0;
-        if (busy_percentage > 100) busy_percentage = 100;
-        
-        // 更新目标CPU负载
-        target_cpu_load = busy_percentage;
-        
-        // 更新工作线程的负载比例
-#ifdef _WIN32
-        EnterCriticalSection(&cpu_load_cs);
-        thread_cpu_load = (double)busy_percentage / 100.0;
-        LeaveCriticalSection(&cpu_load_cs);
-#else
-        pthread_mutex_lock(&cpu_load_mutex);
-        thread_cpu_load = (double)busy_percentage / 100.0;
-        pthread_mutex_unlock(&cpu_load_mutex);
-#endif
-        
-#ifdef _WIN32
-        Sleep(150);  // 150ms，减少采样周期，加快响应速度
-#else
-        usleep(150 * 1000);  // 150ms
-#endif
+    core_ctrls = (core_ctrl_t*)calloc((size_t)count, sizeof(core_ctrl_t));
+    workers = alloc_workers(count);
+    if (!core_ctrls || !workers) {
+        return false;
     }
     
-    return NULL;
-}
-
-// 新的CPU负载控制算法
-void* cpu_load_thread(void* arg) {
-    // 这里使用参数来区分线程，防止编译器警告
 #ifdef _WIN32
-    long thread_index = (long)(intptr_t)arg;
-    (void)thread_index; // 标记为已使用，避免警告
+    for (int i = 0; i < count; i++) {
+        core_ctrls[i].cpu_id = i;
+    }
 #else
-    long thread_index = (long)(intptr_t)arg;
-    (void)thread_index; // 标记为已使用，避免警告
-#endif
-    
-    // 设置高优先级
-#ifdef _WIN32
-    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_ABOVE_NORMAL);
+    int idx = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && idx < count; cpu++) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            core_ctrls[idx++].cpu_id = cpu;
+        }
+    }
 #endif
     
-    // 周期时间（微秒）
-    const long long CYCLE_TIME_US = 5000; // 5ms = 5,000µs，降低以提高精度
-    
-    struct timespec cycle_start, current_time;
-    double local_load;
-    
-    while (running) {
-        // 获取当前的负载目标
+    num_cpu_cores = count;
+    for (int i = 0; i < count; i++) {
+        core_ctrls[i].target = get_core_target(core_ctrls[i].cpu_id);
+        core_ctrls[i].setpoint = core_ctrls[i].target;
+    }
+    return true;
+}
+
+// NUMA拓扑，从/sys/devices/system/node读取；没有该目录(以及Windows上)视为单个节点
+#define MAX_NUMA_NODES 64
+typedef struct {
+    int id;
+    unsigned long long mem_total_kb;
+    unsigned long long mem_available_kb; // 估算值: MemFree + 文件页 + 可回收slab，与老内核的回退算法一致
+    int num_cpus;                        // 该节点上的工作线程数
+} numa_node_t;
+
+numa_node_t numa_nodes[MAX_NUMA_NODES];
+int num_numa_nodes = 0;
+
+// 压载区的NUMA内存策略
+typedef enum {
+    NUMA_POLICY_DEFAULT = 0, // 多个节点时交错分布，单个节点时由首次写入决定
+    NUMA_POLICY_LOCAL,       // 首次写入决定(填充线程所在的节点)
+    NUMA_POLICY_INTERLEAVE,  // 按页交错分布到所有有内存的节点
+    NUMA_POLICY_BIND         // 只在指定的节点上分配
+} numa_policy_t;
+
+numa_policy_t numa_policy = NUMA_POLICY_DEFAULT;
+unsigned long long numa_bind_mask = 0; // NUMA_POLICY_BIND的节点位图
+char cpu_node_spec[256] = "";          // --cpu-node原始配置字符串，用于保存配置
+
+// 判断CPU编号是否在cpulist格式的列表中，例如 "0-7,16-23"
+bool cpulist_contains(const char* list, int cpu) {
+    const char* p = list;
+    while (*p) {
+        int first, last, consumed = 0;
+        if (sscanf(p, "%d-%d%n", &first, &last, &consumed) == 2) {
+            // 范围写法
+        } else if (sscanf(p, "%d%n", &first, &consumed) == 1) {
+            last = first;
+        } else {
+            return false;
+        }
+        if (cpu >= first && cpu <= last) return true;
+        p += consumed;
+        if (*p == ',') p++;
+        else break;
+    }
+    return false;
+}
+
+// 读取节点的CPU列表
+bool numa_node_cpulist(int node, char* buf, size_t size) {
 #ifdef _WIN32
-        EnterCriticalSection(&cpu_load_cs);
-        local_load = thread_cpu_load;
-        LeaveCriticalSection(&cpu_load_cs);
+    (void)node;
+    (void)buf;
+    (void)size;
+    return false;
 #else
-        pthread_mutex_lock(&cpu_load_mutex);
-        local_load = thread_cpu_load;
-        pthread_mutex_unlock(&cpu_load_mutex);
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE* fp = fopen(path, "r");
+    if (!fp) return false;
+    bool ok = fgets(buf, (int)size, fp) != NULL;
+    fclose(fp);
+    if (ok) buf[strcspn(buf, "\n")] = '\0';
+    return ok;
 #endif
-        
-        // 获取当前时间作为周期开始
+}
+
+// 读取节点的内存信息(/sys/devices/system/node/nodeN/meminfo)
+bool numa_read_meminfo(numa_node_t* n) {
 #ifdef _WIN32
-        timespec_get(&cycle_start, TIME_UTC);
+    (void)n;
+    return false;
 #else
-        clock_gettime(CLOCK_MONOTONIC, &cycle_start);
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/meminfo", n->id);
+    FILE* fp = fopen(path, "r");
+    if (!fp) return false;
+    
+    unsigned long long total = 0, free_kb = 0, file = 0, reclaimable = 0;
+    char line[256], key[64];
+    unsigned long long value;
+    while (fgets(line, sizeof(line), fp)) {
+        // 每行格式: "Node 0 MemTotal:       16330372 kB"
+        if (sscanf(line, "Node %*d %63[^:]: %llu", key, &value) != 2) continue;
+        if (strcmp(key, "MemTotal") == 0) total = value;
+        else if (strcmp(key, "MemFree") == 0) free_kb = value;
+        else if (strcmp(key, "FilePages") == 0) file = value;
+        else if (strcmp(key, "SReclaimable") == 0) reclaimable = value;
+    }
+    fclose(fp);
+    if (total == 0) return false;
+    
+    unsigned long long available = free_kb + file + reclaimable;
+    n->mem_total_kb = total;
+    n->mem_available_kb = available < total ? available : total;
+    return true;
 #endif
-        
-        // 计算这个周期应该工作的时间（微秒）
-        long long work_time_us = (long long)(local_load * CYCLE_TIME_US);
-        
-        // 如果负载很低，跳过这个周期
-        if (work_time_us < 50) { // 降低跳过阈值，增加工作比例
-#ifdef _WIN32
-            Sleep(5);  // 减少休眠时间
-#else
-            usleep(5000);  // 减少休眠时间
+}
+
+// 刷新所有节点的内存信息
+void numa_update_meminfo() {
+    for (int i = 0; i < num_numa_nodes; i++) {
+        numa_read_meminfo(&numa_nodes[i]);
+    }
+}
+
+// 查找节点在numa_nodes中的下标
+int find_numa_node(int id) {
+    for (int i = 0; i < num_numa_nodes; i++) {
+        if (numa_nodes[i].id == id) return i;
+    }
+    return -1;
+}
+
+// 读取NUMA拓扑并记录每个核心所在的节点，在init_core_ctrls之后调用
+void numa_init() {
+    num_numa_nodes = 0;
+    memset(numa_nodes, 0, sizeof(numa_nodes));
+#ifndef _WIN32
+    DIR* dir = opendir("/sys/devices/system/node");
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL && num_numa_nodes < MAX_NUMA_NODES) {
+            int id;
+            char extra;
+            if (sscanf(entry->d_name, "node%d%c", &id, &extra) != 1 || id < 0 || id >= MAX_NUMA_NODES) {
+                continue;
+            }
+            // 按节点编号插入排序
+            int pos = num_numa_nodes++;
+            while (pos > 0 && numa_nodes[pos - 1].id > id) {
+                numa_nodes[pos] = numa_nodes[pos - 1];
+                pos--;
+            }
+            numa_nodes[pos].id = id;
+        }
+        closedir(dir);
+    }
 #endif
+    if (num_numa_nodes == 0) {
+        num_numa_nodes = 1;
+        numa_nodes[0].id = 0;
+    }
+    
+    char cpulist[1024];
+    for (int i = 0; i < num_numa_nodes; i++) {
+        if (num_numa_nodes > 1 && !numa_node_cpulist(numa_nodes[i].id, cpulist, sizeof(cpulist))) {
             continue;
         }
-        
-        // 繁忙等待指定的时间
-        long long elapsed_us;
-        do {
-            // 执行一些计算密集型操作
-            spinCPU(1000);
-            
-            // 获取当前时间
-#ifdef _WIN32
-            timespec_get(&current_time, TIME_UTC);
-#else
-            clock_gettime(CLOCK_MONOTONIC, &current_time);
-#endif
-            
-            // 计算已经过去的时间（微秒）
-            elapsed_us = (current_time.tv_sec - cycle_start.tv_sec) * 1000000 +
-                         (current_time.tv_nsec - cycle_start.tv_nsec) / 1000;
-                         
-        } while (elapsed_us < work_time_us && running);
-        
-        // 休息到下一个周期开始
-        long long sleep_time_us = CYCLE_TIME_US - elapsed_us;
-        if (sleep_time_us > 100) { // 只有当休息时间足够长时才休息
-#ifdef _WIN32
-            Sleep((DWORD)(sleep_time_us / 1000));
-#else
-            usleep(sleep_time_us);
-#endif
+        for (int c = 0; c < num_cpu_cores; c++) {
+            if (num_numa_nodes == 1 || cpulist_contains(cpulist, core_ctrls[c].cpu_id)) {
+                core_ctrls[c].node = numa_nodes[i].id;
+                numa_nodes[i].num_cpus++;
+            }
         }
     }
-    
-    return NULL;
+    numa_update_meminfo();
 }
 
-// 内存分配函数
-void allocate_memory() {
-    static char** memory_blocks = NULL;
-    static int allocated_blocks = 0;
-    static unsigned long long allocated_mb = 0;
-    static double prev_needed_mem_percent = 0.0;  // 上次需要的内存百分比
-    static int memory_adjustment_counter = 0;     // 调整计数器
-    static int target_not_reached_counter = 0;    // 目标未达到计数器
-    static int block_size_mb = 1;                 // 内存块大小(MB)
-    static int consecutive_failed_allocations = 0; // 连续分配失败计数
-    static int stabilization_counter = 0;         // 稳定计数器，用于平滑分配过程
-    static double last_mem_usage = 0.0;           // 上次的内存使用率
-    static double avg_memory_change_rate = 0.0;   // 平均内存变化率
-    
-    // 获取当前系统内存使用情况
-    double current_mem_usage_percent = get_system_mem_usage();
-    
-    // 计算内存使用率变化率
-    double mem_change_rate = 0.0;
-    if (last_mem_usage > 0.0) {
-        mem_change_rate = fabs(current_mem_usage_percent - last_mem_usage);
-        // 使用指数加权移动平均更新平均变化率
-        if (avg_memory_change_rate == 0.0) {
-            avg_memory_change_rate = mem_change_rate;
+// 解析节点列表，例如 "0,2-3"，返回节点位图
+bool parse_node_mask(const char* list, unsigned long long* mask) {
+    *mask = 0;
+    const char* p = list;
+    while (*p) {
+        int first, last, consumed = 0;
+        if (sscanf(p, "%d-%d%n", &first, &last, &consumed) == 2) {
+            // 范围写法
+        } else if (sscanf(p, "%d%n", &first, &consumed) == 1) {
+            last = first;
         } else {
-            avg_memory_change_rate = 0.7 * avg_memory_change_rate + 0.3 * mem_change_rate;
+            return false;
         }
+        if (first < 0 || last < first || last >= MAX_NUMA_NODES) return false;
+        for (int n = first; n <= last; n++) *mask |= 1ULL << n;
+        p += consumed;
+        if (*p == ',') p++;
+        else if (*p != '\0') return false;
     }
-    last_mem_usage = current_mem_usage_percent;
-    
-    // 根据内存变化率动态调整滤波系数
-    // 变化大时使用小滤波系数，变化小时使用大滤波系数
-    double adaptive_filter_alpha = filter_alpha;
-    if (avg_memory_change_rate > 2.0) {
-        // 变化大，减小滤波系数，更多依赖历史值以减缓波动
-        adaptive_filter_alpha = filter_alpha * 0.5;
-    } else if (avg_memory_change_rate < 0.5) {
-        // 变化小，增大滤波系数，更快响应新值
-        adaptive_filter_alpha = filter_alpha * 1.5;
-        if (adaptive_filter_alpha > 0.8) adaptive_filter_alpha = 0.8;
-    }
-    
-    // 应用自适应低通滤波器平滑内存使用率
-    if (filtered_mem_usage == 0.0) {
-        filtered_mem_usage = current_mem_usage_percent;
+    return *mask != 0;
+}
+
+// 解析--numa: local、interleave或bind:<节点列表>
+bool parse_numa_policy(const char* spec) {
+    if (strcmp(spec, "default") == 0) {
+        numa_policy = NUMA_POLICY_DEFAULT;
+    } else if (strcmp(spec, "local") == 0) {
+        numa_policy = NUMA_POLICY_LOCAL;
+    } else if (strcmp(spec, "interleave") == 0) {
+        numa_policy = NUMA_POLICY_INTERLEAVE;
+    } else if (strncmp(spec, "bind:", 5) == 0 && parse_node_mask(spec + 5, &numa_bind_mask)) {
+        numa_policy = NUMA_POLICY_BIND;
     } else {
-        filtered_mem_usage = adaptive_filter_alpha * current_mem_usage_percent + 
-                             (1 - adaptive_filter_alpha) * filtered_mem_usage;
-    }
-    
-    unsigned long long total_system_memory_mb = get_total_system_memory();
-    
-    // 计算目标内存百分比
-    double target_mem_percent = (double)target_mem_usage_mb * 100.0 / total_system_memory_mb;
-    
-    // 计算内存差距，同时考虑当前实际值和滤波值
-    double mem_gap = target_mem_percent - current_mem_usage_percent;
-    double filtered_gap = target_mem_percent - filtered_mem_usage;
-    
-    // 使用自适应权重综合考虑当前和过滤后的差距
-    double current_weight = 0.5; // 默认权重
-    
-    // 调整权重 - 如果内存变化率高，偏向滤波值；如果变化率低，偏向当前值
-    if (avg_memory_change_rate > 1.5) {
-        // 高变化率，更多依赖滤波值
-        current_weight = 0.3;
-    } else if (avg_memory_change_rate < 0.5) {
-        // 低变化率，更多依赖当前值
-        current_weight = 0.7;
+        return false;
     }
-    
-    double effective_gap = mem_gap * current_weight + filtered_gap * (1.0 - current_weight);
-    
-    // 添加稳定机制 - 如果接近目标，增加稳定计数，减少调整频率
-    if (fabs(effective_gap) < 2.0) {
-        stabilization_counter++;
-        // 在稳定区间，隔几次才进行调整
-        if (stabilization_counter < 3) {
-            // 跳过本次调整，保持当前状态
-            return;
+    return true;
+}
+
+// 格式化NUMA策略，格式与parse_numa_policy一致
+void format_numa_policy(char* buf, size_t size) {
+    switch (numa_policy) {
+        case NUMA_POLICY_LOCAL:      snprintf(buf, size, "local"); break;
+        case NUMA_POLICY_INTERLEAVE: snprintf(buf, size, "interleave"); break;
+        case NUMA_POLICY_BIND: {
+            size_t len = (size_t)snprintf(buf, size, "bind:");
+            for (int n = 0; n < MAX_NUMA_NODES && len < size; n++) {
+                if (numa_bind_mask & (1ULL << n)) {
+                    len += (size_t)snprintf(buf + len, size - len, "%s%d", len > 5 ? "," : "", n);
+                }
+            }
+            break;
+        }
+        default: snprintf(buf, size, "default"); break;
+    }
+}
+
+// 解析--cpu-node，例如 "0:80,1:20"，按节点的CPU列表转换为核心分组
+bool parse_cpu_node_targets(const char* spec) {
+    char groups[1024] = "";
+    size_t len = 0;
+    const char* p = spec;
+    while (*p) {
+        int node, target, consumed = 0;
+        if (sscanf(p, "%d:%d%n", &node, &target, &consumed) != 2 || node < 0 || target < 0 || target > 100) {
+            printf("无法解析节点CPU目标: %s\n", p);
+            return false;
+        }
+        char cpulist[512];
+        if (!numa_node_cpulist(node, cpulist, sizeof(cpulist)) || cpulist[0] == '\0') {
+            printf("无法读取NUMA节点%d的CPU列表\n", node);
+            return false;
+        }
+        // 节点CPU列表中的每一段成为一个分组
+        const char* range = cpulist;
+        while (*range) {
+            int range_len = (int)strcspn(range, ",");
+            len += (size_t)snprintf(groups + len, sizeof(groups) - len, "%s%.*s:%d",
+                                    len ? "," : "", range_len, range, target);
+            if (len >= sizeof(groups)) {
+                printf("节点CPU目标过长\n");
+                return false;
+            }
+            range += range_len;
+            if (*range == ',') range++;
+        }
+        p += consumed;
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            printf("无法解析节点CPU目标: %s\n", p);
+            return false;
         }
-        stabilization_counter = 0;
-    } else {
-        // 不在稳定区间，重置计数器
-        stabilization_counter = 0;
     }
+    if (!parse_cpu_groups(groups)) return false;
+    snprintf(cpu_node_spec, sizeof(cpu_node_spec), "%s", spec);
+    return true;
+}
+
+// 总体目标: 所有核心目标的平均值，未设置分组时等于全局目标
+double get_overall_cpu_target() {
+    if (num_cpu_cores <= 0 || core_ctrls == NULL) return target_cpu_usage;
     
-    // 小差距时添加微小偏移以确保达到目标
-    if (fabs(effective_gap) < 3.0 && effective_gap > 0) {
-        effective_gap += 0.3;
+    double sum = 0.0;
+    for (int i = 0; i < num_cpu_cores; i++) {
+        sum += core_ctrls[i].target;
+    }
+    return sum / num_cpu_cores;
+}
+
+// 内存目标: 百分比、系统已用内存的绝对值，或保留的空闲内存
+typedef enum {
+    MEM_TARGET_PERCENT = 0, // 50 或 50%
+    MEM_TARGET_BYTES,       // 64G，系统已用内存达到该值
+    MEM_TARGET_FREE         // free:8G，保留该值的可用内存
+} mem_target_kind_t;
+
+typedef struct {
+    mem_target_kind_t kind;
+    double value;           // 百分比或字节数
+} mem_target_t;
+
+mem_target_t mem_target = { MEM_TARGET_PERCENT, 0.0 };
+unsigned long long mem_rate_bytes = 0; // 每秒最多增长的字节数，0为自动(内存总量的一半)
+mem_target_t mem_floor = { MEM_TARGET_PERCENT, 0.0 }; // 可用内存的硬下限(百分比或字节数)，默认0不启用看门狗
+
+// 解析带单位的大小(K/M/G/T，1024进制，可带B或iB)，没有单位时按字节
+bool parse_size(const char* s, unsigned long long* bytes) {
+    char* end;
+    double value = strtod(s, &end);
+    if (end == s || value < 0) return false;
+    double unit = 1.0;
+    switch (toupper((unsigned char)*end)) {
+        case 'K': unit = 1024.0; end++; break;
+        case 'M': unit = 1024.0 * 1024; end++; break;
+        case 'G': unit = 1024.0 * 1024 * 1024; end++; break;
+        case 'T': unit = 1024.0 * 1024 * 1024 * 1024; end++; break;
+    }
+    if (unit > 1.0 && toupper((unsigned char)*end) == 'I') end++;
+    if (toupper((unsigned char)*end) == 'B') end++;
+    if (*end != '\0') return false;
+    *bytes = (unsigned long long)(value * unit + 0.5);
+    return true;
+}
+
+// 解析内存目标: 不带单位的数值为百分比(兼容原来的-m)，带单位为绝对值，free:前缀为保留的空闲内存
+bool parse_mem_target(const char* s, mem_target_t* t) {
+    unsigned long long bytes;
+    if (strncmp(s, "free:", 5) == 0) {
+        if (!parse_size(s + 5, &bytes) || !isalpha((unsigned char)s[strlen(s) - 1])) return false;
+        t->kind = MEM_TARGET_FREE;
+        t->value = (double)bytes;
+        return true;
+    }
+    char* end;
+    double value = strtod(s, &end);
+    if (end != s && (*end == '\0' || (end[0] == '%' && end[1] == '\0'))) {
+        if (value < 0 || value > 100) return false;
+        t->kind = MEM_TARGET_PERCENT;
+        t->value = value;
+        return true;
+    }
+    if (!parse_size(s, &bytes)) return false;
+    t->kind = MEM_TARGET_BYTES;
+    t->value = (double)bytes;
+    return true;
+}
+
+// 解析看门狗的可用内存下限: 百分比或绝对值，不支持free:写法
+bool parse_mem_floor(const char* s) {
+    mem_target_t t;
+    if (strncmp(s, "free:", 5) == 0 || !parse_mem_target(s, &t)) return false;
+    mem_floor = t;
+    return true;
+}
+
+// 按当前内存总量换算目标已用字节数
+unsigned long long mem_target_bytes(const mem_target_t* t, unsigned long long total_kb) {
+    double total = (double)total_kb * 1024.0;
+    double bytes;
+    switch (t->kind) {
+        case MEM_TARGET_BYTES: bytes = t->value; break;
+        case MEM_TARGET_FREE:  bytes = total - t->value; break;
+        default:               bytes = t->value * total / 100.0; break;
+    }
+    if (bytes < 0) bytes = 0;
+    if (bytes > total) bytes = total;
+    return (unsigned long long)bytes;
+}
+
+// 设置了看门狗下限时，内存目标不越过 内存总量 − 2×下限，避免控制器和看门狗反复拉锯；第一次降低目标时提示
+// 下限为0(默认)时不改变目标
+bool mem_floor_warned = false;
+unsigned long long mem_floor_clamp(unsigned long long target_bytes, unsigned long long total_kb, const char* label) {
+    unsigned long long total = total_kb * 1024;
+    unsigned long long floor_bytes = mem_target_bytes(&mem_floor, total_kb);
+    if (floor_bytes == 0 || target_bytes + 2 * floor_bytes <= total) return target_bytes;
+    unsigned long long limit = total > 2 * floor_bytes ? total - 2 * floor_bytes : 0;
+    if (!mem_floor_warned) {
+        printf("%s内存目标 %.1f MB 超过 内存总量 - 2×可用内存下限，按 %.1f MB 控制(可用--mem-floor调整下限)\n",
+               label, target_bytes / (1024.0 * 1024.0), limit / (1024.0 * 1024.0));
+        mem_floor_warned = true;
+    }
+    return limit;
+}
+
+// 格式化大小，能整除时使用较大的单位
+void format_size(char* buf, size_t size, unsigned long long bytes) {
+    if (bytes >= (1ULL << 30) && bytes % (1ULL << 30) == 0) {
+        snprintf(buf, size, "%lluG", bytes >> 30);
+    } else if (bytes % (1ULL << 20) == 0) {
+        snprintf(buf, size, "%lluM", bytes >> 20);
+    } else {
+        snprintf(buf, size, "%lluK", (bytes + 512) >> 10);
+    }
+}
+
+// 格式化内存目标，格式与parse_mem_target一致，用于保存配置和显示
+void format_mem_target(char* buf, size_t size, const mem_target_t* t) {
+    char size_str[32];
+    switch (t->kind) {
+        case MEM_TARGET_BYTES:
+            format_size(buf, size, (unsigned long long)t->value);
+            break;
+        case MEM_TARGET_FREE:
+            format_size(size_str, sizeof(size_str), (unsigned long long)t->value);
+            snprintf(buf, size, "free:%s", size_str);
+            break;
+        default:
+            snprintf(buf, size, "%g%%", t->value);
+            break;
+    }
+}
+
+// 随时间变化的目标曲线，数值均为百分比
+typedef enum {
+    PROFILE_NONE = 0,
+    PROFILE_RAMP,      // ramp:起点:终点:时长，之后保持终点
+    PROFILE_SINE,      // sine:最小:最大:周期
+    PROFILE_DIURNAL,   // diurnal:最小:最大[:周期]，按本地时间04:00最低、16:00最高
+    PROFILE_SQUARE,    // square:低:高:周期[:高电平占比%]
+    PROFILE_SCHEDULE   // file:路径，每行"秒 值"，点之间线性插值
+} profile_kind_t;
+
+typedef struct {
+    profile_kind_t kind;
+    double low;             // ramp为起点
+    double high;            // ramp为终点
+    double period;          // 周期或斜坡时长(秒)，分段计划为最后一个点的时刻
+    double duty;            // 方波高电平占比(0-1)
+    double phase;           // 昼夜曲线起点对应的一天中的位置(0-1)
+    int num_points;         // 分段计划的点
+    double* point_time;
+    double* point_value;
+    bool repeat;            // 分段计划结束后从头循环
+    char spec[256];         // 原始配置字符串，用于保存配置
+} target_profile_t;
+
+// 跟踪滞后估计: 设定值持续变化时，滞后 ≈ -跟踪误差 / 设定值变化率
+typedef struct {
+    double setpoint;        // 当前设定值(%)
+    double prev_time;
+    double slope;           // 滤波后的设定值变化率(%/秒)
+    double error;           // 滤波后的跟踪误差(实际 - 设定，%)
+    double lag;             // 估计的滞后(秒)，-1表示设定值还没有持续变化过
+    bool started;
+} profile_lag_t;
+
+target_profile_t cpu_profile = {0};
+target_profile_t mem_profile = {0};
+profile_lag_t cpu_lag = {0};
+profile_lag_t mem_lag = {0};
+double profile_epoch = 0.0; // 曲线时间起点(单调时钟秒)
+
+// 释放目标曲线
+void free_target_profile(target_profile_t* p) {
+    free(p->point_time);
+    free(p->point_value);
+    memset(p, 0, sizeof(*p));
+}
+
+// 加载分段计划文件: 每行"秒 值"，时刻递增，'#'开头为注释，单独一行"repeat"表示循环
+bool load_profile_schedule(target_profile_t* p, const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        printf("无法打开目标计划文件: %s\n", path);
+        return false;
     }
     
-    // 自动调整内存分配策略
-    if (effective_gap > 1.5) {
-        // 低于目标，增加调整系数
-        target_not_reached_counter++;
-        
-        // 如果连续多次未达到目标，增加调整系数
-        if (target_not_reached_counter > 2) {
-            // 根据差距大小动态调整增量
-            int adjustment_increment = (int)(fabs(effective_gap) * 0.3);
-            if (adjustment_increment < 1) adjustment_increment = 1;
-            if (adjustment_increment > 3) adjustment_increment = 3;
-            
-            memory_adjustment_counter += adjustment_increment;
-            if (memory_adjustment_counter > 10) memory_adjustment_counter = 10;
-            target_not_reached_counter = 0;
-            consecutive_failed_allocations = 0;
-            
-            if (verbose_mode) {
-                printf("内存调整：增加调整系数到 %d (差距: %.1f%%)\n", 
-                       memory_adjustment_counter, effective_gap);
-            }
+    char line[256];
+    int capacity = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        const char* s = line;
+        while (*s == ' ' || *s == '\t') s++;
+        if (*s == '#' || *s == '\n' || *s == '\r' || *s == '\0') continue;
+        if (strncmp(s, "repeat", 6) == 0) {
+            p->repeat = true;
+            continue;
         }
-    } else if (effective_gap < -2.0) {
-        // 高于目标，快速减少调整系数
-        target_not_reached_counter = 0;
-        memory_adjustment_counter = 0;
         
-        if (verbose_mode) {
-            printf("内存超出目标，立即释放部分内存 (差距: %.1f%%)\n", effective_gap);
+        double t, value;
+        if (sscanf(s, "%lf %lf", &t, &value) != 2 || t < 0 || value < 0 || value > 100 ||
+            (p->num_points > 0 && t <= p->point_time[p->num_points - 1])) {
+            printf("目标计划文件格式错误: %s", line);
+            fclose(fp);
+            return false;
         }
-    } else if (fabs(effective_gap) < 1.0) {
-        // 非常接近目标，缓慢减少调整系数，降低波动
-        target_not_reached_counter = 0;
-        if (memory_adjustment_counter > 0 && (rand() % 5 == 0)) { // 降低减少概率
-            memory_adjustment_counter--;
-            if (verbose_mode) {
-                printf("内存接近目标，减少调整系数到 %d\n", memory_adjustment_counter);
+        if (p->num_points == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            double* times = (double*)realloc(p->point_time, capacity * sizeof(double));
+            if (times) p->point_time = times;
+            double* values = (double*)realloc(p->point_value, capacity * sizeof(double));
+            if (values) p->point_value = values;
+            if (!times || !values) {
+                printf("内存分配失败\n");
+                fclose(fp);
+                return false;
             }
         }
+        p->point_time[p->num_points] = t;
+        p->point_value[p->num_points] = value;
+        p->num_points++;
     }
+    fclose(fp);
     
-    // 处理连续分配失败
-    if (consecutive_failed_allocations > 3) {
-        if (memory_adjustment_counter > 0) {
-            memory_adjustment_counter--;
-            if (verbose_mode) {
-                printf("连续分配失败，减少调整系数到 %d\n", memory_adjustment_counter);
-            }
-        }
-        consecutive_failed_allocations = 0;
+    if (p->num_points == 0) {
+        printf("目标计划文件中没有数据: %s\n", path);
+        return false;
     }
+    p->period = p->point_time[p->num_points - 1];
+    return true;
+}
 
-    // 使用调整后的系数计算需要的内存
-    double needed_mem_percent = effective_gap;
-    
-    // 应用自适应调整因子
-    double adjustment_factor = 1.0;
-    if (memory_adjustment_counter > 0) {
-        // 基础调整因子
-        adjustment_factor = 1.0 + (memory_adjustment_counter * 0.7);
-        
-        // 根据差距大小动态调整因子
-        if (fabs(effective_gap) > 8.0) {
-            adjustment_factor *= 1.8;
-        } else if (fabs(effective_gap) > 4.0) {
-            adjustment_factor *= 1.5;
-        } else if (fabs(effective_gap) > 1.0) {
-            adjustment_factor *= 1.2;
+// 解析目标曲线配置
+bool parse_target_profile(target_profile_t* p, const char* spec) {
+    free_target_profile(p);
+    double a = 0, b = 0, c = 0, d = 50;
+    int n;
+    
+    if (strncmp(spec, "file:", 5) == 0) {
+        p->kind = PROFILE_SCHEDULE;
+        if (!load_profile_schedule(p, spec + 5)) {
+            free_target_profile(p);
+            return false;
         }
-        
-        // 如果接近目标但仍未达到，适度增加因子
-        if (effective_gap > 0 && effective_gap < 3.0) {
-            adjustment_factor += 0.3;
+    } else {
+        if (sscanf(spec, "ramp:%lf:%lf:%lf", &a, &b, &c) == 3) {
+            p->kind = PROFILE_RAMP;
+        } else if (sscanf(spec, "sine:%lf:%lf:%lf", &a, &b, &c) == 3) {
+            p->kind = PROFILE_SINE;
+        } else if ((n = sscanf(spec, "diurnal:%lf:%lf:%lf", &a, &b, &c)) >= 2) {
+            p->kind = PROFILE_DIURNAL;
+            if (n == 2) c = 86400;
+        } else if (sscanf(spec, "square:%lf:%lf:%lf:%lf", &a, &b, &c, &d) >= 3) {
+            p->kind = PROFILE_SQUARE;
+        } else {
+            printf("无法解析目标曲线: %s\n", spec);
+            return false;
         }
+        if (a < 0 || a > 100 || b < 0 || b > 100 || c <= 0 || d < 0 || d > 100) {
+            printf("目标曲线参数无效: %s\n", spec);
+            p->kind = PROFILE_NONE;
+            return false;
+        }
+        p->low = a;
+        p->high = b;
+        p->period = c;
+        p->duty = d / 100.0;
     }
     
-    // 应用内存变化率限制 - 变化大时减小调整因子
-    if (avg_memory_change_rate > 2.0) {
-        adjustment_factor *= 0.7; // 减小调整幅度以稳定系统
+    // 昼夜曲线按本地时间锚定: 当前时刻在周期中的位置，周期为86400时即一天中的位置，
+    // 其他周期时曲线是以本地时间零点为起点、每个周期重复一次的压缩(或拉长)的一天
+    if (p->kind == PROFILE_DIURNAL) {
+        time_t now = time(NULL);
+        struct tm* tm = localtime(&now);
+        // 本地时间自1970年起的秒数(POSIX的换算公式)
+        int y = tm->tm_year;
+        double days = tm->tm_yday + 365.0 * (y - 70) + (y - 69) / 4 - (y - 1) / 100 + (y + 299) / 400;
+        double local_sec = days * 86400.0 + tm->tm_hour * 3600 + tm->tm_min * 60 + tm->tm_sec;
+        p->phase = fmod(local_sec, p->period) / p->period;
     }
-    
-    needed_mem_percent *= adjustment_factor;
-    
-    // 添加改进的滞后效应，减少抖动
-    double hysteresis = 0.15;
-    // 接近目标时使用更小的滞后值，允许更精确调整
-    if (fabs(effective_gap) < 2.0) {
-        hysteresis = 0.05;
+    strncpy(p->spec, spec, sizeof(p->spec) - 1);
+    return true;
+}
+
+// 目标曲线在t秒(相对曲线起点)时的值
+double profile_value(const target_profile_t* p, double t) {
+    const double pi = 3.14159265358979323846;
+    if (t < 0) t = 0;
+    
+    switch (p->kind) {
+    case PROFILE_RAMP:
+        if (t >= p->period) return p->high;
+        return p->low + (p->high - p->low) * t / p->period;
+    case PROFILE_SINE:
+        return (p->low + p->high) / 2.0 + (p->high - p->low) / 2.0 * sin(2.0 * pi * t / p->period);
+    case PROFILE_DIURNAL: {
+        // 一个周期中的位置，周期的4/24处(周期为一天时即04:00)为最低点
+        double day = p->phase + t / p->period;
+        return p->low + (p->high - p->low) * (1.0 - cos(2.0 * pi * (day - 4.0 / 24.0))) / 2.0;
     }
-    
-    // 滞后效应处理
-    if (fabs(needed_mem_percent - prev_needed_mem_percent) < hysteresis) {
-        needed_mem_percent = prev_needed_mem_percent;
+    case PROFILE_SQUARE:
+        return fmod(t, p->period) < p->duty * p->period ? p->high : p->low;
+    case PROFILE_SCHEDULE: {
+        if (p->repeat && p->period > 0) t = fmod(t, p->period);
+        if (t <= p->point_time[0]) return p->point_value[0];
+        if (t >= p->point_time[p->num_points - 1]) return p->point_value[p->num_points - 1];
+        // 二分查找t所在的区间
+        int lo = 0, hi = p->num_points - 1;
+        while (hi - lo > 1) {
+            int mid = (lo + hi) / 2;
+            if (p->point_time[mid] <= t) lo = mid; else hi = mid;
+        }
+        double frac = (t - p->point_time[lo]) / (p->point_time[hi] - p->point_time[lo]);
+        return p->point_value[lo] + (p->point_value[hi] - p->point_value[lo]) * frac;
+    }
+    default:
+        return 0.0;
+    }
+}
+
+// 更新跟踪滞后估计，t为曲线时间，actual为测得的使用率
+// 设定值阶跃(单步超过5%)不计入变化率，阶跃后的误差只影响跟踪误差
+void profile_lag_update(profile_lag_t* lag, double t, double setpoint, double actual) {
+    if (!lag->started) {
+        lag->started = true;
+        lag->setpoint = setpoint;
+        lag->prev_time = t;
+        lag->error = actual - setpoint;
+        lag->lag = -1.0;
+        return;
+    }
+    double dt = t - lag->prev_time;
+    if (dt <= 0) return;
+    
+    double step = setpoint - lag->setpoint;
+    double slope = fabs(step) > 5.0 ? 0.0 : step / dt;
+    lag->slope = 0.7 * lag->slope + 0.3 * slope;
+    lag->error = 0.8 * lag->error + 0.2 * (actual - setpoint);
+    lag->setpoint = setpoint;
+    lag->prev_time = t;
+    
+    // 设定值变化足够快(每小时18%以上)时才能区分滞后和稳态误差
+    if (fabs(lag->slope) > 0.005) {
+        double estimate = -lag->error / lag->slope;
+        if (estimate < 0) estimate = 0;
+        if (estimate > 3600) estimate = 3600;
+        lag->lag = lag->lag < 0 ? estimate : 0.9 * lag->lag + 0.1 * estimate;
+    }
+}
+
+// 按目标曲线更新未分组核心的CPU目标，由CPU调整线程在每步控制前调用
+void cpu_profile_update(double now, double actual) {
+    if (cpu_profile.kind == PROFILE_NONE) return;
+    double t = now - profile_epoch;
+    double value = profile_value(&cpu_profile, t);
+    for (int i = 0; i < num_cpu_cores; i++) {
+        if (find_cpu_group(core_ctrls[i].cpu_id) < 0) {
+            core_ctrls[i].target = value;
+        }
+    }
+    profile_lag_update(&cpu_lag, t, get_overall_cpu_target(), actual);
+}
+
+// 按目标曲线更新内存目标，由内存控制步调用
+void mem_profile_update(double now, double actual, unsigned long long total_kb) {
+    if (mem_profile.kind == PROFILE_NONE) return;
+    double t = now - profile_epoch;
+    double value = profile_value(&mem_profile, t);
+    mem_target.kind = MEM_TARGET_PERCENT;
+    mem_target.value = value;
+    target_mem_usage_mb = (int)(mem_target_bytes(&mem_target, total_kb) / (1024 * 1024));
+    profile_lag_update(&mem_lag, t, value, actual);
+}
+
+// 格式化滞后估计，尚无估计时显示"-"
+void format_profile_lag(char* buf, size_t size, const profile_lag_t* lag) {
+    if (lag->lag < 0) {
+        snprintf(buf, size, "-");
     } else {
-        prev_needed_mem_percent = needed_mem_percent;
+        snprintf(buf, size, "%.1fs", lag->lag);
+    }
+}
+
+// 采样快照: 一次采样得到的系统和进程指标，CPU控制、内存控制和状态显示共用
+typedef struct {
+    unsigned long long seq;            // 采样序号
+    double timestamp;                  // 采样时间(秒, 单调时钟)
+    double cpu_usage;                  // 系统整体CPU使用率(%)
+    double self_cpu_usage;             // CMM自身CPU使用率(%)，占全部核心时间的比例
+    unsigned long long mem_total_kb;   // MemTotal
+    unsigned long long mem_free_kb;    // MemFree
+    unsigned long long mem_available_kb; // MemAvailable(老内核为估算值)
+    double mem_usage;                  // 系统内存使用率(%)，与free -m对齐
+    unsigned long long self_rss_kb;    // CMM自身常驻内存
+    unsigned long long cg_memory_current; // cgroup memory.current(字节)
+    unsigned long long cg_nr_periods;     // cgroup cpu.stat: 配额周期数
+    unsigned long long cg_nr_throttled;   // cgroup cpu.stat: 被限流的周期数
+    unsigned long long cg_throttled_usec; // cgroup cpu.stat: 累计限流时间
+} proc_snapshot_t;
+
+// 一次采样的原始累计计数，由指标源填写，派生指标统一在sampler_update中计算
+typedef struct {
+    double time;                       // 采样时间(秒)，实时源为单调时钟，轨迹源为录制时的相对时间
+    unsigned long long cpu_idle;       // 系统累计空闲时间(idle + iowait)
+    unsigned long long cpu_total;      // 系统累计总时间
+    int num_cores;                     // 有分核心数据的核心数，0表示只有整体数据
+    int core_capacity;                 // 分核心数组的容量
+    int* core_id;                      // 核心编号，升序
+    unsigned long long* core_idle;
+    unsigned long long* core_total;
+    unsigned long long mem_total_kb;
+    unsigned long long mem_free_kb;
+    unsigned long long mem_available_kb;
+    unsigned long long self_time;      // 进程累计CPU时间，与cpu_total单位相同
+    unsigned long long self_rss_kb;
+} proc_raw_t;
+
+// 指标源: 实时/proc(可指定根目录)、Windows系统接口，或者录制的轨迹文件
+typedef struct {
+    const char* name;
+    bool (*open)(const char* arg);     // arg为proc根目录或轨迹文件路径
+    bool (*read)(proc_raw_t* raw);     // 读取一次原始计数，返回false表示没有更多数据
+    void (*close)(void);
+} metric_source_t;
+
+char proc_root[256] = "/proc";   // --proc-root: 读取其他目录下的stat/meminfo/self/stat
+char replay_file[256] = "";      // --replay: 从轨迹文件回放指标
+char record_file[256] = "";      // --record: 把每次采样的原始计数录制到轨迹文件
+
+// 采样器状态: /proc文件保持打开，每次用pread重新读取到固定缓冲区
+typedef struct {
+#ifndef _WIN32
+    int stat_fd;                       // /proc/stat
+    int meminfo_fd;                    // /proc/meminfo
+    int self_stat_fd;                  // /proc/self/stat
+    char* stat_buf;                    // /proc/stat缓冲区，按核心数在初始化时分配
+    size_t stat_buf_size;
+    char meminfo_buf[8192];
+    char self_stat_buf[1024];
+    long page_size_kb;
+#endif
+    const metric_source_t* source;     // 当前指标源
+    proc_raw_t raw;                    // 最近一次读取的原始计数
+    FILE* replay_fp;                   // 回放的轨迹文件
+    FILE* record_fp;                   // 录制的轨迹文件
+    double record_start;               // 录制起点(第一次采样的时间)，负数表示尚未开始
+    bool finished;                     // 轨迹已回放完毕
+    unsigned long long prev_idle;      // 上次采样的系统空闲时间
+    unsigned long long prev_total;     // 上次采样的系统总时间
+    unsigned long long self_base_proc; // 自身CPU统计窗口起点: 进程时间
+    unsigned long long self_base_total; // 自身CPU统计窗口起点: 系统总时间
+    double self_base_time;             // 自身CPU统计窗口起点: 采样时间
+    proc_snapshot_t current;           // 采样线程内部使用的最新数据
+} sampler_t;
+
+sampler_t sampler;
+proc_snapshot_t published_snapshot; // 对外发布的快照
+#ifdef _WIN32
+CRITICAL_SECTION snapshot_cs;
+#else
+pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+// 获取单调时钟时间(秒)
+double get_monotonic_time() {
+    struct timespec ts;
+#ifdef _WIN32
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 获取单调时钟时间(纳秒)
+unsigned long long get_time_ns() {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (unsigned long long)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+           (unsigned long long)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// 获取当前线程消耗的CPU时间(纳秒)，被抢占的时间不计入
+unsigned long long get_thread_cpu_time_ns() {
+#ifdef _WIN32
+    FILETIME creation, exit_time, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit_time, &kernel, &user)) return 0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) * 100ULL;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// 对数分桶直方图，第i个桶统计[2^i, 2^(i+1))范围的值
+typedef struct {
+    unsigned long long buckets[64];
+    unsigned long long count;
+    unsigned long long sum;
+    unsigned long long max;
+} latency_hist_t;
+
+// CPU控制循环单次耗时(采样+一步控制)，只由CPU调整线程写入，指标导出时按原子读取
+worker_hist_t control_loop_hist;
+
+// 记录一个值
+void hist_record(latency_hist_t* hist, unsigned long long value) {
+    int bucket = value ? 63 - __builtin_clzll(value) : 0;
+    hist->buckets[bucket]++;
+    hist->count++;
+    hist->sum += value;
+    if (value > hist->max) hist->max = value;
+}
+
+// 平均值
+double hist_mean(const latency_hist_t* hist) {
+    return hist->count ? (double)hist->sum / hist->count : 0.0;
+}
+
+// 合并两个直方图
+void hist_merge(latency_hist_t* dst, const latency_hist_t* src) {
+    for (int i = 0; i < 64; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+// 估算百分位数，返回所在桶的上界(不超过最大值)
+unsigned long long hist_percentile(const latency_hist_t* hist, double percent) {
+    if (hist->count == 0) return 0;
+    unsigned long long rank = (unsigned long long)(hist->count * percent / 100.0);
+    unsigned long long seen = 0;
+    for (int i = 0; i < 64; i++) {
+        seen += hist->buckets[i];
+        if (seen > rank) {
+            unsigned long long upper = (i >= 63) ? hist->max : (2ULL << i) - 1;
+            return upper < hist->max ? upper : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+// 把单写者直方图累加到普通直方图；写者同时在更新，总数取各桶之和，保证与各桶一致
+void worker_hist_load(const worker_hist_t* hist, latency_hist_t* out) {
+    for (int b = 0; b < 64; b++) {
+        unsigned long long n = atomic_load_explicit(&hist->buckets[b], memory_order_relaxed);
+        out->buckets[b] += n;
+        out->count += n;
+    }
+    out->sum += atomic_load_explicit(&hist->sum, memory_order_relaxed);
+    unsigned long long max = atomic_load_explicit(&hist->max, memory_order_relaxed);
+    if (max > out->max) out->max = max;
+}
+
+// 读取一个单写者直方图的副本
+void worker_hist_copy(const worker_hist_t* hist, latency_hist_t* out) {
+    memset(out, 0, sizeof(*out));
+    worker_hist_load(hist, out);
+}
+
+// 汇总所有工作线程的同一个直方图，offset为直方图在worker_t中的偏移
+void worker_hists_collect(size_t offset, latency_hist_t* out) {
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < num_cpu_cores; i++) {
+        worker_hist_load((const worker_hist_t*)((const char*)&workers[i] + offset), out);
+    }
+}
+
+// 扩大原始计数的分核心数组
+bool proc_raw_reserve(proc_raw_t* raw, int capacity) {
+    if (capacity <= raw->core_capacity) return true;
+    int* ids = (int*)realloc(raw->core_id, capacity * sizeof(int));
+    if (!ids) return false;
+    raw->core_id = ids;
+    unsigned long long* idle = (unsigned long long*)realloc(raw->core_idle, capacity * sizeof(unsigned long long));
+    if (!idle) return false;
+    raw->core_idle = idle;
+    unsigned long long* total = (unsigned long long*)realloc(raw->core_total, capacity * sizeof(unsigned long long));
+    if (!total) return false;
+    raw->core_total = total;
+    raw->core_capacity = capacity;
+    return true;
+}
+
+// 释放原始计数的分核心数组
+void proc_raw_free(proc_raw_t* raw) {
+    free(raw->core_id);
+    free(raw->core_idle);
+    free(raw->core_total);
+    raw->core_id = NULL;
+    raw->core_idle = NULL;
+    raw->core_total = NULL;
+    raw->core_capacity = 0;
+    raw->num_cores = 0;
+}
+
+#ifndef _WIN32
+// 用pread从文件开头重新读取整个/proc文件，返回读取的字节数
+ssize_t read_proc_fd(int fd, char* buf, size_t size) {
+    if (fd < 0) return -1;
+    ssize_t n = pread(fd, buf, size - 1, 0);
+    if (n < 0) return -1;
+    buf[n] = '\0';
+    return n;
+}
+
+// 跳过空格并解析一个无符号整数
+unsigned long long parse_ull(const char** pp) {
+    const char* p = *pp;
+    while (*p == ' ' || *p == '\t') p++;
+    unsigned long long value = 0;
+    while (*p >= '0' && *p <= '9') {
+        value = value * 10 + (unsigned long long)(*p - '0');
+        p++;
+    }
+    *pp = p;
+    return value;
+}
+
+// 跳到下一行开头，返回NULL表示已到结尾
+const char* next_line(const char* p) {
+    while (*p && *p != '\n') p++;
+    return *p ? p + 1 : NULL;
+}
+
+// 解析"cpu"行的8个时间字段，得到空闲时间和总时间
+void parse_cpu_times(const char* p, unsigned long long* idle_out, unsigned long long* total_out) {
+    unsigned long long fields[8];
+    for (int i = 0; i < 8; i++) {
+        fields[i] = parse_ull(&p);
+    }
+    // user nice system idle iowait irq softirq steal
+    *idle_out = fields[3] + fields[4];
+    *total_out = fields[0] + fields[1] + fields[2] + fields[3] +
+                 fields[4] + fields[5] + fields[6] + fields[7];
+}
+
+// 解析/proc/stat中整体和每个核心的累计时间
+bool sampler_parse_stat(proc_raw_t* raw) {
+    if (read_proc_fd(sampler.stat_fd, sampler.stat_buf, sampler.stat_buf_size) <= 0) {
+        return false;
     }
     
-    // 如果需要释放内存，清理之前的内存分配
-    if (needed_mem_percent < -0.5) {
-        // 计算自适应释放比例，与差距成正比
-        int release_percent = (int)(fabs(needed_mem_percent) * 5.0);
-        if (release_percent < 3) release_percent = 3;
-        if (release_percent > 50) release_percent = 50;
-        
-        // 如果内存过载严重，增加释放量
-        if (needed_mem_percent < -5.0) {
-            release_percent += 10;
+    const char* line = sampler.stat_buf;
+    if (strncmp(line, "cpu ", 4) != 0) return false;
+    parse_cpu_times(line + 4, &raw->cpu_idle, &raw->cpu_total);
+    
+    // 每个核心的"cpuN"行，离线核心不出现
+    raw->num_cores = 0;
+    while ((line = next_line(line)) != NULL) {
+        if (strncmp(line, "cpu", 3) != 0) break;
+        const char* p = line + 3;
+        if (*p < '0' || *p > '9') continue;
+        if (raw->num_cores >= raw->core_capacity &&
+            !proc_raw_reserve(raw, raw->core_capacity * 2 + 8)) {
+            break;
         }
+        int n = raw->num_cores++;
+        raw->core_id[n] = (int)parse_ull(&p);
+        parse_cpu_times(p, &raw->core_idle[n], &raw->core_total[n]);
+    }
+    return true;
+}
+
+// 解析/proc/meminfo中需要的字段
+void sampler_parse_meminfo(proc_raw_t* raw) {
+    if (read_proc_fd(sampler.meminfo_fd, sampler.meminfo_buf, sizeof(sampler.meminfo_buf)) <= 0) {
+        // 如果无法读取/proc/meminfo，回退到sysinfo方法
+        struct sysinfo info;
+        if (sysinfo(&info) != 0) return;
+        // mem_unit通常为1(字节)，先乘再除，避免小于1024时换算出错
+        raw->mem_total_kb = (unsigned long long)info.totalram * info.mem_unit / 1024;
+        raw->mem_free_kb = (unsigned long long)info.freeram * info.mem_unit / 1024;
+        raw->mem_available_kb = ((unsigned long long)info.freeram + info.bufferram + info.sharedram) *
+                                info.mem_unit / 1024;
+        return;
+    }
+    
+    unsigned long long mem_total = 0, mem_free = 0, mem_available = 0;
+    unsigned long long buffers = 0, cached = 0, slab = 0;
+    const char* line = sampler.meminfo_buf;
+    
+    // 需要的字段都在文件前部，读到Slab后即可停止
+    while (line) {
+        const char* colon = strchr(line, ':');
+        if (!colon) break;
+        size_t key_len = (size_t)(colon - line);
+        const char* p = colon + 1;
         
-        int blocks_to_free = (allocated_blocks * release_percent) / 100;
-        if (blocks_to_free < 1 && allocated_blocks > 0) blocks_to_free = 1;
-        if (blocks_to_free > allocated_blocks) blocks_to_free = allocated_blocks;
-        
-        // 释放部分内存块
-        if (blocks_to_free > 0 && memory_blocks) {
-            if (verbose_mode) {
-                printf("释放 %d 个内存块 (约 %d MB)，比例: %d%%\n", 
-                      blocks_to_free, blocks_to_free * block_size_mb, release_percent);
-            }
-            
-            for (int i = allocated_blocks - 1; i >= allocated_blocks - blocks_to_free; i--) {
-                if (memory_blocks[i]) {
-                    free(memory_blocks[i]);
-                    memory_blocks[i] = NULL;
-                    allocated_mb -= block_size_mb;
-                }
-            }
-            
-            // 更新已分配块计数
-            allocated_blocks -= blocks_to_free;
-            
-            // 如果全部释放，也释放指针数组
-            if (allocated_blocks <= 0) {
-                free(memory_blocks);
-                memory_blocks = NULL;
-                allocated_blocks = 0;
-                allocated_mb = 0;
-            } else {
-                // 缩小内存块数组以减少资源占用
-                char** new_memory_blocks = (char**)realloc(memory_blocks, allocated_blocks * sizeof(char*));
-                if (new_memory_blocks) {
-                    memory_blocks = new_memory_blocks;
-                }
-            }
+        if (key_len == 8 && memcmp(line, "MemTotal", 8) == 0) {
+            mem_total = parse_ull(&p);
+        } else if (key_len == 7 && memcmp(line, "MemFree", 7) == 0) {
+            mem_free = parse_ull(&p);
+        } else if (key_len == 12 && memcmp(line, "MemAvailable", 12) == 0) {
+            mem_available = parse_ull(&p);
+        } else if (key_len == 7 && memcmp(line, "Buffers", 7) == 0) {
+            buffers = parse_ull(&p);
+        } else if (key_len == 6 && memcmp(line, "Cached", 6) == 0) {
+            cached = parse_ull(&p);
+        } else if (key_len == 4 && memcmp(line, "Slab", 4) == 0) {
+            slab = parse_ull(&p);
+            break;
         }
+        line = next_line(p);
     }
     
-    // 计算需要分配的内存量(MB)
-    unsigned long long needed_mem_mb = 0;
-    if (needed_mem_percent > 0) {
-        needed_mem_mb = (unsigned long long)(needed_mem_percent * total_system_memory_mb / 100.0);
-    }
+    if (mem_total == 0) return;
     
-    // 详细模式下输出内存分配信息
-    if (verbose_mode) {
-        printf("需要分配内存: %llu MB (当前: %.1f%% 实际/%.1f%% 滤波, 目标: %.1f%%, 差距: %.1f%%, 系数: %.1f, 变化率: %.2f%%)\n", 
-               needed_mem_mb, current_mem_usage_percent, filtered_mem_usage, 
-               target_mem_percent, effective_gap, adjustment_factor, avg_memory_change_rate);
+    // 如果有MemAvailable，优先使用它(更精确，Linux 3.14+)，否则兼容老版本内核的计算方式
+    if (mem_available == 0) {
+        unsigned long long reclaimable = mem_free + buffers + cached + slab;
+        mem_available = reclaimable < mem_total ? reclaimable : mem_total;
     }
     
-    if (needed_mem_mb == 0) {
+    raw->mem_total_kb = mem_total;
+    raw->mem_free_kb = mem_free;
+    raw->mem_available_kb = mem_available;
+}
+
+// 解析/proc/self/stat中的进程CPU时间(utime + stime)和RSS
+void sampler_parse_self_stat(proc_raw_t* raw) {
+    if (read_proc_fd(sampler.self_stat_fd, sampler.self_stat_buf, sizeof(sampler.self_stat_buf)) <= 0) {
         return;
     }
     
-    // 根据剩余分配量动态调整块大小，以实现更平滑的分配
-    if (needed_mem_mb > 4000)
-        block_size_mb = 64;
-    else if (needed_mem_mb > 1000)
-        block_size_mb = 32;
-    else if (needed_mem_mb > 200)
-        block_size_mb = 16;
-    else if (needed_mem_mb > 50)
-        block_size_mb = 8;
-    else if (needed_mem_mb > 10)
-        block_size_mb = 4;
-    else
-        block_size_mb = 2; // 较小块以实现更精细的控制
-    
-    int new_blocks = needed_mem_mb / block_size_mb;
-    if (new_blocks == 0 && needed_mem_mb > 0) new_blocks = 1;
-      // 限制每次分配的最大块数，实现更平滑的分配
-#ifdef _WIN32
-    // Windows系统上限制更严格
-    const int max_blocks_per_cycle = 300;
+    // 进程名可能包含空格，从最后一个')'之后开始计数，')'之后是第3个字段
+    const char* p = strrchr(sampler.self_stat_buf, ')');
+    if (!p) return;
+    p++;
+    
+    unsigned long long utime = 0, stime = 0, rss_pages = 0;
+    for (int field = 3; field <= 24; field++) {
+        while (*p == ' ') p++;
+        if (field == 14) {
+            utime = parse_ull(&p);
+        } else if (field == 15) {
+            stime = parse_ull(&p);
+        } else if (field == 24) {
+            rss_pages = parse_ull(&p);
+        } else {
+            // 跳过不需要的字段(可能为负数或字符)
+            while (*p && *p != ' ') p++;
+        }
+    }
     
-    // 应用限制 - Windows版本
-    if (new_blocks > allocated_blocks + max_blocks_per_cycle) {
-        new_blocks = allocated_blocks + max_blocks_per_cycle;
+    raw->self_time = utime + stime;
+    raw->self_rss_kb = rss_pages * (unsigned long long)sampler.page_size_kb;
+}
+
+// 打开proc根目录下的文件
+int open_proc_file(const char* root, const char* name) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", root, name);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+// proc指标源: 打开root下的stat、meminfo和self/stat
+// 其他根目录(例如拷贝出来的测试数据)没有self/stat时使用本进程的/proc/self/stat
+bool proc_source_open(const char* root) {
+    sampler.stat_fd = open_proc_file(root, "stat");
+    sampler.meminfo_fd = open_proc_file(root, "meminfo");
+    sampler.self_stat_fd = open_proc_file(root, "self/stat");
+    if (sampler.self_stat_fd < 0) {
+        sampler.self_stat_fd = open("/proc/self/stat", O_RDONLY | O_CLOEXEC);
+    }
+    if (sampler.stat_fd < 0 && strcmp(root, "/proc") != 0) {
+        printf("无法打开%s/stat: %s\n", root, strerror(errno));
+        return false;
     }
+    sampler.page_size_kb = sysconf(_SC_PAGESIZE) / 1024;
+    if (sampler.page_size_kb < 1) sampler.page_size_kb = 4;
+    
+    // 每个核心一行，另加汇总行和其他统计行的余量
+    long conf_cpus = sysconf(_SC_NPROCESSORS_CONF);
+    if (conf_cpus < 1) conf_cpus = 1;
+    sampler.stat_buf_size = (size_t)conf_cpus * 160 + 8192;
+    sampler.stat_buf = (char*)malloc(sampler.stat_buf_size);
+    if (!sampler.stat_buf) return false;
+    return proc_raw_reserve(&sampler.raw, (int)conf_cpus);
+}
+
+// proc指标源: 读取一次
+bool proc_source_read(proc_raw_t* raw) {
+    raw->time = get_monotonic_time();
+    sampler_parse_stat(raw);
+    sampler_parse_meminfo(raw);
+    sampler_parse_self_stat(raw);
+    return true;
+}
+
+// proc指标源: 关闭文件
+void proc_source_close() {
+    if (sampler.stat_fd >= 0) close(sampler.stat_fd);
+    if (sampler.meminfo_fd >= 0) close(sampler.meminfo_fd);
+    if (sampler.self_stat_fd >= 0) close(sampler.self_stat_fd);
+    sampler.stat_fd = sampler.meminfo_fd = sampler.self_stat_fd = -1;
+    free(sampler.stat_buf);
+    sampler.stat_buf = NULL;
+}
+
+const metric_source_t proc_source = { "proc", proc_source_open, proc_source_read, proc_source_close };
 #else
-    // Linux系统上的限制
-    const int max_blocks_per_cycle = 500;
+// FILETIME转换为100纳秒计数
+unsigned long long filetime_to_ull(const FILETIME* ft) {
+    ULARGE_INTEGER value;
+    value.LowPart = ft->dwLowDateTime;
+    value.HighPart = ft->dwHighDateTime;
+    return value.QuadPart;
+}
+
+// Windows指标源: 系统接口无需打开
+bool win32_source_open(const char* arg) {
+    (void)arg;
+    return true;
+}
+
+// Windows指标源: GetSystemTimes只提供整体数据，没有分核心计数
+bool win32_source_read(proc_raw_t* raw) {
+    raw->time = get_monotonic_time();
+    raw->num_cores = 0;
+    
+    FILETIME idle_time, kernel_time, user_time;
+    if (GetSystemTimes(&idle_time, &kernel_time, &user_time)) {
+        // kernel时间包含idle时间
+        raw->cpu_idle = filetime_to_ull(&idle_time);
+        raw->cpu_total = filetime_to_ull(&kernel_time) + filetime_to_ull(&user_time);
+    }
     
-    // 根据内存变化率自适应调整每次最大分配量
-    int adjusted_max_blocks = max_blocks_per_cycle;
-    if (avg_memory_change_rate > 2.0) {
-        // 变化率大，减少每次分配量
-        adjusted_max_blocks = max_blocks_per_cycle / 2;
-    } else if (avg_memory_change_rate < 0.5) {
-        // 变化率小，可以增加每次分配量
-        adjusted_max_blocks = max_blocks_per_cycle * 3 / 2;
+    // 内存
+    MEMORYSTATUSEX memInfo;
+    memInfo.dwLength = sizeof(MEMORYSTATUSEX);
+    if (GlobalMemoryStatusEx(&memInfo)) {
+        raw->mem_total_kb = memInfo.ullTotalPhys / 1024;
+        raw->mem_free_kb = memInfo.ullAvailPhys / 1024;
+        raw->mem_available_kb = memInfo.ullAvailPhys / 1024;
     }
     
-    // 应用自适应限制
-    if (new_blocks > allocated_blocks + adjusted_max_blocks) {
-        new_blocks = allocated_blocks + adjusted_max_blocks;
+    // 进程自身CPU时间和工作集
+    FILETIME creation_time, exit_time, proc_kernel_time, proc_user_time;
+    if (GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &proc_kernel_time, &proc_user_time)) {
+        raw->self_time = filetime_to_ull(&proc_kernel_time) + filetime_to_ull(&proc_user_time);
+    }
+    PROCESS_MEMORY_COUNTERS_EX pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&pmc, sizeof(pmc))) {
+        raw->self_rss_kb = (unsigned long long)pmc.WorkingSetSize / 1024;
     }
+    return true;
+}
+
+// Windows指标源: 无需关闭
+void win32_source_close() {
+}
+
+const metric_source_t win32_source = { "win32", win32_source_open, win32_source_read, win32_source_close };
 #endif
+
+// 轨迹文件: 文本格式，首行为"# cmm-trace 1"，以'#'开头的行为注释，之后每行一次采样:
+// 时间 空闲 总时间 内存总量KB 空闲KB 可用KB 进程CPU时间 进程RSS_KB 核心数 [核心号 空闲 总时间]...
+#define TRACE_MAGIC "# cmm-trace 1"
+
+// 写入轨迹文件头
+void trace_write_header(FILE* fp) {
+    fprintf(fp, "%s\n", TRACE_MAGIC);
+    fprintf(fp, "# time cpu_idle cpu_total mem_total_kb mem_free_kb mem_available_kb self_time self_rss_kb ncores [id idle total]...\n");
+}
+
+// 写入一条采样，time为相对录制起点的秒数
+void trace_write_record(FILE* fp, const proc_raw_t* raw, double time) {
+    fprintf(fp, "%.3f %llu %llu %llu %llu %llu %llu %llu %d",
+            time, raw->cpu_idle, raw->cpu_total, raw->mem_total_kb, raw->mem_free_kb,
+            raw->mem_available_kb, raw->self_time, raw->self_rss_kb, raw->num_cores);
+    for (int i = 0; i < raw->num_cores; i++) {
+        fprintf(fp, " %d %llu %llu", raw->core_id[i], raw->core_idle[i], raw->core_total[i]);
+    }
+    fputc('\n', fp);
+}
+
+// 打开轨迹文件并检查文件头
+FILE* trace_open(const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        printf("无法打开轨迹文件%s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    char header[64];
+    if (!fgets(header, sizeof(header), fp) || strncmp(header, TRACE_MAGIC, strlen(TRACE_MAGIC)) != 0) {
+        printf("不是有效的轨迹文件: %s\n", path);
+        fclose(fp);
+        return NULL;
+    }
+    return fp;
+}
+
+// 读取下一条采样，跳过空行和注释，返回false表示文件结束或格式错误
+bool trace_read_record(FILE* fp, proc_raw_t* raw) {
+    int c;
+    while ((c = fgetc(fp)) != EOF) {
+        if (c == '#') {
+            while ((c = fgetc(fp)) != EOF && c != '\n');
+        } else if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+            ungetc(c, fp);
+            break;
+        }
+    }
+    if (c == EOF) return false;
     
-    // 处理现有分配
-    if (allocated_blocks > 0) {
-        // 计算需要增加或减少的块数
-        int diff_blocks = new_blocks - allocated_blocks;
-        
-        if (diff_blocks > 0) {
-            // 需要增加内存块
-            char** new_memory_blocks = (char**)realloc(memory_blocks, new_blocks * sizeof(char*));
-            if (!new_memory_blocks) {
-                if (verbose_mode) {
-                    printf("无法重新分配内存块数组\n");
-                }
-                consecutive_failed_allocations++;
-                return;
+    int cores = 0;
+    if (fscanf(fp, "%lf %llu %llu %llu %llu %llu %llu %llu %d",
+               &raw->time, &raw->cpu_idle, &raw->cpu_total, &raw->mem_total_kb, &raw->mem_free_kb,
+               &raw->mem_available_kb, &raw->self_time, &raw->self_rss_kb, &cores) != 9) {
+        return false;
+    }
+    if (cores < 0 || !proc_raw_reserve(raw, cores)) return false;
+    for (int i = 0; i < cores; i++) {
+        if (fscanf(fp, "%d %llu %llu", &raw->core_id[i], &raw->core_idle[i], &raw->core_total[i]) != 3) {
+            return false;
+        }
+    }
+    raw->num_cores = cores;
+    return true;
+}
+
+// 轨迹指标源: 每次采样读取一条记录，按采样周期实时回放
+bool trace_source_open(const char* path) {
+    sampler.replay_fp = trace_open(path);
+    return sampler.replay_fp != NULL;
+}
+
+bool trace_source_read(proc_raw_t* raw) {
+    return trace_read_record(sampler.replay_fp, raw);
+}
+
+void trace_source_close() {
+    if (sampler.replay_fp) fclose(sampler.replay_fp);
+    sampler.replay_fp = NULL;
+}
+
+const metric_source_t trace_source = { "trace", trace_source_open, trace_source_read, trace_source_close };
+
+// cgroup v2: 容器中按cgroup的CPU和内存限制计算目标和用量
+typedef enum {
+    SCOPE_AUTO = 0,  // 检测到cgroup的CPU或内存限制时按cgroup，否则按主机
+    SCOPE_HOST,      // 目标相对于整个主机
+    SCOPE_CGROUP     // 目标相对于cgroup的限制，用量也按cgroup统计
+} target_scope_t;
+
+target_scope_t target_scope = SCOPE_AUTO;
+char cgroup_dir[512] = ""; // --cgroup: 指定cgroup目录，默认从/proc/self/cgroup和mountinfo查找
+
+typedef struct {
+    bool detected;                  // 找到了本进程的cgroup v2目录
+    bool active;                    // 目标和用量按cgroup计算
+    char path[512];
+    double cpu_limit;               // cpu.max换算的核心数(取路径上最严格的一级)，0为不限制
+    double capacity;                // CPU容量(核心数) = min(cpu_limit, 工作线程数)
+    unsigned long long memory_max;  // memory.max(取路径上最严格的一级)，0为不限制
+    double prev_time;               // 上次采样时刻
+    unsigned long long prev_usage_usec;
+#ifndef _WIN32
+    int cpu_stat_fd;                // cpu.stat
+    int mem_current_fd;             // memory.current
+    int mem_stat_fd;                // memory.stat
+    char buf[8192];
+#endif
+} cgroup_t;
+
+cgroup_t cgroup = {0};
+
+// 解析目标范围
+bool parse_target_scope(const char* s) {
+    if (strcmp(s, "auto") == 0) target_scope = SCOPE_AUTO;
+    else if (strcmp(s, "host") == 0) target_scope = SCOPE_HOST;
+    else if (strcmp(s, "cgroup") == 0) target_scope = SCOPE_CGROUP;
+    else return false;
+    return true;
+}
+
+#ifndef _WIN32
+// 读取cgroup目录下的一个小文件(去掉末尾换行)
+bool cgroup_read_file(const char* dir, const char* name, char* buf, size_t size) {
+    char path[640];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    ssize_t n = read_proc_fd(fd, buf, size);
+    close(fd);
+    if (n <= 0) return false;
+    buf[strcspn(buf, "\n")] = '\0';
+    return true;
+}
+
+// 查找cgroup2的挂载点(混合模式下通常是/sys/fs/cgroup/unified)
+bool cgroup_find_mount(char* mount, size_t size) {
+    FILE* fp = fopen("/proc/self/mountinfo", "r");
+    if (!fp) return false;
+    char line[1024];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), fp)) {
+        // 挂载点是第5个字段，文件系统类型在" - "之后
+        char point[512];
+        const char* sep = strstr(line, " - ");
+        if (sep && strncmp(sep + 3, "cgroup2 ", 8) == 0 &&
+            sscanf(line, "%*s %*s %*s %*s %511s", point) == 1) {
+            snprintf(mount, size, "%s", point);
+            found = true;
+        }
+    }
+    fclose(fp);
+    return found;
+}
+
+// 从cgroup目录逐级向上读取cpu.max和memory.max，取最严格的限制
+void cgroup_read_limits(cgroup_t* cg) {
+    char dir[512], value[640];
+    snprintf(dir, sizeof(dir), "%s", cg->path);
+    cg->cpu_limit = 0.0;
+    cg->memory_max = 0;
+    for (;;) {
+        // 只在cgroup v2层级内向上查找(每一级都有cgroup.controllers)
+        snprintf(value, sizeof(value), "%s/cgroup.controllers", dir);
+        if (access(value, F_OK) != 0) break;
+        
+        long long quota, period;
+        if (cgroup_read_file(dir, "cpu.max", value, sizeof(value)) &&
+            sscanf(value, "%lld %lld", &quota, &period) == 2 && quota > 0 && period > 0) {
+            double cores = (double)quota / period;
+            if (cg->cpu_limit == 0.0 || cores < cg->cpu_limit) cg->cpu_limit = cores;
+        }
+        unsigned long long bytes;
+        if (cgroup_read_file(dir, "memory.max", value, sizeof(value)) &&
+            sscanf(value, "%llu", &bytes) == 1) {
+            if (cg->memory_max == 0 || bytes < cg->memory_max) cg->memory_max = bytes;
+        }
+        char* slash = strrchr(dir, '/');
+        if (!slash || slash == dir) break;
+        *slash = '\0';
+    }
+}
+#endif
+
+// 检测本进程的cgroup并读取限制；回放或读取其他proc目录时不使用cgroup
+void cgroup_init() {
+    memset(&cgroup, 0, sizeof(cgroup));
+#ifndef _WIN32
+    cgroup.cpu_stat_fd = cgroup.mem_current_fd = cgroup.mem_stat_fd = -1;
+    if (target_scope == SCOPE_HOST || replay_file[0] || strcmp(proc_root, "/proc") != 0) return;
+    
+    if (cgroup_dir[0]) {
+        snprintf(cgroup.path, sizeof(cgroup.path), "%s", cgroup_dir);
+    } else {
+        // v2的条目为"0::<路径>"，路径相对于cgroup2挂载点
+        char mount[256], line[512], rel[512] = "";
+        FILE* fp = fopen("/proc/self/cgroup", "r");
+        if (!fp) return;
+        while (fgets(line, sizeof(line), fp)) {
+            if (strncmp(line, "0::", 3) == 0) {
+                snprintf(rel, sizeof(rel), "%s", line + 3);
+                rel[strcspn(rel, "\n")] = '\0';
+                break;
             }
-            memory_blocks = new_memory_blocks;
+        }
+        fclose(fp);
+        if (!rel[0] || !cgroup_find_mount(mount, sizeof(mount))) return;
+        snprintf(cgroup.path, sizeof(cgroup.path), "%s%s", mount, strcmp(rel, "/") == 0 ? "" : rel);
+    }
+    
+    char path[640];
+    snprintf(path, sizeof(path), "%s/cpu.stat", cgroup.path);
+    cgroup.cpu_stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (cgroup.cpu_stat_fd < 0) {
+        if (cgroup_dir[0]) printf("无法打开%s: %s\n", path, strerror(errno));
+        return;
+    }
+    snprintf(path, sizeof(path), "%s/memory.current", cgroup.path);
+    cgroup.mem_current_fd = open(path, O_RDONLY | O_CLOEXEC);
+    snprintf(path, sizeof(path), "%s/memory.stat", cgroup.path);
+    cgroup.mem_stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+    
+    cgroup_read_limits(&cgroup);
+    cgroup.detected = true;
+    cgroup.active = target_scope == SCOPE_CGROUP ||
+                    (target_scope == SCOPE_AUTO && (cgroup.cpu_limit > 0 || cgroup.memory_max > 0));
+#endif
+}
+
+// 工作线程数确定后计算CPU容量，按cgroup计算时工作线程的份额按容量缩放
+void cgroup_set_capacity(int workers_count) {
+    cgroup.capacity = workers_count;
+    if (cgroup.cpu_limit > 0 && cgroup.cpu_limit < cgroup.capacity) cgroup.capacity = cgroup.cpu_limit;
+    cpu_share_scale = cgroup.active ? cgroup.capacity / workers_count : 1.0;
+}
+
+// 关闭cgroup文件
+void cgroup_close() {
+#ifndef _WIN32
+    if (cgroup.cpu_stat_fd >= 0) close(cgroup.cpu_stat_fd);
+    if (cgroup.mem_current_fd >= 0) close(cgroup.mem_current_fd);
+    if (cgroup.mem_stat_fd >= 0) close(cgroup.mem_stat_fd);
+    cgroup.cpu_stat_fd = cgroup.mem_current_fd = cgroup.mem_stat_fd = -1;
+#endif
+}
+
+// 读取cgroup的CPU和内存计数写入快照；按cgroup计算时用cgroup的数值代替主机的使用率和内存总量
+void cgroup_sample(proc_snapshot_t* snap, double now) {
+#ifdef _WIN32
+    (void)snap;
+    (void)now;
+#else
+    if (!cgroup.detected) return;
+    
+    unsigned long long usage_usec = 0;
+    if (read_proc_fd(cgroup.cpu_stat_fd, cgroup.buf, sizeof(cgroup.buf)) > 0) {
+        char key[64];
+        unsigned long long value;
+        for (const char* line = cgroup.buf; line; line = next_line(line)) {
+            if (sscanf(line, "%63s %llu", key, &value) != 2) continue;
+            if (strcmp(key, "usage_usec") == 0) usage_usec = value;
+            else if (strcmp(key, "nr_periods") == 0) snap->cg_nr_periods = value;
+            else if (strcmp(key, "nr_throttled") == 0) snap->cg_nr_throttled = value;
+            else if (strcmp(key, "throttled_usec") == 0) snap->cg_throttled_usec = value;
+        }
+    }
+    unsigned long long inactive_file = 0;
+    if (read_proc_fd(cgroup.mem_current_fd, cgroup.buf, sizeof(cgroup.buf)) > 0) {
+        snap->cg_memory_current = strtoull(cgroup.buf, NULL, 10);
+    }
+    if (read_proc_fd(cgroup.mem_stat_fd, cgroup.buf, sizeof(cgroup.buf)) > 0) {
+        const char* p = strstr(cgroup.buf, "inactive_file ");
+        if (p) inactive_file = strtoull(p + 14, NULL, 10);
+    }
+    
+    double cpu_usage = -1.0;
+    if (cgroup.prev_time > 0 && now > cgroup.prev_time && usage_usec >= cgroup.prev_usage_usec &&
+        cgroup.capacity > 0) {
+        cpu_usage = (double)(usage_usec - cgroup.prev_usage_usec) * 100.0 /
+                    ((now - cgroup.prev_time) * 1e6 * cgroup.capacity);
+        if (cpu_usage > 100.0) cpu_usage = 100.0;
+    }
+    cgroup.prev_time = now;
+    cgroup.prev_usage_usec = usage_usec;
+    
+    if (!cgroup.active) return;
+    
+    // CPU: 整体使用率为cgroup用量占容量的比例；各核心的使用率仍来自/proc/stat，
+    // 采样时已按份额换算，核心之间外部负载的差异不受影响
+    if (cpu_usage >= 0) {
+        snap->cpu_usage = cpu_usage;
+    }
+    
+    // 内存: 总量为memory.max(不超过主机内存)，已用为memory.current减去可回收的非活跃文件页
+    if (cgroup.mem_current_fd >= 0) {
+        unsigned long long total_kb = snap->mem_total_kb;
+        if (cgroup.memory_max > 0 && cgroup.memory_max / 1024 < total_kb) total_kb = cgroup.memory_max / 1024;
+        unsigned long long used_kb = snap->cg_memory_current > inactive_file ?
+                                     (snap->cg_memory_current - inactive_file) / 1024 : 0;
+        if (used_kb > total_kb) used_kb = total_kb;
+        snap->mem_total_kb = total_kb;
+        snap->mem_available_kb = total_kb - used_kb;
+        snap->mem_free_kb = snap->mem_available_kb;
+        snap->mem_usage = total_kb ? (double)used_kb * 100.0 / total_kb : 0.0;
+    }
+#endif
+}
+
+// 采样一次所有指标并发布快照，由CPU调整线程周期性调用
+void sampler_update() {
+    proc_snapshot_t* snap = &sampler.current;
+    proc_raw_t* raw = &sampler.raw;
+    double now = get_monotonic_time();
+    
+    if (sampler.finished) return;
+    if (!sampler.source->read(raw)) {
+        // 轨迹回放完毕，结束运行
+        printf("\n指标轨迹回放结束\n");
+        sampler.finished = true;
+        running = 0;
+        return;
+    }
+    if (sampler.record_fp) {
+        if (sampler.record_start < 0) sampler.record_start = raw->time;
+        trace_write_record(sampler.record_fp, raw, raw->time - sampler.record_start);
+    }
+    
+    // 整体CPU使用率
+    unsigned long long idle_diff = raw->cpu_idle - sampler.prev_idle;
+    unsigned long long total_diff = raw->cpu_total - sampler.prev_total;
+    if (sampler.prev_total != 0 && total_diff > 0 && idle_diff <= total_diff) {
+        snap->cpu_usage = 100.0 * (1.0 - (double)idle_diff / total_diff);
+    }
+    sampler.prev_idle = raw->cpu_idle;
+    sampler.prev_total = raw->cpu_total;
+    
+    // 每个核心的使用率，core_ctrls和原始计数都按cpu_id升序排列，顺序匹配即可
+    if (core_ctrls != NULL && raw->num_cores == 0) {
+        // 没有分核心数据时所有核心使用整体使用率
+        for (int i = 0; i < num_cpu_cores; i++) {
+            core_ctrls[i].usage = snap->cpu_usage;
+        }
+    } else if (core_ctrls != NULL) {
+        int idx = 0;
+        for (int j = 0; j < raw->num_cores && idx < num_cpu_cores; j++) {
+            while (idx < num_cpu_cores && core_ctrls[idx].cpu_id < raw->core_id[j]) idx++;
+            if (idx >= num_cpu_cores || core_ctrls[idx].cpu_id != raw->core_id[j]) continue;
             
-            // 初始化新增的指针为NULL
-            for (int i = allocated_blocks; i < new_blocks; i++) {
-                memory_blocks[i] = NULL;
-            }
+            core_ctrl_t* core = &core_ctrls[idx];
+            long long core_idle_diff = (long long)raw->core_idle[j] - core->prev_idle;
+            long long core_total_diff = (long long)raw->core_total[j] - core->prev_total;
+            core->prev_idle = (long long)raw->core_idle[j];
+            core->prev_total = (long long)raw->core_total[j];
             
-            // 分配新增的块
-            int success_count = 0;
-            for (int i = allocated_blocks; i < new_blocks; i++) {                memory_blocks[i] = (char*)malloc(block_size_mb * 1024 * 1024);
-                if (memory_blocks[i]) {
-                    // 采用高效的内存初始化方法：只写入部分数据以确保物理内存被分配
-                    for (int j = 0; j < block_size_mb; j += 2) {
-                        size_t offset = j * 1024 * 1024;
-                        memset(memory_blocks[i] + offset, 0xAA, 1024 * 256); // 只写入256KB
-                    }
-                    allocated_mb += block_size_mb;
-                    success_count++;
-                } else {
-                    if (verbose_mode) {
-                        printf("无法分配内存块 #%d\n", i);
-                    }
-                    consecutive_failed_allocations++;
-                    break; // 停止继续分配
-                }
+            if (core_total_diff > 0 && core_idle_diff >= 0 && core_idle_diff <= core_total_diff) {
+                // 按cgroup计算时换算为占每个工作线程份额的比例，与自身占用同一口径
+                core->usage = 100.0 * (1.0 - (double)core_idle_diff / core_total_diff) / cpu_share_scale;
+                if (core->usage > 100.0) core->usage = 100.0;
             }
+            idx++;
+        }
+    }
+    
+    // 内存
+    snap->mem_total_kb = raw->mem_total_kb;
+    snap->mem_free_kb = raw->mem_free_kb;
+    snap->mem_available_kb = raw->mem_available_kb;
+    snap->self_rss_kb = raw->self_rss_kb;
+    
+    // 计算与free -m对齐的内存使用率
+    if (snap->mem_total_kb > 0) {
+        unsigned long long used_kb = snap->mem_total_kb - snap->mem_available_kb;
+        // 确保不出现负值
+        if (snap->mem_available_kb > snap->mem_total_kb) used_kb = 0;
+        snap->mem_usage = (double)used_kb * 100.0 / snap->mem_total_kb;
+    }
+    
+    // 自身CPU使用率至少统计1秒，避免短周期内时钟节拍带来的抖动
+    // 窗口按采样时间计算，回放时使用录制时的时间
+    unsigned long long process_time = raw->self_time;
+    unsigned long long total_time = raw->cpu_total;
+    if (sampler.self_base_total == 0) {
+        sampler.self_base_proc = process_time;
+        sampler.self_base_total = total_time;
+        sampler.self_base_time = raw->time;
+    } else if (raw->time - sampler.self_base_time >= 1.0 && total_time > sampler.self_base_total) {
+        // 进程时间变化 / 系统总时间变化 * 100，与系统整体使用率的口径一致
+        double cpu_usage = (double)(process_time - sampler.self_base_proc) * 100.0 /
+                           (double)(total_time - sampler.self_base_total);
+        if (isnan(cpu_usage) || cpu_usage < 0) cpu_usage = 0.0;
+        // 按cgroup计算时换算为占cgroup CPU容量的比例
+        if (cgroup.active && cgroup.capacity > 0 && raw->num_cores > 0) {
+            cpu_usage = cpu_usage * raw->num_cores / cgroup.capacity;
+        }
+        if (cpu_usage > 100.0) cpu_usage = 100.0;
+        snap->self_cpu_usage = cpu_usage;
+        sampler.self_base_proc = process_time;
+        sampler.self_base_total = total_time;
+        sampler.self_base_time = raw->time;
+    }
+    
+    cgroup_sample(snap, now);
+    snap->seq++;
+    snap->timestamp = now;
+    
+    // 发布快照
+#ifdef _WIN32
+    EnterCriticalSection(&snapshot_cs);
+    published_snapshot = *snap;
+    LeaveCriticalSection(&snapshot_cs);
+#else
+    pthread_mutex_lock(&snapshot_mutex);
+    published_snapshot = *snap;
+    pthread_mutex_unlock(&snapshot_mutex);
+#endif
+}
+
+// 读取最新发布的快照
+void sampler_get(proc_snapshot_t* out) {
+#ifdef _WIN32
+    EnterCriticalSection(&snapshot_cs);
+    *out = published_snapshot;
+    LeaveCriticalSection(&snapshot_cs);
+#else
+    pthread_mutex_lock(&snapshot_mutex);
+    *out = published_snapshot;
+    pthread_mutex_unlock(&snapshot_mutex);
+#endif
+}
+
+// 初始化采样器: 按--replay/--proc-root选择指标源，打开--record轨迹文件并完成首次采样
+bool sampler_init() {
+    memset(&sampler, 0, sizeof(sampler));
+    const char* arg = proc_root;
+#ifdef _WIN32
+    InitializeCriticalSection(&snapshot_cs);
+    sampler.source = &win32_source;
+#else
+    sampler.stat_fd = sampler.meminfo_fd = sampler.self_stat_fd = -1;
+    sampler.source = &proc_source;
+#endif
+    if (replay_file[0]) {
+        sampler.source = &trace_source;
+        arg = replay_file;
+    }
+    if (!sampler.source->open(arg)) return false;
+    
+    if (record_file[0]) {
+        sampler.record_fp = fopen(record_file, "w");
+        if (!sampler.record_fp) {
+            printf("无法创建轨迹文件%s: %s\n", record_file, strerror(errno));
+            return false;
+        }
+        // 按行缓冲，异常退出时轨迹也是完整的
+        setvbuf(sampler.record_fp, NULL, _IOLBF, 0);
+        trace_write_header(sampler.record_fp);
+        sampler.record_start = -1.0;
+    }
+    
+    sampler_update();
+    return !sampler.finished;
+}
+
+// 关闭采样器
+void sampler_close() {
+#ifdef _WIN32
+    DeleteCriticalSection(&snapshot_cs);
+#endif
+    if (sampler.source) sampler.source->close();
+    if (sampler.record_fp) fclose(sampler.record_fp);
+    sampler.record_fp = NULL;
+    proc_raw_free(&sampler.raw);
+}
+
+// 守护进程fork之后重新打开自身的stat: /proc/self在打开时已解析为父进程的目录，父进程退出后读不到新进程
+void sampler_reopen_self() {
+#ifndef _WIN32
+    if (sampler.source != &proc_source) return;
+    if (sampler.self_stat_fd >= 0) close(sampler.self_stat_fd);
+    sampler.self_stat_fd = open_proc_file(proc_root, "self/stat");
+    if (sampler.self_stat_fd < 0) {
+        sampler.self_stat_fd = open("/proc/self/stat", O_RDONLY | O_CLOEXEC);
+    }
+    // 新进程的累计CPU时间从零开始，重新建立统计基准
+    sampler.self_base_total = 0;
+    sampler_update();
+#endif
+}
+
+// 获取系统总内存大小(MB)
+unsigned long long get_total_system_memory() {
+    proc_snapshot_t snap;
+    sampler_get(&snap);
+    return snap.mem_total_kb / 1024;
+}
+
+// 处理中断信号
+void signal_handler(int sig) {
+    printf("\n收到中断信号，程序即将退出...\n");
+    running = 0;
+}
+
+// 直接CPU占用函数 - 纯计算模式，不休息
+void spinCPU(unsigned long long cycles) {
+    volatile unsigned long long i;
+    volatile double result = 0.0;
+    
+    for (i = 0; i < cycles; i++) {
+        result += i * 3.14159265358979323846 * 1.732050807568877;
+        // 增加一些额外计算，提高工作强度
+        result = result / (1.0 + (i % 5) * 0.01) + sqrt(i % 10);
+    }
+}
+
+// 防止编译器优化掉计算结果
+volatile unsigned long long burn_sink_u64 = 0;
+volatile double burn_sink_f64 = 0.0;
+
+// 标量浮点内核: 原来的spinCPU，每次迭代约6次浮点运算
+unsigned long long burn_scalar(unsigned long long iterations) {
+    spinCPU(iterations);
+    return iterations * 6;
+}
+
+// 整数/ALU内核: xorshift、乘法、移位和循环移位混合，每次迭代约12次整数运算
+unsigned long long burn_integer(unsigned long long iterations) {
+    uint64_t x = 0x9E3779B97F4A7C15ULL ^ iterations;
+    uint64_t y = 0xD1B54A32D192ED03ULL;
+    uint64_t z = 0;
+    for (unsigned long long i = 0; i < iterations; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        y = y * 6364136223846793005ULL + x;
+        z += (y >> 29) ^ ((x << 11) | (x >> 53));
+    }
+    burn_sink_u64 = z;
+    return iterations * 12;
+}
+
+// 分支内核: 数据相关的条件分支和跳转表，主要压测分支预测器，每次迭代计1次分支
+unsigned long long burn_branch(unsigned long long iterations) {
+    uint64_t state = 0x2545F4914F6CDD1DULL ^ iterations;
+    uint64_t acc = 0;
+    for (unsigned long long i = 0; i < iterations; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        switch ((state >> 59) & 7) {
+            case 0: acc += state; break;
+            case 1: acc ^= state >> 7; break;
+            case 2: acc -= i; break;
+            case 3: acc = (acc << 3) | (acc >> 61); break;
+            case 4: acc *= 3; break;
+            case 5: acc += i * 7; break;
+            case 6: acc ^= i; break;
+            default: acc--; break;
+        }
+        if ((state >> 40) & 1) {
+            acc += 11;
+        }
+    }
+    burn_sink_u64 = acc;
+    return iterations;
+}
+
+// 低功耗自旋内核: 只执行PAUSE，占用CPU时间但几乎不消耗执行单元
+unsigned long long burn_pause(unsigned long long iterations) {
+    for (unsigned long long i = 0; i < iterations; i++) {
+        cpu_relax();
+    }
+    return iterations;
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(_WIN32)
+// AVX2 FMA内核: 8条独立的乘加依赖链填满FMA流水线，每次迭代8*4*2次浮点运算
+// MinGW不保证32字节栈对齐，Windows下不启用AVX内核
+__attribute__((target("avx2,fma")))
+unsigned long long burn_fma_avx2(unsigned long long iterations) {
+    __m256d b = _mm256_set1_pd(0.9999999);
+    __m256d c = _mm256_set1_pd(1e-7);
+    __m256d a0 = _mm256_set1_pd(1.0), a1 = _mm256_set1_pd(1.1);
+    __m256d a2 = _mm256_set1_pd(1.2), a3 = _mm256_set1_pd(1.3);
+    __m256d a4 = _mm256_set1_pd(1.4), a5 = _mm256_set1_pd(1.5);
+    __m256d a6 = _mm256_set1_pd(1.6), a7 = _mm256_set1_pd(1.7);
+    for (unsigned long long i = 0; i < iterations; i++) {
+        a0 = _mm256_fmadd_pd(a0, b, c);
+        a1 = _mm256_fmadd_pd(a1, b, c);
+        a2 = _mm256_fmadd_pd(a2, b, c);
+        a3 = _mm256_fmadd_pd(a3, b, c);
+        a4 = _mm256_fmadd_pd(a4, b, c);
+        a5 = _mm256_fmadd_pd(a5, b, c);
+        a6 = _mm256_fmadd_pd(a6, b, c);
+        a7 = _mm256_fmadd_pd(a7, b, c);
+    }
+    __m256d sum = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(a0, a1), _mm256_add_pd(a2, a3)),
+                                _mm256_add_pd(_mm256_add_pd(a4, a5), _mm256_add_pd(a6, a7)));
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sum);
+    burn_sink_f64 = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    return iterations * 8 * 4 * 2;
+}
+
+// AVX-512 FMA内核: 与AVX2版本相同的结构，每次迭代8*8*2次浮点运算
+__attribute__((target("avx512f")))
+unsigned long long burn_fma_avx512(unsigned long long iterations) {
+    __m512d b = _mm512_set1_pd(0.9999999);
+    __m512d c = _mm512_set1_pd(1e-7);
+    __m512d a0 = _mm512_set1_pd(1.0), a1 = _mm512_set1_pd(1.1);
+    __m512d a2 = _mm512_set1_pd(1.2), a3 = _mm512_set1_pd(1.3);
+    __m512d a4 = _mm512_set1_pd(1.4), a5 = _mm512_set1_pd(1.5);
+    __m512d a6 = _mm512_set1_pd(1.6), a7 = _mm512_set1_pd(1.7);
+    for (unsigned long long i = 0; i < iterations; i++) {
+        a0 = _mm512_fmadd_pd(a0, b, c);
+        a1 = _mm512_fmadd_pd(a1, b, c);
+        a2 = _mm512_fmadd_pd(a2, b, c);
+        a3 = _mm512_fmadd_pd(a3, b, c);
+        a4 = _mm512_fmadd_pd(a4, b, c);
+        a5 = _mm512_fmadd_pd(a5, b, c);
+        a6 = _mm512_fmadd_pd(a6, b, c);
+        a7 = _mm512_fmadd_pd(a7, b, c);
+    }
+    __m512d sum = _mm512_add_pd(_mm512_add_pd(_mm512_add_pd(a0, a1), _mm512_add_pd(a2, a3)),
+                                _mm512_add_pd(_mm512_add_pd(a4, a5), _mm512_add_pd(a6, a7)));
+    burn_sink_f64 = _mm512_reduce_add_pd(sum);
+    return iterations * 8 * 8 * 2;
+}
+#endif
+
+// 可选的CPU占用内核
+typedef unsigned long long (*burn_kernel_fn)(unsigned long long iterations);
+typedef struct {
+    const char* name;          // 命令行使用的名称
+    const char* description;   // 说明
+    const char* variant;       // 运行时选中的实现
+    burn_kernel_fn fn;
+    unsigned long long batch;  // 每次调用的迭代次数，校准为约2微秒
+} burn_kernel_t;
+
+enum { KERNEL_SCALAR = 0, KERNEL_FMA, KERNEL_INTEGER, KERNEL_BRANCH, KERNEL_PAUSE, NUM_BURN_KERNELS };
+
+burn_kernel_t burn_kernels[NUM_BURN_KERNELS] = {
+    { "scalar", "标量浮点(原spinCPU)", "scalar", burn_scalar, 1000 },
+    { "fma",    "向量乘加(AVX-512/AVX2)", "scalar", burn_scalar, 1000 },
+    { "int",    "整数/ALU", "int", burn_integer, 1000 },
+    { "branch", "分支密集", "branch", burn_branch, 1000 },
+    { "pause",  "PAUSE低功耗自旋", "pause", burn_pause, 100 },
+};
+
+// 按名称查找内核，找不到时返回-1
+int find_burn_kernel(const char* name) {
+    for (int i = 0; i < NUM_BURN_KERNELS; i++) {
+        if (strcmp(burn_kernels[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+// 运行时根据CPUID选择内核实现，并校准每次调用的迭代次数
+void init_burn_kernels() {
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(_WIN32)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        burn_kernels[KERNEL_FMA].fn = burn_fma_avx512;
+        burn_kernels[KERNEL_FMA].variant = "avx512";
+    } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        burn_kernels[KERNEL_FMA].fn = burn_fma_avx2;
+        burn_kernels[KERNEL_FMA].variant = "avx2";
+    }
+#endif
+    
+    // 每次调用约2微秒，工作线程能及时检查忙等窗口是否结束
+    const unsigned long long target_ns = 2000;
+    for (int i = 0; i < NUM_BURN_KERNELS; i++) {
+        burn_kernel_t* kernel = &burn_kernels[i];
+        const unsigned long long probe = 4096;
+        kernel->fn(probe); // 预热
+        
+        // 取多次测量的最小值，排除被抢占或中断的影响
+        unsigned long long elapsed = ~0ULL;
+        for (int run = 0; run < 5; run++) {
+            unsigned long long start = get_time_ns();
+            kernel->fn(probe);
+            unsigned long long duration = get_time_ns() - start;
+            if (duration < elapsed) elapsed = duration;
+        }
+        if (elapsed == 0) elapsed = 1;
+        
+        unsigned long long batch = probe * target_ns / elapsed;
+        if (batch < 16) batch = 16;
+        if (batch > 1000000) batch = 1000000;
+        kernel->batch = batch;
+    }
+}
+
+// 根据各核心的外部负载重新分配设定值，保证总体目标仍能达到
+// 外部负载已超过设定值的核心不再叠加负载，差额由其他空闲核心补足
+void balance_core_setpoints(double overall_target) {
+    double lo = -100.0, hi = 100.0;
+    
+    // 二分查找统一偏移量，使预期的平均使用率等于总体目标
+    for (int iter = 0; iter < 40; iter++) {
+        double offset = (lo + hi) / 2.0;
+        double expected = 0.0;
+        
+        for (int i = 0; i < num_cpu_cores; i++) {
+            core_ctrl_t* core = &core_ctrls[i];
+            double external = core->external;
+            
+            double setpoint = core->target + offset;
+            if (setpoint < 0) setpoint = 0;
+            if (setpoint > 100) setpoint = 100;
             
-            if (success_count == diff_blocks) {
-                consecutive_failed_allocations = 0; // 全部成功，重置失败计数
+            // 核心使用率不可能低于外部负载
+            expected += (setpoint > external) ? setpoint : external;
+        }
+        
+        if (expected / num_cpu_cores < overall_target) {
+            lo = offset;
+        } else {
+            hi = offset;
+        }
+    }
+    
+    double offset = (lo + hi) / 2.0;
+    for (int i = 0; i < num_cpu_cores; i++) {
+        double setpoint = core_ctrls[i].target + offset;
+        if (setpoint < 0) setpoint = 0;
+        if (setpoint > 100) setpoint = 100;
+        core_ctrls[i].setpoint = setpoint;
+    }
+}
+
+// 工作线程调度策略: normal为普通优先级；idle(SCHED_IDLE)和nice(nice 19)只占用其他进程不用的CPU，
+// 其他进程唤醒时立即让出，控制线程和采样保持普通优先级
+enum { WORKER_SCHED_NORMAL = 0, WORKER_SCHED_IDLE, WORKER_SCHED_NICE };
+const char* worker_sched_names[] = { "normal", "idle", "nice" };
+
+// 按名称解析调度策略
+bool parse_worker_sched(const char* name) {
+    for (int i = 0; i < (int)(sizeof(worker_sched_names) / sizeof(worker_sched_names[0])); i++) {
+        if (strcmp(worker_sched_names[i], name) == 0) {
+            worker_sched = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 根据工作线程的CPU时间计算各核心的自身占用，并更新外部负载估计
+// 外部负载 = 核心使用率 - 自身占用；变化超过10%时视为负载阶跃，直接跳到新值
+void update_core_external_load(double elapsed_ns, bool reset) {
+    for (int i = 0; i < num_cpu_cores; i++) {
+        core_ctrl_t* core = &core_ctrls[i];
+        unsigned long long cpu_ns = atomic_load_explicit(&workers[i].cpu_ns, memory_order_relaxed);
+        double own = 0.0;
+        if (elapsed_ns > 0 && cpu_ns >= core->prev_cpu_ns) {
+            own = (double)(cpu_ns - core->prev_cpu_ns) * 100.0 / elapsed_ns;
+        }
+        // 换算为与使用率相同的口径(按cgroup计算时为占每个工作线程份额的比例)
+        own /= cpu_share_scale;
+        if (own > 100.0) own = 100.0;
+        core->prev_cpu_ns = cpu_ns;
+        core->own = own;
+        
+        unsigned long long cmd_ns = atomic_load_explicit(&workers[i].cmd_ns_sum, memory_order_relaxed);
+        if (elapsed_ns > 0 && cmd_ns >= core->prev_cmd_ns) {
+            core->commanded = (double)(cmd_ns - core->prev_cmd_ns) * 100.0 / elapsed_ns / cpu_share_scale;
+        }
+        core->prev_cmd_ns = cmd_ns;
+        
+        // 指令太小时比例没有意义，保持原值
+        if (reset) {
+            core->delivery = 1.0;
+        } else if (core->commanded >= 2.0) {
+            double delivery = own / core->commanded;
+            if (delivery > 1.0) delivery = 1.0;
+            if (delivery < 0.5) delivery = 0.5;
+            core->delivery = filter_alpha * delivery + (1 - filter_alpha) * core->delivery;
+        }
+        
+        double external = core->usage - own;
+        if (external < 0) external = 0;
+        if (reset || fabs(external - core->external) > 10.0) {
+            core->external = external;
+        } else {
+            core->external = filter_alpha * external + (1 - filter_alpha) * core->external;
+        }
+    }
+}
+
+// CPU控制器复位: 所有核心从空载开始
+void cpu_controller_reset() {
+    thread_cpu_load = 0.0;
+    target_cpu_load = target_cpu_usage;
+    busy_percentage = 0;
+    for (int i = 0; i < num_cpu_cores; i++) {
+        worker_cmd_t cmd = make_worker_cmd(i, num_cpu_cores, 0.0);
+        core_ctrls[i].busy = 0.0;
+        core_ctrls[i].integral = 0.0;
+        core_ctrls[i].prev_error = 0.0;
+        core_ctrls[i].delivery = 1.0;
+        core_ctrls[i].prev_cpu_ns = atomic_load_explicit(&workers[i].cpu_ns, memory_order_relaxed);
+        core_ctrls[i].prev_cmd_ns = atomic_load_explicit(&workers[i].cmd_ns_sum, memory_order_relaxed);
+        worker_publish_cmd(&workers[i], &cmd);
+    }
+}
+
+// 预热结束时初始化滤波值，预热期间工作线程空载，测得的使用率全部是外部负载
+void cpu_controller_start(double system_cpu_usage, double elapsed_ns) {
+    update_core_external_load(elapsed_ns, true);
+    filtered_cpu_usage = system_cpu_usage;
+    for (int i = 0; i < num_cpu_cores; i++) {
+        core_ctrls[i].filtered = core_ctrls[i].usage;
+    }
+}
+
+// CPU控制器单步，每个核心独立控制，调用前core_ctrls[i].usage已更新为本区间的使用率
+// 前馈: 繁忙百分比 = 设定值 - 外部负载，直接由剩余余量算出；PID只修正残余误差
+void cpu_controller_step(double system_cpu_usage, double elapsed_ns) {
+    // 修正量限制: 积分最多修正30%，单次比例修正最多20%
+    const double max_trim = 20.0;
+    const double integral_limit = 30.0;
+    
+    // 应用低通滤波器平滑CPU使用率波动
+    filtered_cpu_usage = filter_alpha * system_cpu_usage + (1 - filter_alpha) * filtered_cpu_usage;
+    
+    // 更新当前CPU负载（用于显示）
+    current_cpu_load = system_cpu_usage;
+    
+    // 对每个核心的使用率滤波
+    for (int i = 0; i < num_cpu_cores; i++) {
+        core_ctrl_t* core = &core_ctrls[i];
+        core->filtered = filter_alpha * core->usage + (1 - filter_alpha) * core->filtered;
+    }
+    
+    // 与采样同一区间内各工作线程实际消耗的CPU，得到外部负载
+    update_core_external_load(elapsed_ns, false);
+    
+    // 按外部负载分布重新分配各核心设定值
+    balance_core_setpoints(get_overall_cpu_target());
+    
+    double busy_sum = 0.0;
+    for (int i = 0; i < num_cpu_cores; i++) {
+        core_ctrl_t* core = &core_ctrls[i];
+        
+        // 前馈: 扣除外部负载后需要补足的部分
+        double feed_forward = core->setpoint - core->external;
+        if (feed_forward < 0) feed_forward = 0;
+        
+        // 残余误差 - 使用滤波后的核心使用率
+        double error = core->setpoint - core->filtered;
+        
+        // 积分项只在前馈未饱和且没有压力退让时累积，避免积分饱和
+        bool backing_off = atomic_load_explicit(&workers[i].backoff_share, memory_order_relaxed) < 1.0;
+        if (feed_forward > 0 && feed_forward < 100 && !backing_off) {
+            core->integral += pid_ki * 0.2 * error;
+            if (core->integral > integral_limit) core->integral = integral_limit;
+            if (core->integral < -integral_limit) core->integral = -integral_limit;
+        }
+        
+        // 微分项计算
+        double derivative = error - core->prev_error;
+        core->prev_error = error;
+        
+        double trim = (pid_kp * error + pid_kd * derivative) * 0.2;
+        if (trim > max_trim) trim = max_trim;
+        if (trim < -max_trim) trim = -max_trim;
+        
+        core->feed_forward = feed_forward;
+        core->trim = trim;
+        core->busy = feed_forward + core->integral + trim;
+        if (core->busy < 0) core->busy = 0;
+        if (core->busy > 100) core->busy = 100;
+        
+        // 让出CPU的工作线程只拿到指令的一部分，按实际/指令比例放大下发的份额
+        double duty = core->busy;
+        if (worker_sched != WORKER_SCHED_NORMAL && core->delivery > 0) {
+            duty /= core->delivery;
+            if (duty > 100) duty = 100;
+        }
+        
+        // 无锁发布工作线程的负载比例
+        worker_cmd_t cmd = make_worker_cmd(i, num_cpu_cores, duty * cpu_share_scale / 100.0);
+        worker_publish_cmd(&workers[i], &cmd);
+        busy_sum += core->busy;
+    }
+    
+    // 汇总值用于显示
+    busy_percentage = (int)(busy_sum / num_cpu_cores + 0.5);
+    target_cpu_load = busy_percentage;
+    thread_cpu_load = (double)busy_percentage / 100.0;
+}
+
+// 唤醒延迟探针: 以普通优先级模拟一个周期性唤醒的服务，轮流绑定到各工作线程的核心，
+// 测量唤醒时刻晚于截止时间的部分。按唤醒时该核心的工作线程是否在忙等分成两组，
+// 两组之差乘以撞上忙等的比例，即为工作线程给其他进程的每次唤醒平均增加的调度延迟
+typedef struct {
+    worker_hist_t clear;      // 工作线程不在忙等时的唤醒延迟(基准)，只由探针线程写入
+    worker_hist_t overlap;    // 撞上工作线程忙等时的唤醒延迟
+    atomic_int tid;           // 探针线程ID，压力退让时从其他任务的等待中扣除
+    bool started;
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+} wake_probe_t;
+
+wake_probe_t wake_probe = {0};
+
+// 调整CPU负载线程: 每150ms采样一次并运行一步CPU控制器
+void* adjust_cpu_load_thread(void* arg) {
+    // 初始不施加负载
+    cpu_controller_reset();
+    
+    // 预热CPU
+    printf("CPU负载控制初始化中...\n");
+    
+    // 等待预热完成并初始化滤波值
+    sampler_update();
+    unsigned long long last_ns = get_time_ns();
+#ifdef _WIN32
+    Sleep(1000);
+#else
+    usleep(1000 * 1000);
+#endif
+    sampler_update();
+    unsigned long long now_ns = get_time_ns();
+    cpu_controller_start(sampler.current.cpu_usage, (double)(now_ns - last_ns));
+    last_ns = now_ns;
+    
+    while (running) {
+        // 采样一次所有指标并发布快照(同时更新各核心使用率)
+        unsigned long long loop_start = get_time_ns();
+        sampler_update();
+        now_ns = get_time_ns();
+        cpu_profile_update(get_monotonic_time(), sampler.current.cpu_usage);
+        cpu_controller_step(sampler.current.cpu_usage, (double)(now_ns - last_ns));
+        core_stats_publish(filtered_cpu_usage, get_overall_cpu_target());
+        last_ns = now_ns;
+        worker_hist_record(&control_loop_hist, get_time_ns() - loop_start);
+        
+#ifdef _WIN32
+        Sleep(150);  // 150ms，减少采样周期，加快响应速度
+#else
+        usleep(150 * 1000);  // 150ms
+#endif
+    }
+    
+    return NULL;
+}
+
+// 睡眠到指定的绝对时间(单调时钟纳秒)，不受睡眠过冲累积的影响
+void sleep_until_ns(unsigned long long deadline_ns) {
+#ifdef _WIN32
+    unsigned long long now = get_time_ns();
+    if (deadline_ns > now) {
+        Sleep((DWORD)((deadline_ns - now) / 1000000));
+    }
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(deadline_ns / 1000000000ULL);
+    ts.tv_nsec = (long)(deadline_ns % 1000000000ULL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && running) {
+        // 被信号打断时继续睡到同一个截止时间
+    }
+#endif
+}
+
+// 计算截止时间网格上不早于now的下一个点，网格原点为pwm_epoch_ns + phase
+unsigned long long next_grid_deadline(unsigned long long now, unsigned long long period_ns, unsigned long long phase_ns) {
+    unsigned long long origin = pwm_epoch_ns + phase_ns;
+    if (now <= origin) return origin;
+    unsigned long long cycles = (now - origin + period_ns - 1) / period_ns;
+    return origin + cycles * period_ns;
+}
+
+// 工作线程主循环: 在绝对截止时间网格上运行PWM
+// 每个周期从网格点开始忙等duty * period，然后睡到下一个网格点，睡眠误差不会累积到后续周期
+// 内环: 按线程CPU时钟核对实际消耗，被抢占损失的CPU时间在本周期内补足，补不完的计入下一周期
+void worker_run(worker_t* worker) {
+    unsigned long long carry_ns = 0; // 上个周期未补足的CPU时间
+    worker_cmd_t cmd;
+    worker_read_cmd(worker, &cmd);
+    unsigned long long period = cmd.period_ns;
+    unsigned long long phase = cmd.phase_ns;
+    unsigned long long deadline = next_grid_deadline(get_time_ns(), period, phase);
+    
+    while (running && !atomic_load_explicit(&worker->stop, memory_order_relaxed)) {
+        sleep_until_ns(deadline);
+        unsigned long long start = get_time_ns();
+        if (start > deadline) {
+            unsigned long long late = start - deadline;
+            counter_add(&worker->late_ns_sum, late);
+            counter_max(&worker->late_ns_max, late);
+            worker_hist_record(&worker->wake_hist, late);
+        } else {
+            worker_hist_record(&worker->wake_hist, 0);
+        }
+        
+        // 无锁获取当前的负载目标，周期或相位变化时重新对齐网格
+        worker_read_cmd(worker, &cmd);
+        if (cmd.period_ns != period || cmd.phase_ns != phase) {
+            period = cmd.period_ns;
+            phase = cmd.phase_ns;
+            deadline = next_grid_deadline(start, period, phase);
+            continue;
+        }
+        
+        unsigned long long next = deadline + period;
+        unsigned int backoff_gen = atomic_load_explicit(&worker->backoff_gen, memory_order_relaxed);
+        double share = atomic_load_explicit(&worker->backoff_share, memory_order_relaxed);
+        unsigned long long work_ns = (unsigned long long)(cmd.duty * share * period);
+        counter_add(&worker->cmd_ns_sum, work_ns);
+        if (work_ns == 0) carry_ns = 0;
+        unsigned long long actual_ns = 0; // 本周期实际获得的CPU时间
+        
+        // 负载很低时跳过这个周期的忙等
+        if (work_ns + carry_ns >= 50000) {
+            unsigned long long target_ns = work_ns + carry_ns;
+            
+            // 从实际开始时间计算忙等窗口，唤醒晚了也不会少算工作时间，但不超过下一个网格点
+            unsigned long long busy_end = start + target_ns;
+            if (busy_end > next) busy_end = next;
+            
+            // 使用命令指定的内核执行计算密集型操作
+            const burn_kernel_t* kernel = &burn_kernels[cmd.kernel];
+            unsigned long long now, ops = 0;
+#ifndef _WIN32
+            unsigned long long cpu_start = get_thread_cpu_time_ns();
+#endif
+            atomic_store_explicit(&worker->busy_since, start, memory_order_relaxed);
+            for (;;) {
+                do {
+                    ops += kernel->fn(kernel->batch);
+                    now = get_time_ns();
+                } while (now < busy_end && running &&
+                         atomic_load_explicit(&worker->backoff_gen, memory_order_relaxed) == backoff_gen);
+#ifdef _WIN32
+                // GetThreadTimes只有调度时间片精度，Windows上仍按墙钟时间忙等
+                carry_ns = 0;
+                actual_ns = now - start;
+                break;
+#else
+                // 墙钟窗口结束后核对实际CPU时间，被抢占的部分继续补足
+                unsigned long long used = get_thread_cpu_time_ns() - cpu_start;
+                actual_ns = used;
+                if (used >= target_ns ||
+                    atomic_load_explicit(&worker->backoff_gen, memory_order_relaxed) != backoff_gen) {
+                    // 触发退让时不补足，也不把差额留到下个周期
+                    carry_ns = 0;
+                    break;
+                }
+                if (now >= next || !running) {
+                    // 本周期已无余量，差额留到下个周期，最多四分之一周期
+                    carry_ns = target_ns - used;
+                    if (carry_ns > period / 4) carry_ns = period / 4;
+                    break;
+                }
+                busy_end = now + (target_ns - used);
+                if (busy_end > next) busy_end = next;
+#endif
+            }
+            atomic_store_explicit(&worker->busy_until, now, memory_order_relaxed);
+            counter_add(&worker->busy_ns_sum, now - start);
+            counter_add(&worker->work_ops, ops);
+            
+            // 忙等结束晚于理想完成时刻的部分: 唤醒延迟和被抢占的时间都计入
+            unsigned long long ideal_end = deadline + target_ns;
+            worker_hist_record(&worker->late_hist, now > ideal_end ? now - ideal_end : 0);
+        }
+        
+        // 指令与实际CPU时间的差额，只统计有负载的周期
+        if (work_ns > 0) {
+            if (actual_ns < work_ns) {
+                worker_hist_record(&worker->short_hist, work_ns - actual_ns);
+            } else {
+                worker_hist_record(&worker->over_hist, actual_ns - work_ns);
+            }
+        }
+        
+        // 整个周期都错过时直接跳到网格上的下一个点，不追赶也不漂移
+        unsigned long long now = get_time_ns();
+        if (now >= next + period) {
+            unsigned long long skipped = (now - next) / period;
+            counter_add(&worker->missed_cycles, skipped);
+            next += skipped * period;
+        }
+        deadline = next;
+        atomic_store_explicit(&worker->cpu_ns, get_thread_cpu_time_ns(), memory_order_relaxed);
+        atomic_fetch_add_explicit(&worker->cycles, 1, memory_order_relaxed);
+    }
+}
+
+// 设置当前工作线程的调度策略，失败时返回false
+bool apply_worker_sched() {
+#ifdef _WIN32
+    int priority = THREAD_PRIORITY_ABOVE_NORMAL;
+    if (worker_sched == WORKER_SCHED_IDLE) priority = THREAD_PRIORITY_IDLE;
+    else if (worker_sched == WORKER_SCHED_NICE) priority = THREAD_PRIORITY_LOWEST;
+    return SetThreadPriority(GetCurrentThread(), priority) != 0;
+#else
+    if (worker_sched == WORKER_SCHED_IDLE) {
+        struct sched_param param = {0};
+        return pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) == 0;
+    }
+    if (worker_sched == WORKER_SCHED_NICE) {
+        // Linux上nice值按线程生效
+        return setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19) == 0;
+    }
+    return true;
+#endif
+}
+
+int autogroup_saved_nice = INT_MIN; // 调整前的自动分组nice值，INT_MIN为未调整
+
+// 开启自动分组(sched_autogroup)时，调度器先在会话之间平分CPU，线程的nice值只在本会话内起作用；
+// 把本会话的分组nice值调到19，工作线程才会真正让给其他会话的进程。
+// 分组属于整个会话，只在后台模式下调整: setsid之后CMM独占一个分组，不影响终端会话中的其他进程
+void autogroup_yield() {
+#ifndef _WIN32
+    if (!daemon_mode) {
+        if (verbose_mode) printf("前台运行时不调整自动分组，工作线程只对同一会话中的进程让出CPU\n");
+        return;
+    }
+    FILE* fp = fopen("/proc/sys/kernel/sched_autogroup_enabled", "r");
+    if (!fp) return;
+    int enabled = 0;
+    if (fscanf(fp, "%d", &enabled) != 1) enabled = 0;
+    fclose(fp);
+    if (!enabled) return;
+    
+    // 格式为 "/autogroup-<id> nice <n>"
+    int saved = INT_MIN;
+    fp = fopen("/proc/self/autogroup", "r");
+    if (fp) {
+        if (fscanf(fp, "%*s nice %d", &saved) != 1) saved = INT_MIN;
+        fclose(fp);
+    }
+    
+    fp = fopen("/proc/self/autogroup", "w");
+    bool ok = fp != NULL;
+    if (fp) {
+        ok = fprintf(fp, "19") >= 0;
+        ok = fclose(fp) == 0 && ok;
+    }
+    if (!ok) {
+        printf("无法调整自动分组的nice值，工作线程只对同一会话中的进程让出CPU\n");
+        return;
+    }
+    autogroup_saved_nice = saved;
+    if (verbose_mode) {
+        printf("已将本会话的自动分组nice值调整为19\n");
+    }
+#endif
+}
+
+// 恢复调整前的自动分组nice值
+void autogroup_restore() {
+#ifndef _WIN32
+    if (autogroup_saved_nice == INT_MIN) return;
+    FILE* fp = fopen("/proc/self/autogroup", "w");
+    if (fp) {
+        fprintf(fp, "%d", autogroup_saved_nice);
+        fclose(fp);
+    }
+    autogroup_saved_nice = INT_MIN;
+#endif
+}
+
+atomic_int worker_sched_failures = 0; // 调度策略设置失败的工作线程数
+
+// CPU负载工作线程
+void* cpu_load_thread(void* arg) {
+    // 线程序号对应core_ctrls中的核心
+    long thread_index = (long)(intptr_t)arg;
+    core_ctrl_t* core = &core_ctrls[thread_index];
+    worker_t* worker = &workers[thread_index];
+    
+    // 设置调度策略并绑定到对应核心
+    if (!apply_worker_sched()) {
+        atomic_fetch_add_explicit(&worker_sched_failures, 1, memory_order_relaxed);
+    }
+#ifdef _WIN32
+    if (core->cpu_id < (int)(sizeof(DWORD_PTR) * 8)) {
+        SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << core->cpu_id);
+    }
+#else
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core->cpu_id, &cpuset);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0 && verbose_mode) {
+        printf("无法将CPU线程 #%ld 绑定到核心 %d\n", thread_index, core->cpu_id);
+    }
+    
+    // 将定时器松弛量降到最小，减少唤醒误差
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+    atomic_store_explicit(&worker->tid, (int)syscall(SYS_gettid), memory_order_relaxed);
+#endif
+    
+    worker_run(worker);
+    return NULL;
+}
+
+// 探针线程
+#ifdef _WIN32
+DWORD WINAPI wake_probe_thread(LPVOID arg) {
+#else
+void* wake_probe_thread(void* arg) {
+#endif
+    wake_probe_t* p = (wake_probe_t*)arg;
+    unsigned long long period = (unsigned long long)(1e9 / probe_hz);
+    unsigned long long deadline = get_time_ns();
+    uint64_t rng = deadline | 1;
+    int next_core = 0;
+#ifndef _WIN32
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+    atomic_store_explicit(&p->tid, (int)syscall(SYS_gettid), memory_order_relaxed);
+#endif
+    
+    while (running) {
+        // 睡眠前迁移到下一个核心，迁移本身不计入测量
+        int index = next_core;
+        int cpu = core_ctrls[index].cpu_id;
+        next_core = (next_core + 1) % num_cpu_cores;
+#ifdef _WIN32
+        if (cpu < (int)(sizeof(DWORD_PTR) * 8)) {
+            SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+        }
+#else
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpu, &cpuset);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+#endif
+        
+        // 间隔在0.5~1.5个周期之间随机，避免与工作线程的PWM周期同步而总是落在同一相位
+        rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+        deadline += period / 2 + rng % (period + 1);
+        unsigned long long now = get_time_ns();
+        if (deadline < now) deadline = now + period;
+        sleep_until_ns(deadline);
+        now = get_time_ns();
+        
+        // 按截止时刻判断是否撞上忙等: 普通优先级的工作线程不会被抢占，探针运行时忙等可能已经结束
+        unsigned long long late = now > deadline ? now - deadline : 0;
+        unsigned long long since = atomic_load_explicit(&workers[index].busy_since, memory_order_relaxed);
+        unsigned long long until = atomic_load_explicit(&workers[index].busy_until, memory_order_relaxed);
+        if (since <= deadline && (since > until || until > deadline)) {
+            worker_hist_record(&p->overlap, late);
+        } else {
+            worker_hist_record(&p->clear, late);
+        }
+    }
+    return 0;
+}
+
+// 撞上忙等的样本比例
+double wake_probe_overlap_ratio(const latency_hist_t* clear, const latency_hist_t* overlap) {
+    unsigned long long total = clear->count + overlap->count;
+    return total ? (double)overlap->count / total : 0.0;
+}
+
+// 每次唤醒平均增加的延迟(纳秒) = 撞上忙等的比例 * (撞上时的平均延迟 - 基准平均延迟)
+double wake_probe_added_ns(const latency_hist_t* clear, const latency_hist_t* overlap) {
+    if (clear->count == 0 || overlap->count == 0) return 0.0;
+    return wake_probe_overlap_ratio(clear, overlap) * (hist_mean(overlap) - hist_mean(clear));
+}
+
+// 启动探针，probe_hz为0时不启动
+void wake_probe_start() {
+    if (probe_hz <= 0) return;
+#ifdef _WIN32
+    wake_probe.thread = CreateThread(NULL, 0, wake_probe_thread, &wake_probe, 0, NULL);
+    wake_probe.started = wake_probe.thread != NULL;
+#else
+    wake_probe.started = pthread_create(&wake_probe.thread, NULL, wake_probe_thread, &wake_probe) == 0;
+#endif
+    if (!wake_probe.started) {
+        printf("创建唤醒延迟探针线程失败，不统计调度延迟\n");
+    }
+}
+
+// 停止探针，调用前running已为0
+void wake_probe_stop() {
+    if (!wake_probe.started) return;
+#ifdef _WIN32
+    WaitForSingleObject(wake_probe.thread, INFINITE);
+    CloseHandle(wake_probe.thread);
+#else
+    pthread_join(wake_probe.thread, NULL);
+#endif
+    wake_probe.started = false;
+}
+
+// CPU压力退让: PSI触发器(/proc/pressure/cpu，poll等待内核通知，不轮询)和各CPU的运行队列等待时间
+// (/proc/schedstat减去CMM自身线程的等待)超过阈值时，立即把相关核心工作线程的占空比减半并结束
+// 正在进行的忙等，之后按固定速率逐渐恢复
+#define BACKOFF_WINDOW_US 500000   // PSI触发器窗口(内核允许的最小值)
+#define BACKOFF_POLL_MS 10         // 检查运行队列等待时间的间隔
+#define BACKOFF_TASK_POLL_MS 100   // 读取CMM各线程自身等待时间的间隔
+#define BACKOFF_HOLD 0.05          // 同一核心两次退让的最小间隔(秒)
+#define BACKOFF_RECOVER_PER_SEC 0.25 // 每秒恢复的占空比比例
+typedef struct {
+    bool started;
+    int psi_fd;                          // 注册了触发器的/proc/pressure/cpu，-1为不可用
+    int psi_read_fd;                     // 读取PSI累计值的/proc/pressure/cpu
+    int schedstat_fd;                    // /proc/schedstat，-1为不可用(内核未开启CONFIG_SCHEDSTATS)
+    int* task_fds;                       // 每个工作线程和探针线程的/proc/self/task/<tid>/schedstat
+    unsigned long long* prev_task_delay; // 上次读取的各线程运行队列等待时间(ns)
+    double* task_delay_rate;             // 各线程最近一个读取间隔内的等待速率(ns/秒)
+    double task_elapsed;                 // 距上次读取各线程等待时间的秒数
+    int task_reads;                      // 读取各线程等待时间的次数，至少两次后速率才可用
+    int* cpu_index;                      // CPU编号到核心下标的映射，不是工作线程的核心为-1
+    int cpu_index_len;
+    unsigned long long* prev_cpu_delay;  // 上次读取的各核心运行队列等待时间(ns)
+    double* last_shed;                   // 各核心最近一次退让的时刻
+    unsigned long long prev_psi_total;   // 上次PSI事件时的some total(微秒)
+    unsigned long long prev_psi_own;     // 上次PSI事件时CMM线程的累计等待(ns)
+    atomic_ullong psi_events;            // PSI触发的退让次数
+    atomic_ullong psi_ignored;           // 等待主要来自CMM自身线程而忽略的PSI事件
+    atomic_ullong rundelay_events;       // 运行队列等待触发的退让次数
+    int mem_psi_fd;                      // 注册了触发器的内存PSI文件(cgroup或系统)，-1为不启用
+    atomic_ullong mem_events;            // 内存压力释放次数
+    atomic_ullong mem_released;          // 内存压力累计释放的字节数
+    atomic_ullong mem_ignored;           // 填充期间或刚填充完而忽略的内存PSI事件
+    char buf[16384];
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+} backoff_t;
+
+backoff_t backoff = {0};
+
+// 把一个核心的占空比减半，正在忙等的工作线程立即结束本周期；距上次退让太近时返回false
+bool backoff_shed(backoff_t* b, int index, double now) {
+    if (now - b->last_shed[index] < BACKOFF_HOLD) return false;
+    b->last_shed[index] = now;
+    worker_t* w = &workers[index];
+    double share = atomic_load_explicit(&w->backoff_share, memory_order_relaxed) * 0.5;
+    if (share < 0.02) share = 0.0;
+    atomic_store_explicit(&w->backoff_share, share, memory_order_relaxed);
+    atomic_fetch_add_explicit(&w->backoff_gen, 1, memory_order_relaxed);
+    return true;
+}
+
+// 退让之后按固定速率恢复
+void backoff_recover(backoff_t* b, double elapsed, double now) {
+    if (!b->last_shed) return;
+    for (int i = 0; i < num_cpu_cores; i++) {
+        worker_t* w = &workers[i];
+        double share = atomic_load_explicit(&w->backoff_share, memory_order_relaxed);
+        if (share >= 1.0 || now - b->last_shed[i] < BACKOFF_HOLD) continue;
+        share += BACKOFF_RECOVER_PER_SEC * elapsed;
+        atomic_store_explicit(&w->backoff_share, share > 1.0 ? 1.0 : share, memory_order_relaxed);
+    }
+}
+
+#ifndef _WIN32
+// 读取线程的累计运行队列等待时间(ns)，index为num_cpu_cores时是探针线程
+unsigned long long backoff_task_delay(backoff_t* b, int index) {
+    if (b->task_fds[index] < 0) {
+        int tid = index < num_cpu_cores ? atomic_load_explicit(&workers[index].tid, memory_order_relaxed)
+                                        : atomic_load_explicit(&wake_probe.tid, memory_order_relaxed);
+        if (tid == 0) return 0;
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/self/task/%d/schedstat", tid);
+        b->task_fds[index] = open(path, O_RDONLY | O_CLOEXEC);
+        if (b->task_fds[index] < 0) return 0;
+    }
+    char line[128];
+    if (read_proc_fd(b->task_fds[index], line, sizeof(line)) <= 0) return 0;
+    const char* p = line;
+    parse_ull(&p); // 运行时间
+    return parse_ull(&p);
+}
+
+// CMM各线程自身的等待时间每100毫秒读取一次，换算为速率；每个线程一次pread，
+// 按10毫秒读取时核心很多的主机上系统调用开销过大
+void backoff_update_task_rates(backoff_t* b, double elapsed) {
+    b->task_elapsed += elapsed;
+    if (b->task_reads > 0 && b->task_elapsed < BACKOFF_TASK_POLL_MS / 1000.0) return;
+    for (int i = 0; i <= num_cpu_cores; i++) {
+        if (i == num_cpu_cores && !wake_probe.started) break;
+        unsigned long long delay = backoff_task_delay(b, i);
+        unsigned long long diff = delay > b->prev_task_delay[i] ? delay - b->prev_task_delay[i] : 0;
+        // 第一次读取只建立基准
+        if (b->task_reads > 0) b->task_delay_rate[i] = (double)diff / b->task_elapsed;
+        b->prev_task_delay[i] = delay;
+    }
+    b->task_reads++;
+    b->task_elapsed = 0.0;
+}
+
+// 工作线程自身等待以外的等待时间超过阈值的核心立即退让
+void backoff_check_rundelay(backoff_t* b, double elapsed, double now) {
+    if (read_proc_fd(b->schedstat_fd, b->buf, sizeof(b->buf)) <= 0) return;
+    backoff_update_task_rates(b, elapsed);
+    
+    // 探针在各核心间轮转，它的等待无法归到具体核心，从每个核心中都扣除
+    double probe_delay = wake_probe.started ? b->task_delay_rate[num_cpu_cores] * elapsed : 0.0;
+    
+    double threshold_ns = backoff_stall_ms * 1e6 * elapsed * 1e6 / BACKOFF_WINDOW_US;
+    for (const char* p = b->buf; p; p = next_line(p)) {
+        if (strncmp(p, "cpu", 3) != 0 || p[3] < '0' || p[3] > '9') continue;
+        p += 3;
+        int cpu = (int)parse_ull(&p);
+        int index = cpu < b->cpu_index_len ? b->cpu_index[cpu] : -1;
+        if (index < 0) continue;
+        
+        // 第8个字段为该CPU上所有任务的运行队列等待时间；工作线程自身的等待按最近的速率扣除
+        unsigned long long cpu_delay = 0;
+        for (int k = 0; k < 8; k++) cpu_delay = parse_ull(&p);
+        unsigned long long cpu_diff = cpu_delay > b->prev_cpu_delay[index] ? cpu_delay - b->prev_cpu_delay[index] : 0;
+        bool first = b->prev_cpu_delay[index] == 0 || b->task_reads < 2;
+        b->prev_cpu_delay[index] = cpu_delay;
+        
+        double others = (double)cpu_diff - b->task_delay_rate[index] * elapsed - probe_delay;
+        if (!first && others > threshold_ns && backoff_shed(b, index, now)) {
+            atomic_fetch_add_explicit(&b->rundelay_events, 1, memory_order_relaxed);
+        }
+    }
+}
+
+// PSI触发器报告CPU等待: 等待主要来自CMM自身线程时忽略，否则所有核心退让
+void backoff_check_psi(backoff_t* b, double now) {
+    unsigned long long total = 0;
+    if (read_proc_fd(b->psi_read_fd, b->buf, sizeof(b->buf)) > 0) {
+        const char* p = strstr(b->buf, "total=");
+        if (p) {
+            p += 6;
+            total = parse_ull(&p);
+        }
+    }
+    unsigned long long own = 0;
+    for (int i = 0; i <= num_cpu_cores; i++) {
+        if (i == num_cpu_cores && !wake_probe.started) break;
+        own += backoff_task_delay(b, i);
+    }
+    
+    unsigned long long stall_us = total > b->prev_psi_total ? total - b->prev_psi_total : 0;
+    unsigned long long own_us = own > b->prev_psi_own ? (own - b->prev_psi_own) / 1000 : 0;
+    b->prev_psi_total = total;
+    b->prev_psi_own = own;
+    if (stall_us > 0 && own_us >= stall_us * 9 / 10) {
+        atomic_fetch_add_explicit(&b->psi_ignored, 1, memory_order_relaxed);
+        return;
+    }
+    bool shed = false;
+    for (int i = 0; i < num_cpu_cores; i++) {
+        shed |= backoff_shed(b, i, now);
+    }
+    if (shed) atomic_fetch_add_explicit(&b->psi_events, 1, memory_order_relaxed);
+}
+
+// 内存PSI触发时的释放操作需要压载区和内存控制锁，定义在allocate_memory之后
+void backoff_release_memory(backoff_t* b, double now);
+
+// 注册PSI触发器: 窗口内累计等待超过stall_ms时内核通过POLLPRI通知
+// 非特权进程的窗口必须是2秒的整数倍，失败时按比例放大窗口重试
+int backoff_open_psi(const char* path, double stall_ms) {
+    unsigned long long stall_us = (unsigned long long)(stall_ms * 1000.0);
+    unsigned long long window_us = BACKOFF_WINDOW_US;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) return -1;
+        char trigger[64];
+        int len = snprintf(trigger, sizeof(trigger), "some %llu %llu", stall_us, window_us);
+        if (write(fd, trigger, (size_t)len + 1) >= 0) return fd;
+        close(fd);
+        stall_us *= 4;
+        window_us *= 4;
+    }
+    return -1;
+}
+
+// 退让线程: 等待CPU和内存的PSI事件，同时每10毫秒检查一次运行队列等待时间
+void* backoff_thread(void* arg) {
+    backoff_t* b = (backoff_t*)arg;
+    struct pollfd pfds[2] = { { b->psi_fd, POLLPRI, 0 }, { b->mem_psi_fd, POLLPRI, 0 } };
+    int timeout_ms = b->schedstat_fd >= 0 ? BACKOFF_POLL_MS : 100;
+    double last = get_monotonic_time();
+    
+    while (running) {
+        // fd为-1的项被poll忽略
+        int n = poll(pfds, 2, timeout_ms);
+        double now = get_monotonic_time();
+        backoff_recover(b, now - last, now);
+        if (n > 0 && (pfds[0].revents & POLLPRI)) {
+            backoff_check_psi(b, now);
+        } else if (n > 0 && (pfds[0].revents & (POLLERR | POLLNVAL))) {
+            // 触发器失效(例如/proc/pressure被卸载)，只保留运行队列检测
+            close(b->psi_fd);
+            b->psi_fd = pfds[0].fd = -1;
+        }
+        if (n > 0 && (pfds[1].revents & POLLPRI)) {
+            backoff_release_memory(b, now);
+        } else if (n > 0 && (pfds[1].revents & (POLLERR | POLLNVAL))) {
+            close(b->mem_psi_fd);
+            b->mem_psi_fd = pfds[1].fd = -1;
+        }
+        if (b->schedstat_fd >= 0) {
+            backoff_check_rundelay(b, now - last, now);
+        }
+        last = now;
+    }
+    return NULL;
+}
+#endif
+
+#ifndef _WIN32
+// 关闭退让使用的文件并释放状态
+void backoff_close(backoff_t* b) {
+    if (b->task_fds) {
+        for (int i = 0; i <= num_cpu_cores; i++) {
+            if (b->task_fds[i] >= 0) close(b->task_fds[i]);
+        }
+    }
+    if (b->psi_fd >= 0) close(b->psi_fd);
+    if (b->psi_read_fd >= 0) close(b->psi_read_fd);
+    if (b->schedstat_fd >= 0) close(b->schedstat_fd);
+    if (b->mem_psi_fd >= 0) close(b->mem_psi_fd);
+    free(b->task_fds);
+    free(b->prev_task_delay);
+    free(b->task_delay_rate);
+    free(b->prev_cpu_delay);
+    free(b->last_shed);
+    free(b->cpu_index);
+    b->task_fds = NULL;
+    b->prev_task_delay = b->prev_cpu_delay = NULL;
+    b->task_delay_rate = NULL;
+    b->last_shed = NULL;
+    b->cpu_index = NULL;
+    b->psi_fd = b->psi_read_fd = b->schedstat_fd = b->mem_psi_fd = -1;
+}
+#endif
+
+// 启动压力退让线程，CPU和内存的阈值都为0时不启动
+void backoff_start() {
+    if (backoff_stall_ms <= 0 && mem_backoff_stall_ms <= 0) return;
+#ifdef _WIN32
+    printf("Windows上不支持PSI压力退让\n");
+#else
+    backoff_t* b = &backoff;
+    b->psi_fd = b->psi_read_fd = b->schedstat_fd = b->mem_psi_fd = -1;
+    
+    if (backoff_stall_ms > 0) {
+        b->psi_fd = backoff_open_psi("/proc/pressure/cpu", backoff_stall_ms);
+        b->psi_read_fd = open("/proc/pressure/cpu", O_RDONLY | O_CLOEXEC);
+        b->schedstat_fd = open("/proc/schedstat", O_RDONLY | O_CLOEXEC);
+        b->task_fds = (int*)malloc((num_cpu_cores + 1) * sizeof(int));
+        b->prev_task_delay = (unsigned long long*)calloc(num_cpu_cores + 1, sizeof(unsigned long long));
+        b->task_delay_rate = (double*)calloc(num_cpu_cores + 1, sizeof(double));
+        b->prev_cpu_delay = (unsigned long long*)calloc(num_cpu_cores, sizeof(unsigned long long));
+        b->last_shed = (double*)calloc(num_cpu_cores, sizeof(double));
+        // core_ctrls按cpu_id升序排列，最后一个为最大编号
+        b->cpu_index_len = core_ctrls[num_cpu_cores - 1].cpu_id + 1;
+        b->cpu_index = (int*)malloc((size_t)b->cpu_index_len * sizeof(int));
+        if (b->task_fds) {
+            for (int i = 0; i <= num_cpu_cores; i++) b->task_fds[i] = -1;
+        }
+        if (b->cpu_index) {
+            for (int cpu = 0; cpu < b->cpu_index_len; cpu++) b->cpu_index[cpu] = -1;
+            for (int i = 0; i < num_cpu_cores; i++) b->cpu_index[core_ctrls[i].cpu_id] = i;
+        }
+        if (!b->task_fds || !b->prev_task_delay || !b->task_delay_rate || !b->prev_cpu_delay || !b->last_shed ||
+            !b->cpu_index) {
+            printf("内存分配失败，不启用压力退让\n");
+            backoff_close(b);
+            return;
+        }
+        if (read_proc_fd(b->psi_read_fd, b->buf, sizeof(b->buf)) > 0) {
+            const char* p = strstr(b->buf, "total=");
+            if (p) {
+                p += 6;
+                b->prev_psi_total = parse_ull(&p);
+            }
+        }
+        if (b->psi_fd < 0 && b->schedstat_fd < 0) {
+            printf("PSI和/proc/schedstat都不可用，不启用CPU压力退让\n");
+        } else {
+            printf("CPU压力退让: 阈值 %.1f ms/500ms, PSI触发器%s, 运行队列等待%s\n", backoff_stall_ms,
+                   b->psi_fd >= 0 ? "已注册" : "不可用", b->schedstat_fd >= 0 ? "每10ms检查" : "不可用(没有/proc/schedstat)");
+        }
+    }
+    
+    // 按cgroup计算时使用cgroup自己的memory.pressure，容器内的内存压力比整机更早出现
+    if (mem_backoff_stall_ms > 0) {
+        char path[600] = "/proc/pressure/memory";
+        if (cgroup.active) snprintf(path, sizeof(path), "%s/memory.pressure", cgroup.path);
+        b->mem_psi_fd = backoff_open_psi(path, mem_backoff_stall_ms);
+        if (b->mem_psi_fd < 0) {
+            printf("无法在%s注册内存PSI触发器，不启用内存压力释放\n", path);
+        } else {
+            printf("内存压力释放: 阈值 %.1f ms/500ms (%s)\n", mem_backoff_stall_ms, path);
+        }
+    }
+    
+    if (b->psi_fd < 0 && b->schedstat_fd < 0 && b->mem_psi_fd < 0) {
+        backoff_close(b);
+        return;
+    }
+    b->started = pthread_create(&b->thread, NULL, backoff_thread, b) == 0;
+    if (!b->started) {
+        printf("创建压力退让线程失败\n");
+        backoff_close(b);
+    }
+#endif
+}
+
+// 停止压力退让线程并关闭文件，调用前running已为0
+void backoff_stop() {
+#ifndef _WIN32
+    if (!backoff.started) return;
+    pthread_join(backoff.thread, NULL);
+    backoff.started = false;
+    backoff_close(&backoff);
+#endif
+}
+
+// 压载内容填充方式: random为每页不同的伪随机数据(不可压缩、不可去重)，touch只触发缺页
+enum { FILL_RANDOM = 0, FILL_TOUCH };
+
+// 压载区的内存来源: anon为匿名内存，memfd为memfd(shmem)共享映射，用打洞(FALLOC_FL_PUNCH_HOLE)释放
+enum { BALLAST_ANON = 0, BALLAST_MEMFD };
+
+// SplitMix64: 由种子和页号派生各页独立的随机状态
+uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// 标量随机填充: 每页4路交错的xorshift64，first_page为start对应的全局页号
+void fill_random_scalar(char* start, size_t bytes, size_t page_size, uint64_t first_page, uint64_t seed) {
+    for (size_t offset = 0; offset < bytes; offset += page_size) {
+        uint64_t* p = (uint64_t*)(start + offset);
+        uint64_t page = seed ^ ((first_page + offset / page_size) << 2);
+        uint64_t s0 = splitmix64(page) | 1, s1 = splitmix64(page + 1) | 1;
+        uint64_t s2 = splitmix64(page + 2) | 1, s3 = splitmix64(page + 3) | 1;
+        for (size_t i = 0; i < page_size / 8; i += 4) {
+            s0 ^= s0 << 13; s0 ^= s0 >> 7; s0 ^= s0 << 17;
+            s1 ^= s1 << 13; s1 ^= s1 >> 7; s1 ^= s1 << 17;
+            s2 ^= s2 << 13; s2 ^= s2 >> 7; s2 ^= s2 << 17;
+            s3 ^= s3 << 13; s3 ^= s3 >> 7; s3 ^= s3 << 17;
+            p[i] = s0; p[i + 1] = s1; p[i + 2] = s2; p[i + 3] = s3;
+        }
+    }
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(_WIN32)
+// AVX2随机填充: 与标量版本相同的xorshift64，8路并行，每次迭代写满一个缓存行
+// 使用非临时存储，避免大块填充时读取目标缓存行并污染缓存
+__attribute__((target("avx2")))
+void fill_random_avx2(char* start, size_t bytes, size_t page_size, uint64_t first_page, uint64_t seed) {
+    for (size_t offset = 0; offset < bytes; offset += page_size) {
+        __m256i* p = (__m256i*)(start + offset);
+        uint64_t page = seed ^ ((first_page + offset / page_size) << 3);
+        __m256i a = _mm256_set_epi64x(splitmix64(page + 3) | 1, splitmix64(page + 2) | 1,
+                                      splitmix64(page + 1) | 1, splitmix64(page) | 1);
+        __m256i b = _mm256_set_epi64x(splitmix64(page + 7) | 1, splitmix64(page + 6) | 1,
+                                      splitmix64(page + 5) | 1, splitmix64(page + 4) | 1);
+        for (size_t i = 0; i < page_size / 32; i += 2) {
+            a = _mm256_xor_si256(a, _mm256_slli_epi64(a, 13));
+            b = _mm256_xor_si256(b, _mm256_slli_epi64(b, 13));
+            a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 7));
+            b = _mm256_xor_si256(b, _mm256_srli_epi64(b, 7));
+            a = _mm256_xor_si256(a, _mm256_slli_epi64(a, 17));
+            b = _mm256_xor_si256(b, _mm256_slli_epi64(b, 17));
+            _mm256_stream_si256(p + i, a);
+            _mm256_stream_si256(p + i + 1, b);
+        }
+    }
+    _mm_sfence();
+}
+#endif
+
+// 随机填充实现，运行时根据CPUID选择
+typedef void (*fill_fn_t)(char* start, size_t bytes, size_t page_size, uint64_t first_page, uint64_t seed);
+fill_fn_t fill_random = fill_random_scalar;
+const char* fill_random_variant = "scalar";
+
+// 选择随机填充实现
+void init_fill_kernel() {
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(_WIN32)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        fill_random = fill_random_avx2;
+        fill_random_variant = "avx2";
+    }
+#endif
+}
+
+// 内存压载区: 预留一段连续地址空间，按页粒度增长和收缩，精确到字节计数
+typedef struct {
+    char* base;        // 预留区起始地址
+    size_t reserved;   // 预留的地址空间大小(字节)
+    size_t size;       // 当前已提交的压载大小(字节，页对齐)
+    size_t resident;   // 最近一次核实的驻留字节数
+    size_t page_size;  // 系统页大小
+    uint64_t seed;     // 随机填充种子，每个进程不同，避免多个实例的页面内容相同
+    bool locked;       // 压载内存是否已被mlock锁定
+    size_t release_pending;            // 已释放但尚未经采样确认的字节数
+    unsigned long long release_rss_kb; // 释放前的自身RSS
+    double release_time;               // 释放时刻(单调时钟)
+    double grow_time;  // 最近一次增长全部写完的时刻(单调时钟)，早于它的采样还没有反映这次增长
+    bool simulated;    // 控制器模拟: 只记账，不映射也不写入内存
+    int fd;            // memfd压载的文件描述符，匿名映射为-1
+    size_t pressure_cap;   // 内存压力释放后的增长上限，0为不限制
+    double pressure_time;  // 最近一次压力释放的时刻(单调时钟)
+} ballast_t;
+
+ballast_t ballast = {0};
+
+// 将字节数向下对齐到页边界
+size_t ballast_page_floor(const ballast_t* b, size_t bytes) {
+    return bytes - bytes % b->page_size;
+}
+
+// 预留压载区地址空间(不占用物理内存)
+bool ballast_init(ballast_t* b, size_t reserve_bytes) {
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    b->page_size = si.dwPageSize;
+#else
+    long page = sysconf(_SC_PAGESIZE);
+    b->page_size = page > 0 ? (size_t)page : 4096;
+#endif
+    reserve_bytes = ballast_page_floor(b, reserve_bytes);
+    if (reserve_bytes == 0) return false;
+    if (b->simulated) {
+        b->reserved = reserve_bytes;
+        b->size = 0;
+        return true;
+    }
+
+#ifdef _WIN32
+    void* base = VirtualAlloc(NULL, reserve_bytes, MEM_RESERVE, PAGE_NOACCESS);
+    if (!base) return false;
+#else
+    // memfd模式: 文件按预留大小截断(稀疏，不占内存)，页面计入Shmem，和匿名内存一样不算可用内存
+    b->fd = -1;
+    if (ballast_backing == BALLAST_MEMFD) {
+        b->fd = memfd_create("cmm-ballast", MFD_CLOEXEC);
+        if (b->fd < 0 || ftruncate(b->fd, (off_t)reserve_bytes) != 0) {
+            printf("创建memfd压载区失败: %s\n", strerror(errno));
+            if (b->fd >= 0) close(b->fd);
+            b->fd = -1;
+            return false;
+        }
+    }
+    void* base = b->fd >= 0 ?
+        mmap(NULL, reserve_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, b->fd, 0) :
+        mmap(NULL, reserve_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        if (b->fd >= 0) close(b->fd);
+        b->fd = -1;
+        return false;
+    }
+#endif
+#if !defined(_WIN32) && defined(MADV_UNMERGEABLE)
+    // 即使进程继承了全局KSM合并设置，压载页也不参与合并
+    if (ballast_unmergeable && madvise(base, reserve_bytes, MADV_UNMERGEABLE) != 0) {
+        printf("标记压载区为不可合并失败: %s\n", strerror(errno));
+    }
+#endif
+    b->base = (char*)base;
+    b->reserved = reserve_bytes;
+    b->size = 0;
+    b->seed = splitmix64(get_time_ns() ^ ((uint64_t)getpid() << 32));
+    return true;
+}
+
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#endif
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
+
+// 用mbind设置压载区的NUMA内存策略，必须在首次写入之前调用
+bool ballast_set_mempolicy(ballast_t* b, int mode, unsigned long long nodes) {
+    if (b->simulated || !b->base) return true;
+#if !defined(_WIN32) && defined(SYS_mbind)
+    unsigned long mask = (unsigned long)nodes;
+    if (syscall(SYS_mbind, b->base, b->reserved, mode, &mask, (unsigned long)MAX_NUMA_NODES + 1, 0) != 0) {
+        printf("设置压载区NUMA策略失败: %s\n", strerror(errno));
+        return false;
+    }
+    return true;
+#else
+    (void)mode;
+    (void)nodes;
+    printf("当前平台不支持设置NUMA内存策略\n");
+    return false;
+#endif
+}
+
+// 使新增区域的每一页都真正分配物理内存
+void ballast_populate(const ballast_t* b, char* start, size_t bytes) {
+    if (ballast_fill_mode == FILL_RANDOM) {
+        // 写入随机内容本身就会触发每一页的缺页
+        fill_random(start, bytes, b->page_size, (uint64_t)(start - b->base) / b->page_size, b->seed);
+        return;
+    }
+#if !defined(_WIN32) && defined(MADV_POPULATE_WRITE)
+    // 一次系统调用完成所有页的缺页处理(Linux 5.14+)
+    if (madvise(start, bytes, MADV_POPULATE_WRITE) == 0) {
+        return;
+    }
+#endif
+    // 逐页写入，确保每一页都触发缺页
+    for (size_t offset = 0; offset < bytes; offset += b->page_size) {
+        start[offset] = (char)0xAA;
+    }
+}
+
+// 锁定新增区域，失败时提示一次并继续以非锁定方式运行
+void ballast_lock_range(ballast_t* b, char* start, size_t bytes) {
+    if (!ballast_mlock) return;
+#ifdef _WIN32
+    bool ok = VirtualLock(start, bytes) != 0;
+#else
+    bool ok = mlock(start, bytes) == 0;
+#endif
+    if (ok) {
+        b->locked = true;
+        return;
+    }
+#ifdef _WIN32
+    printf("锁定压载内存失败(错误码 %lu)，将以非锁定方式继续\n", GetLastError());
+#else
+    printf("锁定压载内存失败: %s，将以非锁定方式继续\n", strerror(errno));
+#endif
+    ballast_mlock = false;
+}
+
+// 在压载区末尾增长指定字节数，返回实际增长的字节数
+size_t ballast_grow(ballast_t* b, size_t bytes) {
+    if (!b->base && !b->simulated) return 0;
+    bytes = ballast_page_floor(b, bytes);
+    if (bytes > b->reserved - b->size) bytes = b->reserved - b->size;
+    if (bytes == 0) return 0;
+    if (b->simulated) {
+        b->size += bytes;
+        b->resident += bytes;
+        return bytes;
+    }
+
+    char* start = b->base + b->size;
+#ifdef _WIN32
+    if (!VirtualAlloc(start, bytes, MEM_COMMIT, PAGE_READWRITE)) return 0;
+#endif
+    ballast_populate(b, start, bytes);
+    ballast_lock_range(b, start, bytes);
+    b->size += bytes;
+    b->resident += bytes;
+    b->grow_time = get_monotonic_time();
+    return bytes;
+}
+
+// 从压载区末尾释放指定字节数，返回实际释放的字节数
+size_t ballast_shrink(ballast_t* b, size_t bytes) {
+    if (!b->base && !b->simulated) return 0;
+    bytes = ballast_page_floor(b, bytes);
+    if (bytes > b->size) bytes = b->size;
+    if (bytes == 0) return 0;
+    if (b->simulated) {
+        b->size -= bytes;
+        if (b->resident > b->size) b->resident = b->size;
+        return bytes;
+    }
+
+    char* start = b->base + b->size - bytes;
+#ifdef _WIN32
+    if (b->locked) VirtualUnlock(start, bytes);
+    if (!VirtualFree(start, bytes, MEM_DECOMMIT)) return 0;
+#else
+    if (b->locked) munlock(start, bytes);
+    if (b->fd >= 0) {
+        // 打洞直接释放shmem页面，映射中的对应页表项同时被清除
+        if (fallocate(b->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)(start - b->base), (off_t)bytes) != 0) {
+            return 0;
+        }
+    } else if (madvise(start, bytes, MADV_DONTNEED) != 0) {
+        // 退而用新的匿名映射覆盖该范围，旧页面随之归还系统
+        void* p = mmap(start, bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+        if (p == MAP_FAILED) return 0;
+    }
+#endif
+    b->size -= bytes;
+    if (b->resident > b->size) b->resident = b->size;
+    return bytes;
+}
+
+// 用采样快照核实上一次释放，返回是否仍在等待确认
+// 确认时dropped为自身RSS实际下降的字节数
+bool ballast_release_unconfirmed(ballast_t* b, const proc_snapshot_t* snap, size_t* dropped) {
+    *dropped = 0;
+    if (b->release_pending == 0) return false;
+    
+    // 释放之后还没有新的采样
+    if (snap->timestamp <= b->release_time) return true;
+    
+    if (b->release_rss_kb > snap->self_rss_kb) {
+        *dropped = (size_t)(b->release_rss_kb - snap->self_rss_kb) * 1024;
+    }
+    // RSS下降达到释放量的90%视为确认；超过3秒仍未达到时放弃等待，避免阻塞控制
+    if (*dropped < b->release_pending / 10 * 9 && snap->timestamp - b->release_time < 3.0) {
+        return true;
+    }
+    b->release_pending = 0;
+    return false;
+}
+
+// 通过mincore核实压载区实际驻留的字节数
+size_t ballast_measure_resident(ballast_t* b) {
+    if (b->simulated) {
+        b->resident = b->size;
+        return b->resident;
+    }
+    if (!b->base || b->size == 0) {
+        b->resident = 0;
+        return 0;
+    }
+#ifdef _WIN32
+    // 已提交的页在增长时全部写入过，近似视为驻留
+    b->resident = b->size;
+#else
+    static unsigned char vec[65536];
+    size_t pages = b->size / b->page_size;
+    size_t resident_pages = 0;
+    for (size_t first = 0; first < pages; first += sizeof(vec)) {
+        size_t n = pages - first < sizeof(vec) ? pages - first : sizeof(vec);
+        if (mincore(b->base + first * b->page_size, n * b->page_size, vec) != 0) {
+            return b->resident;
+        }
+        for (size_t i = 0; i < n; i++) {
+            resident_pages += vec[i] & 1;
+        }
+    }
+    b->resident = resident_pages * b->page_size;
+#endif
+    return b->resident;
+}
+
+// 释放整个压载区
+void ballast_destroy(ballast_t* b) {
+    if (!b->base) return;
+#ifdef _WIN32
+    VirtualFree(b->base, 0, MEM_RELEASE);
+#else
+    if (b->locked) munlock(b->base, b->size);
+    munmap(b->base, b->reserved);
+    if (b->fd >= 0) close(b->fd);
+    b->fd = -1;
+#endif
+    b->base = NULL;
+    b->reserved = 0;
+    b->size = 0;
+    b->resident = 0;
+    b->locked = false;
+}
+
+// 压载后台填充线程池: 增长时按块并行写入 [start, end)，主循环不被阻塞
+#define FILL_CHUNK_BYTES (16 * 1024 * 1024)
+#define MAX_FILL_THREADS 64
+typedef struct {
+    ballast_t* arena;   // 当前任务所属的压载区
+    size_t start;       // 当前任务起点(相对压载区起始的偏移)
+    size_t end;         // 当前任务终点
+    size_t next;        // 下一个待领取块的偏移
+    size_t done;        // 已完成的字节数
+    double finish_time; // 最近一块写完的时刻(单调时钟)
+    int busy;           // 正在填充块的线程数
+    bool active;        // 是否有未结束的任务
+    bool cancel;        // 目标下降时取消剩余块
+    bool stop;          // 线程池退出
+    int num_threads;
+#ifdef _WIN32
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE wake;
+    HANDLE threads[MAX_FILL_THREADS];
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t threads[MAX_FILL_THREADS];
+#endif
+} fill_pool_t;
+
+fill_pool_t fill_pool = {0};
+
+// 加锁填充线程池
+void fill_pool_lock() {
+#ifdef _WIN32
+    EnterCriticalSection(&fill_pool.lock);
+#else
+    pthread_mutex_lock(&fill_pool.lock);
+#endif
+}
+
+// 解锁填充线程池
+void fill_pool_unlock() {
+#ifdef _WIN32
+    LeaveCriticalSection(&fill_pool.lock);
+#else
+    pthread_mutex_unlock(&fill_pool.lock);
+#endif
+}
+
+// 填充线程: 逐块领取任务，块之间检查取消标志
+void* fill_thread(void* arg) {
+    long thread_index = (long)(intptr_t)arg;
+    
+#ifndef _WIN32
+    // 分散绑定到允许的核心上，首次写入使页面分配在该核心所在的NUMA节点
+    int core = (int)(thread_index * num_cpu_cores / fill_pool.num_threads);
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core_ctrls[core].cpu_id, &cpuset);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+#else
+    (void)thread_index;
+#endif
+    
+    fill_pool_lock();
+    for (;;) {
+        while (!fill_pool.stop && (fill_pool.cancel || fill_pool.next >= fill_pool.end)) {
+#ifdef _WIN32
+            SleepConditionVariableCS(&fill_pool.wake, &fill_pool.lock, INFINITE);
+#else
+            pthread_cond_wait(&fill_pool.wake, &fill_pool.lock);
+#endif
+        }
+        if (fill_pool.stop) break;
+        
+        ballast_t* arena = fill_pool.arena;
+        size_t offset = fill_pool.next;
+        size_t len = fill_pool.end - offset < FILL_CHUNK_BYTES ? fill_pool.end - offset : FILL_CHUNK_BYTES;
+        fill_pool.next += len;
+        fill_pool.busy++;
+        fill_pool_unlock();
+        
+        ballast_populate(arena, arena->base + offset, len);
+        
+        fill_pool_lock();
+        fill_pool.busy--;
+        fill_pool.done += len;
+        fill_pool.finish_time = get_monotonic_time();
+    }
+    fill_pool_unlock();
+    return NULL;
+}
+
+// 启动填充线程池，count为0时按核心数自动选择(最多8个)
+bool fill_pool_start(int count) {
+    if (count <= 0) count = num_cpu_cores < 8 ? num_cpu_cores : 8;
+    if (count > MAX_FILL_THREADS) count = MAX_FILL_THREADS;
+    fill_pool.num_threads = count;
+#ifdef _WIN32
+    InitializeCriticalSection(&fill_pool.lock);
+    InitializeConditionVariable(&fill_pool.wake);
+#else
+    pthread_mutex_init(&fill_pool.lock, NULL);
+    pthread_cond_init(&fill_pool.wake, NULL);
+#endif
+    for (long i = 0; i < count; i++) {
+#ifdef _WIN32
+        fill_pool.threads[i] = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)fill_thread, (void*)i, 0, NULL);
+        if (fill_pool.threads[i] == NULL) {
+#else
+        if (pthread_create(&fill_pool.threads[i], NULL, fill_thread, (void*)i) != 0) {
+#endif
+            printf("创建压载填充线程 #%ld 失败\n", i);
+            fill_pool.num_threads = (int)i;
+            return i > 0;
+        }
+    }
+    return true;
+}
+
+// 停止填充线程池，未完成的块被放弃
+void fill_pool_stop() {
+    if (fill_pool.num_threads == 0) return;
+    fill_pool_lock();
+    fill_pool.stop = true;
+    fill_pool_unlock();
+#ifdef _WIN32
+    WakeAllConditionVariable(&fill_pool.wake);
+    for (int i = 0; i < fill_pool.num_threads; i++) {
+        WaitForSingleObject(fill_pool.threads[i], INFINITE);
+        CloseHandle(fill_pool.threads[i]);
+    }
+    DeleteCriticalSection(&fill_pool.lock);
+#else
+    pthread_cond_broadcast(&fill_pool.wake);
+    for (int i = 0; i < fill_pool.num_threads; i++) {
+        pthread_join(fill_pool.threads[i], NULL);
+    }
+    pthread_mutex_destroy(&fill_pool.lock);
+    pthread_cond_destroy(&fill_pool.wake);
+#endif
+    fill_pool.num_threads = 0;
+}
+
+// 提交后台增长任务，返回排队的字节数(只在没有未结束任务时调用)
+size_t ballast_grow_async(ballast_t* b, size_t bytes) {
+    if (!b->base || fill_pool.num_threads == 0) return ballast_grow(b, bytes);
+    bytes = ballast_page_floor(b, bytes);
+    if (bytes > b->reserved - b->size) bytes = b->reserved - b->size;
+    if (bytes == 0) return 0;
+#ifdef _WIN32
+    if (!VirtualAlloc(b->base + b->size, bytes, MEM_COMMIT, PAGE_READWRITE)) return 0;
+#endif
+    
+    fill_pool_lock();
+    fill_pool.arena = b;
+    fill_pool.start = b->size;
+    fill_pool.next = b->size;
+    fill_pool.end = b->size + bytes;
+    fill_pool.done = 0;
+    fill_pool.cancel = false;
+    fill_pool.active = true;
+    fill_pool_unlock();
+#ifdef _WIN32
+    WakeAllConditionVariable(&fill_pool.wake);
+#else
+    pthread_cond_broadcast(&fill_pool.wake);
+#endif
+    return bytes;
+}
+
+// 取消未领取的填充块，已领取的块仍会写完
+void ballast_cancel_fill() {
+    fill_pool_lock();
+    if (fill_pool.active) fill_pool.cancel = true;
+    fill_pool_unlock();
+}
+
+// 线程池是否有未结束的任务(可能属于另一个压载区)
+bool fill_pool_busy() {
+    fill_pool_lock();
+    bool active = fill_pool.active;
+    fill_pool_unlock();
+    return active;
+}
+
+// 检查后台任务，结束时把已填充的部分计入压载区，返回任务是否仍在进行
+// pending非空时返回尚未填充的字节数
+bool ballast_poll_fill(ballast_t* b, size_t* pending) {
+    fill_pool_lock();
+    if (!fill_pool.active || fill_pool.arena != b) {
+        fill_pool_unlock();
+        if (pending) *pending = 0;
+        return false;
+    }
+    bool finished = fill_pool.busy == 0 && (fill_pool.cancel || fill_pool.next >= fill_pool.end);
+    size_t start = fill_pool.start, end = fill_pool.end, filled_end = fill_pool.next;
+    if (pending) *pending = end - start - fill_pool.done;
+    if (finished) {
+        fill_pool.active = false;
+        b->grow_time = fill_pool.finish_time;
+    }
+    fill_pool_unlock();
+    
+    if (!finished) return true;
+    
+    // 所有已领取的块都已写完，[start, filled_end) 全部驻留
+#ifdef _WIN32
+    if (filled_end < end) VirtualFree(b->base + filled_end, end - filled_end, MEM_DECOMMIT);
+#endif
+    ballast_lock_range(b, b->base + start, filled_end - start);
+    b->size = filled_end;
+    b->resident += filled_end - start;
+    if (pending) *pending = 0;
+    return false;
+}
+
+// 内存控制锁: 主循环的控制步和内存压力释放线程互斥地修改压载区
+#ifdef _WIN32
+SRWLOCK mem_lock = SRWLOCK_INIT;
+#else
+pthread_mutex_t mem_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+// 加锁内存控制
+void mem_lock_acquire() {
+#ifdef _WIN32
+    AcquireSRWLockExclusive(&mem_lock);
+#else
+    pthread_mutex_lock(&mem_lock);
+#endif
+}
+
+// 解锁内存控制
+void mem_lock_release() {
+#ifdef _WIN32
+    ReleaseSRWLockExclusive(&mem_lock);
+#else
+    pthread_mutex_unlock(&mem_lock);
+#endif
+}
+
+#define MEM_BACKOFF_RECOVER_PER_SEC 0.05 // 压力释放后增长上限每秒恢复内存总量的比例
+
+// 当前的增长上限: 压力释放时的大小按固定速率恢复，恢复到预留大小后取消上限
+size_t ballast_pressure_cap(ballast_t* b, unsigned long long total_bytes, double now) {
+    if (b->pressure_cap == 0) return b->reserved;
+    double cap = b->pressure_cap + total_bytes * MEM_BACKOFF_RECOVER_PER_SEC * (now - b->pressure_time);
+    if (cap >= (double)b->reserved) {
+        b->pressure_cap = 0;
+        return b->reserved;
+    }
+    return (size_t)cap;
+}
+
+// 内存压力时立即释放fraction比例的压载: 先取消并等待后台填充结束(已领取的块最多16 MB)，再从末尾收缩，
+// 之后的增长受ballast_pressure_cap限制；调用时须持有mem_lock，返回释放的字节数
+size_t ballast_pressure_release(ballast_t* b, double fraction, unsigned long long self_rss_kb, double now) {
+    if (!b->base) return 0;
+    ballast_cancel_fill();
+    while (ballast_poll_fill(b, NULL)) {
+#ifdef _WIN32
+        Sleep(1);
+#else
+        usleep(1000);
+#endif
+    }
+    
+    size_t freed = ballast_shrink(b, fraction >= 1.0 ? b->size : (size_t)(b->size * fraction));
+    if (freed > 0) {
+        // 与尚未确认的释放合并，RSS基准保持为较早的一次
+        if (b->release_pending == 0) b->release_rss_kb = self_rss_kb;
+        b->release_pending += freed;
+        b->release_time = now;
+    }
+    b->pressure_cap = b->size > 0 ? b->size : b->page_size;
+    b->pressure_time = now;
+    return freed;
+}
+
+// 内存控制器状态，独立出来以便模拟器在每个场景开始时重置
+typedef struct {
+    unsigned long long failed_allocations_total; // 累计分配失败次数(指标导出)
+    long long deficit;                  // 上一步的缺口(字节，目标已用 - 实际已用)
+    double last_step_time;              // 上一步的时刻，用于按经过时间限制增长速率
+    int residency_check_counter;        // 驻留量核实计数
+} mem_ctrl_t;
+
+mem_ctrl_t mem_ctrl = {0};
+
+// 每个NUMA节点单独的内存目标(--mem-node)，压载区用mbind绑定到该节点
+typedef struct {
+    int node;
+    mem_target_t target;
+    ballast_t arena;
+    mem_ctrl_t ctrl;
+    unsigned long long target_bytes;    // 最近一步换算的目标已用字节数
+} node_mem_t;
+
+node_mem_t node_mems[MAX_NUMA_NODES];
+int num_node_mems = 0;
+char mem_node_spec[256] = ""; // 原始配置字符串，用于保存配置
+
+// 解析--mem-node，例如 "0:60,1:free:4G"，每项的目标写法与-m相同
+bool parse_mem_node_targets(const char* spec) {
+    int count = 0;
+    const char* p = spec;
+    while (*p) {
+        char* end;
+        long node = strtol(p, &end, 10);
+        if (end == p || *end != ':' || node < 0 || node >= MAX_NUMA_NODES) {
+            printf("无法解析节点内存目标: %s\n", p);
+            return false;
+        }
+        // 目标到下一个以数字和冒号开头的项为止(free:后面也有冒号)
+        const char* value = end + 1;
+        const char* next = value;
+        for (;;) {
+            next = strchr(next, ',');
+            if (!next) break;
+            const char* q = next + 1;
+            while (isdigit((unsigned char)*q)) q++;
+            if (q > next + 1 && *q == ':') break;
+            next++;
+        }
+        char target[64];
+        size_t len = next ? (size_t)(next - value) : strlen(value);
+        if (len == 0 || len >= sizeof(target)) {
+            printf("无法解析节点内存目标: %s\n", p);
+            return false;
+        }
+        memcpy(target, value, len);
+        target[len] = '\0';
+        if (count >= MAX_NUMA_NODES) return false;
+        for (int i = 0; i < count; i++) {
+            if (node_mems[i].node == node) {
+                printf("节点%ld的内存目标重复\n", node);
+                return false;
+            }
+        }
+        memset(&node_mems[count], 0, sizeof(node_mems[count]));
+        node_mems[count].node = (int)node;
+        if (!parse_mem_target(target, &node_mems[count].target)) {
+            printf("节点%ld的内存目标无效: %s\n", node, target);
+            return false;
+        }
+        count++;
+        p = next ? next + 1 : value + len;
+    }
+    num_node_mems = count;
+    snprintf(mem_node_spec, sizeof(mem_node_spec), "%s", spec);
+    return count > 0;
+}
+
+// 单个压载区的控制步，系统目标和每个NUMA节点的目标都经过这里
+// 缺口 = 目标已用 - 已用(字节)，一步补齐，增长按--mem-rate限速；label用于区分输出
+void ballast_control_step(ballast_t* b, mem_ctrl_t* ctrl, const char* label,
+                          unsigned long long target_bytes, unsigned long long used_bytes,
+                          unsigned long long total_bytes, const proc_snapshot_t* snap, double now) {
+    const size_t mb = 1024 * 1024;
+    
+    // 检查后台填充任务，结束时把已填充的部分计入压载区
+    size_t fill_pending = 0;
+    bool filling = ballast_poll_fill(b, &fill_pending);
+    
+    // 核实上一次释放是否已在RSS中体现
+    size_t released_pending = b->release_pending;
+    size_t rss_dropped = 0;
+    bool release_unconfirmed = ballast_release_unconfirmed(b, snap, &rss_dropped);
+    if (released_pending > 0 && !release_unconfirmed && verbose_mode) {
+        printf("%s释放确认: 释放 %.1f MB，自身RSS下降 %.1f MB\n", label,
+               released_pending / (1024.0 * 1024.0), rss_dropped / (1024.0 * 1024.0));
+    }
+    
+    // 后台填充尚未写入的部分还没有体现在已用内存中
+    long long deficit = (long long)target_bytes - (long long)used_bytes;
+    if (filling) deficit -= (long long)fill_pending;
+    ctrl->deficit = deficit;
+    
+    // 死区: 总量的1/1024(至少4 MB)，小于它的缺口视为采样噪声
+    long long deadband = (long long)(total_bytes / 1024);
+    if (deadband < (long long)(4 * mb)) deadband = (long long)(4 * mb);
+    
+    // 本步允许的最大增长量 = 速率 × 距上一步的时间
+    double elapsed = ctrl->last_step_time > 0.0 ? now - ctrl->last_step_time : update_interval;
+    if (elapsed <= 0.0 || elapsed > 2.0 * update_interval) elapsed = update_interval;
+    ctrl->last_step_time = now;
+    unsigned long long rate = mem_rate_bytes ? mem_rate_bytes : total_bytes / 2;
+    size_t max_grow = (size_t)(rate * elapsed);
+    
+    if (verbose_mode) {
+        printf("%s内存控制: 已用 %.1f MB, 目标 %.1f MB, 缺口 %+.1f MB\n", label,
+               (double)used_bytes / mb, (double)target_bytes / mb, (double)deficit / mb);
+    }
+    
+    if (deficit < -deadband) {
+        if (filling) {
+            // 目标已下降，取消尚未领取的填充块，任务结束后再收缩
+            ballast_cancel_fill();
+            if (verbose_mode) {
+                printf("%s内存超出目标，取消剩余 %.1f MB 的后台填充\n", label, (double)fill_pending / mb);
+            }
+        } else if (release_unconfirmed) {
+            // 上一次释放尚未在RSS中体现，继续释放会向下超调
+            if (verbose_mode) {
+                printf("%s等待上次释放的 %.1f MB 在RSS中确认\n", label, (double)b->release_pending / mb);
+            }
+        } else {
+            // 部分压载页被换出时，按实际驻留比例放大释放量，使RSS下降量等于缺口
+            size_t bytes_to_free = (size_t)(-deficit);
+            if (b->resident > 0 && b->resident < b->size) {
+                bytes_to_free = (size_t)((double)bytes_to_free * b->size / b->resident);
             }
-            
-            allocated_blocks += success_count;
-            
-            // 如果部分块分配失败，调整内存块数组大小
-            if (success_count < diff_blocks) {
+            size_t freed = ballast_shrink(b, bytes_to_free);
+            if (freed > 0) {
+                b->release_pending = freed;
+                b->release_rss_kb = snap->self_rss_kb;
+                b->release_time = now;
                 if (verbose_mode) {
-                    printf("警告：请求分配 %d 个块，但只成功分配了 %d 个\n", diff_blocks, success_count);
-                }
-                if (allocated_blocks < new_blocks) {
-                    char** resize_blocks = (char**)realloc(memory_blocks, allocated_blocks * sizeof(char*));
-                    if (resize_blocks) {
-                        memory_blocks = resize_blocks;
-                    }
+                    printf("%s释放压载内存 %.1f MB\n", label, (double)freed / mb);
                 }
             }
-        } 
-        else if (diff_blocks < 0) {
-            // 需要减少内存块
-            int blocks_to_free = -diff_blocks;
-            
-            // 限制每次释放的比例，防止过度波动
-            int max_free_percent = 30; // 默认限制在30%
-            
-            // 如果内存需求大幅减少，允许更大比例释放
-            if (diff_blocks < -allocated_blocks / 2) {
-                max_free_percent = 50;
+        }
+    } else if (deficit > deadband) {
+        if (filling) {
+            // 上一次增长仍在后台填充，等待其完成
+            if (verbose_mode) {
+                printf("%s后台填充中: 剩余 %.1f MB\n", label, (double)fill_pending / mb);
             }
-            
-            int max_free = (allocated_blocks * max_free_percent) / 100;
-            if (max_free < 1) max_free = 1;
-            if (blocks_to_free > max_free) blocks_to_free = max_free;
-            
-            // 释放末尾的块
-            for (int i = allocated_blocks - 1; i >= allocated_blocks - blocks_to_free; i--) {
-                if (memory_blocks[i]) {
-                    free(memory_blocks[i]);
-                    memory_blocks[i] = NULL;
-                    allocated_mb -= block_size_mb;
-                }
+        } else if (snap->timestamp <= b->grow_time) {
+            // 采样早于上一次增长写完，已用内存还没有包含这次增长，再增长会向上超调
+            if (verbose_mode) {
+                printf("%s等待采样反映上次增长\n", label);
             }
-            
-            // 更新已分配块数
-            allocated_blocks -= blocks_to_free;
-            
-            // 缩小内存块数组
-            if (allocated_blocks > 0) {
-                char** new_memory_blocks = (char**)realloc(memory_blocks, allocated_blocks * sizeof(char*));
-                if (!new_memory_blocks) {
-                    if (verbose_mode) {
-                        printf("无法缩小内存块数组\n");
-                    }
-                } else {
-                    memory_blocks = new_memory_blocks;
-                }
-            } else {
-                free(memory_blocks);
-                memory_blocks = NULL;
+        } else if (fill_pool_busy()) {
+            // 填充线程池正在为另一个节点的压载区工作
+            if (verbose_mode) {
+                printf("%s等待其他压载区的填充完成\n", label);
             }
-        }
-        // 如果diff_blocks == 0，保持当前分配不变
-    } else {
-        // 首次分配
-        memory_blocks = (char**)malloc(new_blocks * sizeof(char*));
-        
-        if (!memory_blocks) {
+        } else if (b->size + b->page_size > ballast_pressure_cap(b, total_bytes, now)) {
+            // 内存压力释放之后，增长上限还没有恢复
             if (verbose_mode) {
-                printf("无法分配内存块数组\n");
+                printf("%s内存压力释放后恢复中，暂不增长\n", label);
             }
-            consecutive_failed_allocations++;
-            return;
-        }
-        
-        int success_count = 0;
-        for (int i = 0; i < new_blocks; i++) {            memory_blocks[i] = (char*)malloc(block_size_mb * 1024 * 1024);
-            if (memory_blocks[i]) {
-                // 采用高效的内存初始化方法：只写入部分数据以确保物理内存被分配
-                for (int j = 0; j < block_size_mb; j += 2) {
-                    size_t offset = j * 1024 * 1024;
-                    memset(memory_blocks[i] + offset, 0xAA, 1024 * 256); // 只写入256KB
-                }
-                allocated_mb += block_size_mb;
-                success_count++;
-            } else {
+        } else {
+            size_t want = (size_t)deficit;
+            if (want > max_grow) want = max_grow;
+            size_t cap = ballast_pressure_cap(b, total_bytes, now);
+            if (want > cap - b->size) want = cap - b->size;
+            
+            // 交给填充线程池在后台写入，下一周期起计入压载区
+            size_t queued = ballast_grow_async(b, want);
+            if (queued < ballast_page_floor(b, want)) {
                 if (verbose_mode) {
-                    printf("无法分配内存块 #%d\n", i);
+                    printf("%s警告：请求增长 %.1f MB，但只能增长 %.1f MB\n", label,
+                           (double)want / mb, (double)queued / mb);
                 }
-                consecutive_failed_allocations++;
-                break; // 停止继续尝试
+                ctrl->failed_allocations_total++;
+            } else if (verbose_mode) {
+                printf("%s增长压载内存 %.1f MB\n", label, (double)queued / mb);
             }
         }
-        
-        allocated_blocks = success_count;
-        
-        if (success_count == new_blocks) {
-            consecutive_failed_allocations = 0; // 全部成功，重置失败计数
+    }
+    
+    // 每5个周期核实一次实际驻留量
+    if (++ctrl->residency_check_counter >= 5) {
+        ctrl->residency_check_counter = 0;
+        ballast_measure_resident(b);
+    }
+    
+    if (verbose_mode) {
+        printf("%s当前压载内存: 分配 %.1f MB (%zu 字节), 驻留 %.1f MB%s\n", label,
+               (double)b->size / mb, b->size, (double)b->resident / mb,
+               b->locked ? " (已锁定)" : "");
+    }
+}
+
+// 内存控制器单步: 根据采样快照调整压载区，now为快照所用的单调时钟(秒)
+// 指定--mem-node时按各节点的meminfo分别控制，否则按整个系统的MemAvailable控制
+void memory_controller_step(const proc_snapshot_t* snap, double now) {
+    const size_t mb = 1024 * 1024;
+    double current_mem_usage_percent = snap->mem_usage;
+    
+    // 目标曲线按控制步的频率插值
+    mem_profile_update(now, current_mem_usage_percent, snap->mem_total_kb);
+    
+    // 滤波值只用于显示，控制直接使用当前采样
+    if (filtered_mem_usage == 0.0) {
+        filtered_mem_usage = current_mem_usage_percent;
+    } else {
+        filtered_mem_usage = filter_alpha * current_mem_usage_percent +
+                             (1 - filter_alpha) * filtered_mem_usage;
+    }
+    
+    // 各节点的内存用量同时用于状态显示和指标导出，多节点时每步刷新
+    if (num_numa_nodes > 1 || num_node_mems > 0) {
+        numa_update_meminfo();
+    }
+    
+    if (num_node_mems > 0) {
+        unsigned long long target_sum = 0;
+        for (int i = 0; i < num_node_mems; i++) {
+            node_mem_t* nm = &node_mems[i];
+            int idx = find_numa_node(nm->node);
+            if (idx < 0) continue;
+            const numa_node_t* n = &numa_nodes[idx];
+            unsigned long long used_kb = n->mem_total_kb > n->mem_available_kb ?
+                                         n->mem_total_kb - n->mem_available_kb : 0;
+            char label[32];
+            snprintf(label, sizeof(label), "[节点%d] ", nm->node);
+            nm->target_bytes = mem_floor_clamp(mem_target_bytes(&nm->target, n->mem_total_kb), n->mem_total_kb, label);
+            target_sum += nm->target_bytes;
+            ballast_control_step(&nm->arena, &nm->ctrl, label, nm->target_bytes, used_kb * 1024,
+                                 n->mem_total_kb * 1024, snap, now);
+        }
+        target_mem_usage_mb = (int)(target_sum / mb);
+        return;
+    }
+    
+    unsigned long long target_bytes = mem_floor_clamp(mem_target_bytes(&mem_target, snap->mem_total_kb),
+                                                      snap->mem_total_kb, "");
+    target_mem_usage_mb = (int)(target_bytes / mb);
+    unsigned long long used_bytes = 0;
+    if (snap->mem_available_kb < snap->mem_total_kb) {
+        used_bytes = (snap->mem_total_kb - snap->mem_available_kb) * 1024;
+    }
+    if (verbose_mode) {
+        printf("内存使用率: 当前 %.1f%%, 滤波 %.1f%%\n", current_mem_usage_percent, filtered_mem_usage);
+    }
+    ballast_control_step(&ballast, &mem_ctrl, "", target_bytes, used_bytes,
+                         snap->mem_total_kb * 1024, snap, now);
+}
+
+// 内存分配函数
+void allocate_memory() {
+    // 获取当前系统内存使用情况(来自采样器快照)
+    proc_snapshot_t snap;
+    sampler_get(&snap);
+    mem_lock_acquire();
+    memory_controller_step(&snap, get_monotonic_time());
+    mem_lock_release();
+}
+
+// 压载区在一个PSI窗口内有过增长: 填充线程缺页时自己也会在回收中停顿，这段时间的some停顿可能完全来自CMM
+bool backoff_recent_grow(const ballast_t* b, double now) {
+    return b->grow_time > 0 && now - b->grow_time < BACKOFF_WINDOW_US / 1e6;
+}
+
+// 内存PSI触发: 立即释放每个压载区的一半，之后的增长上限逐渐恢复
+// 后台填充进行中或刚结束时的事件忽略，避免把自身填充造成的停顿当作外部压力
+void backoff_release_memory(backoff_t* b, double now) {
+    proc_snapshot_t snap;
+    sampler_get(&snap);
+    size_t freed = 0;
+    mem_lock_acquire();
+    bool filling = fill_pool_busy() || backoff_recent_grow(&ballast, now);
+    for (int i = 0; i < num_node_mems; i++) {
+        filling |= backoff_recent_grow(&node_mems[i].arena, now);
+    }
+    if (filling) {
+        mem_lock_release();
+        atomic_fetch_add_explicit(&b->mem_ignored, 1, memory_order_relaxed);
+        return;
+    }
+    freed += ballast_pressure_release(&ballast, 0.5, snap.self_rss_kb, now);
+    for (int i = 0; i < num_node_mems; i++) {
+        freed += ballast_pressure_release(&node_mems[i].arena, 0.5, snap.self_rss_kb, now);
+    }
+    mem_lock_release();
+    atomic_fetch_add_explicit(&b->mem_events, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&b->mem_released, freed, memory_order_relaxed);
+}
+
+// 内存看门狗: 独立于内存控制周期，高频检查可用内存余量、换页速率和内存PSI，
+// 余量低于硬下限或出现换页/内存停顿时直接大块释放压载，不等待主循环
+#define WATCHDOG_POLL_MS 10          // 检查可用内存余量的间隔
+#define WATCHDOG_RATE_WINDOW 0.1     // 换页速率和PSI停顿的统计窗口(秒)
+#define WATCHDOG_MIN_RELEASE 0.25    // 每次至少释放的压载比例
+#define WATCHDOG_HOLD 0.2            // 两次释放的最小间隔(秒)，等待上一次释放反映到计数中
+#define WATCHDOG_SWAP_PER_SEC 0.01   // 换入换出速率超过内存总量的该比例/秒时释放
+#define WATCHDOG_PSI_FULL 0.1        // 窗口内所有任务都停顿等待内存的时间比例超过该值时释放
+enum { WATCHDOG_FLOOR = 0, WATCHDOG_SWAP, WATCHDOG_PSI, WATCHDOG_SOURCES };
+const char* watchdog_source_names[WATCHDOG_SOURCES] = { "floor", "swap", "psi" };
+
+typedef struct {
+    bool started;
+    unsigned long long floor_bytes;      // 可用内存余量的下限(字节)
+    unsigned long long total_bytes;      // 启动时的内存总量(按cgroup计算时为cgroup的)
+    double last_release;                 // 最近一次释放的时刻
+    double window_start;                 // 当前速率统计窗口的起点
+    unsigned long long prev_swap_pages;  // 窗口起点的pswpin + pswpout
+    unsigned long long prev_psi_full;    // 窗口起点的内存PSI full total(微秒)
+    atomic_ullong headroom;              // 最近一次读取的可用内存余量(字节)
+    atomic_ullong min_headroom;          // 运行以来的最低余量(字节)
+    atomic_ullong events[WATCHDOG_SOURCES]; // 各来源触发的释放次数
+    atomic_ullong released;              // 累计释放的字节数
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    int meminfo_fd;                      // /proc/meminfo
+    int vmstat_fd;                       // /proc/vmstat，-1为不可用
+    int psi_fd;                          // 内存PSI文件(cgroup或系统)，-1为不可用
+    int cg_current_fd;                   // 按cgroup计算时的memory.current
+    int cg_stat_fd;                      // 按cgroup计算时的memory.stat
+    pthread_t thread;
+    char buf[16384];
+#endif
+} watchdog_t;
+
+watchdog_t watchdog = {0};
+
+// 当前的可用内存余量(字节): 主机MemAvailable，按cgroup计算时再与cgroup限制的余量取较小值
+unsigned long long watchdog_headroom(watchdog_t* w) {
+#ifdef _WIN32
+    (void)w;
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (!GlobalMemoryStatusEx(&status)) return ULLONG_MAX;
+    return (unsigned long long)status.ullAvailPhys;
+#else
+    unsigned long long headroom = ULLONG_MAX;
+    if (read_proc_fd(w->meminfo_fd, w->buf, sizeof(w->buf)) > 0) {
+        const char* p = strstr(w->buf, "MemAvailable:");
+        if (p) {
+            p += 13;
+            headroom = parse_ull(&p) * 1024;
+        }
+    }
+    if (w->cg_current_fd >= 0 && cgroup.memory_max > 0 && read_proc_fd(w->cg_current_fd, w->buf, sizeof(w->buf)) > 0) {
+        unsigned long long current = strtoull(w->buf, NULL, 10);
+        unsigned long long inactive_file = 0;
+        if (read_proc_fd(w->cg_stat_fd, w->buf, sizeof(w->buf)) > 0) {
+            const char* p = strstr(w->buf, "inactive_file ");
+            if (p) inactive_file = strtoull(p + 14, NULL, 10);
+        }
+        unsigned long long used = current > inactive_file ? current - inactive_file : 0;
+        unsigned long long cg_headroom = cgroup.memory_max > used ? cgroup.memory_max - used : 0;
+        if (cg_headroom < headroom) headroom = cg_headroom;
+    }
+    return headroom;
+#endif
+}
+
+#ifndef _WIN32
+// 读取累计换入换出页数(pswpin + pswpout)
+unsigned long long watchdog_swap_pages(watchdog_t* w) {
+    if (read_proc_fd(w->vmstat_fd, w->buf, sizeof(w->buf)) <= 0) return 0;
+    unsigned long long pages = 0;
+    const char* p = strstr(w->buf, "\npswpin ");
+    if (p) {
+        p += 8;
+        pages += parse_ull(&p);
+    }
+    p = strstr(w->buf, "\npswpout ");
+    if (p) {
+        p += 9;
+        pages += parse_ull(&p);
+    }
+    return pages;
+}
+
+// 读取内存PSI中full一行的累计停顿时间(微秒)
+unsigned long long watchdog_psi_full(watchdog_t* w) {
+    if (read_proc_fd(w->psi_fd, w->buf, sizeof(w->buf)) <= 0) return 0;
+    const char* p = strstr(w->buf, "full ");
+    if (!p) return 0;
+    p = strstr(p, "total=");
+    if (!p) return 0;
+    p += 6;
+    return parse_ull(&p);
+}
+#endif
+
+// 释放每个压载区fraction比例的压载，之后的增长上限与内存压力释放一样逐渐恢复
+void watchdog_release(watchdog_t* w, int source, double fraction, double now) {
+    proc_snapshot_t snap;
+    sampler_get(&snap);
+    size_t freed = 0;
+    mem_lock_acquire();
+    freed += ballast_pressure_release(&ballast, fraction, snap.self_rss_kb, now);
+    for (int i = 0; i < num_node_mems; i++) {
+        freed += ballast_pressure_release(&node_mems[i].arena, fraction, snap.self_rss_kb, now);
+    }
+    mem_lock_release();
+    w->last_release = now;
+    atomic_fetch_add_explicit(&w->events[source], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&w->released, freed, memory_order_relaxed);
+}
+
+// 当前所有压载区的总大小(字节)，主循环和退让线程同时在修改，读取时持有mem_lock
+size_t watchdog_ballast_size() {
+    mem_lock_acquire();
+    size_t size = ballast.size;
+    for (int i = 0; i < num_node_mems; i++) {
+        size += node_mems[i].arena.size;
+    }
+    mem_lock_release();
+    return size;
+}
+
+// 一次检查: 余量低于下限时按缺口的两倍(至少四分之一)释放，换页和PSI停顿按统计窗口判断
+void watchdog_check(watchdog_t* w, double now) {
+    unsigned long long headroom = watchdog_headroom(w);
+    if (headroom == ULLONG_MAX) return;
+    atomic_store_explicit(&w->headroom, headroom, memory_order_relaxed);
+    if (headroom < atomic_load_explicit(&w->min_headroom, memory_order_relaxed)) {
+        atomic_store_explicit(&w->min_headroom, headroom, memory_order_relaxed);
+    }
+    
+    size_t size = watchdog_ballast_size();
+    bool hold = now - w->last_release < WATCHDOG_HOLD;
+    if (size > 0 && !hold && headroom < w->floor_bytes) {
+        double fraction = 2.0 * (double)(w->floor_bytes - headroom) / (double)size;
+        if (fraction < WATCHDOG_MIN_RELEASE) fraction = WATCHDOG_MIN_RELEASE;
+        watchdog_release(w, WATCHDOG_FLOOR, fraction, now);
+        return;
+    }
+    
+#ifndef _WIN32
+    double elapsed = now - w->window_start;
+    if (elapsed < WATCHDOG_RATE_WINDOW) return;
+    unsigned long long swap_pages = w->vmstat_fd >= 0 ? watchdog_swap_pages(w) : 0;
+    unsigned long long psi_full = w->psi_fd >= 0 ? watchdog_psi_full(w) : 0;
+    double swap_rate = swap_pages > w->prev_swap_pages ?
+                       (double)(swap_pages - w->prev_swap_pages) * sysconf(_SC_PAGESIZE) / elapsed : 0.0;
+    double psi_ratio = psi_full > w->prev_psi_full ? (double)(psi_full - w->prev_psi_full) / (elapsed * 1e6) : 0.0;
+    w->prev_swap_pages = swap_pages;
+    w->prev_psi_full = psi_full;
+    w->window_start = now;
+    if (size == 0 || hold) return;
+    if (swap_rate > WATCHDOG_SWAP_PER_SEC * (double)w->total_bytes) {
+        watchdog_release(w, WATCHDOG_SWAP, WATCHDOG_MIN_RELEASE, now);
+    } else if (psi_ratio > WATCHDOG_PSI_FULL) {
+        watchdog_release(w, WATCHDOG_PSI, WATCHDOG_MIN_RELEASE, now);
+    }
+#endif
+}
+
+// 看门狗线程
+#ifdef _WIN32
+DWORD WINAPI watchdog_thread(LPVOID arg) {
+#else
+void* watchdog_thread(void* arg) {
+#endif
+    watchdog_t* w = (watchdog_t*)arg;
+    while (running) {
+        watchdog_check(w, get_monotonic_time());
+#ifdef _WIN32
+        Sleep(WATCHDOG_POLL_MS);
+#else
+        usleep(WATCHDOG_POLL_MS * 1000);
+#endif
+    }
+    return 0;
+}
+
+#ifndef _WIN32
+// 关闭看门狗使用的文件
+void watchdog_close(watchdog_t* w) {
+    if (w->meminfo_fd >= 0) close(w->meminfo_fd);
+    if (w->vmstat_fd >= 0) close(w->vmstat_fd);
+    if (w->psi_fd >= 0) close(w->psi_fd);
+    if (w->cg_current_fd >= 0) close(w->cg_current_fd);
+    if (w->cg_stat_fd >= 0) close(w->cg_stat_fd);
+    w->meminfo_fd = w->vmstat_fd = w->psi_fd = w->cg_current_fd = w->cg_stat_fd = -1;
+}
+#endif
+
+// 是否设置了内存目标(包括目标曲线和按节点的目标)，只有CPU负载时不需要看门狗和OOM优先级调整
+bool memory_target_enabled() {
+    return mem_profile.kind != PROFILE_NONE || num_node_mems > 0 ||
+           mem_target.kind == MEM_TARGET_FREE || mem_target.value > 0;
+}
+
+// 启动内存看门狗，下限为0、没有内存目标或压载区只记账时不启动
+void watchdog_start() {
+    if (mem_floor.value <= 0 || !memory_target_enabled() || ballast.simulated) return;
+    watchdog_t* w = &watchdog;
+    proc_snapshot_t snap;
+    sampler_get(&snap);
+    w->total_bytes = snap.mem_total_kb * 1024;
+    w->floor_bytes = mem_target_bytes(&mem_floor, snap.mem_total_kb);
+    w->window_start = get_monotonic_time();
+    w->last_release = -WATCHDOG_HOLD;
+    atomic_store_explicit(&w->headroom, ULLONG_MAX, memory_order_relaxed);
+    atomic_store_explicit(&w->min_headroom, ULLONG_MAX, memory_order_relaxed);
+    
+#ifdef _WIN32
+    w->thread = CreateThread(NULL, 0, watchdog_thread, w, 0, NULL);
+    w->started = w->thread != NULL;
+#else
+    w->meminfo_fd = open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+    w->vmstat_fd = open("/proc/vmstat", O_RDONLY | O_CLOEXEC);
+    char path[600] = "/proc/pressure/memory";
+    if (cgroup.active) snprintf(path, sizeof(path), "%s/memory.pressure", cgroup.path);
+    w->psi_fd = open(path, O_RDONLY | O_CLOEXEC);
+    w->cg_current_fd = w->cg_stat_fd = -1;
+    if (cgroup.active) {
+        char file[600];
+        snprintf(file, sizeof(file), "%s/memory.current", cgroup.path);
+        w->cg_current_fd = open(file, O_RDONLY | O_CLOEXEC);
+        snprintf(file, sizeof(file), "%s/memory.stat", cgroup.path);
+        w->cg_stat_fd = open(file, O_RDONLY | O_CLOEXEC);
+    }
+    if (w->meminfo_fd < 0) {
+        printf("打开/proc/meminfo失败，不启用内存看门狗\n");
+        watchdog_close(w);
+        return;
+    }
+    if (w->vmstat_fd >= 0) w->prev_swap_pages = watchdog_swap_pages(w);
+    if (w->psi_fd >= 0) w->prev_psi_full = watchdog_psi_full(w);
+    w->started = pthread_create(&w->thread, NULL, watchdog_thread, w) == 0;
+    if (!w->started) watchdog_close(w);
+#endif
+    if (!w->started) {
+        printf("创建内存看门狗线程失败\n");
+        return;
+    }
+    printf("内存看门狗: 可用内存下限 %.1f MB，每%dms检查一次\n", w->floor_bytes / (1024.0 * 1024.0), WATCHDOG_POLL_MS);
+}
+
+// 停止内存看门狗，调用前running已为0
+void watchdog_stop() {
+    if (!watchdog.started) return;
+#ifdef _WIN32
+    WaitForSingleObject(watchdog.thread, INFINITE);
+    CloseHandle(watchdog.thread);
+#else
+    pthread_join(watchdog.thread, NULL);
+    watchdog_close(&watchdog);
+#endif
+    watchdog.started = false;
+}
+
+// 把oom_score_adj设为最大值，内存耗尽时OOM killer首先选中CMM，而不是系统上的其他进程
+void oom_harden() {
+#ifndef _WIN32
+    int fd = open("/proc/self/oom_score_adj", O_WRONLY | O_CLOEXEC);
+    if (fd < 0 || write(fd, "1000", 4) != 4) {
+        printf("设置oom_score_adj失败: %s\n", strerror(errno));
+    }
+    if (fd >= 0) close(fd);
+#endif
+}
+
+// 预分配的文本缓冲区，指标导出和状态画面共用，格式化时不再分配内存
+typedef struct {
+    char* buf;
+    size_t cap;
+    size_t len;
+} text_buf_t;
+
+// 分配缓冲区
+bool text_buf_init(text_buf_t* t, size_t cap) {
+    t->buf = (char*)malloc(cap);
+    t->cap = t->buf ? cap : 0;
+    t->len = 0;
+    return t->buf != NULL;
+}
+
+// 释放缓冲区
+void text_buf_free(text_buf_t* t) {
+    free(t->buf);
+    t->buf = NULL;
+    t->cap = 0;
+    t->len = 0;
+}
+
+// 追加一段文本，缓冲区满时截断
+void text_append(text_buf_t* t, const char* data, size_t len) {
+    if (t->len + 1 >= t->cap) return;
+    size_t room = t->cap - t->len - 1;
+    if (len > room) len = room;
+    memcpy(t->buf + t->len, data, len);
+    t->len += len;
+    t->buf[t->len] = '\0';
+}
+
+// 追加格式化文本，缓冲区满时截断
+void text_printf(text_buf_t* t, const char* fmt, ...) {
+    if (t->len + 1 >= t->cap) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(t->buf + t->len, t->cap - t->len, fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    size_t room = t->cap - t->len - 1;
+    t->len += (size_t)n < room ? (size_t)n : room;
+}
+
+// Prometheus指标导出: 在回环地址上提供最小的HTTP服务，只响应 GET /metrics
+// 导出线程读取采样快照和CPU调整线程发布的控制状态副本，只在复制内存控制状态时短暂持有内存控制锁
+#ifdef _WIN32
+typedef SOCKET socket_t;
+#define close_socket closesocket
+#define SEND_FLAGS 0
+#else
+typedef int socket_t;
+#define INVALID_SOCKET (-1)
+#define close_socket close
+#define SEND_FLAGS MSG_NOSIGNAL
+#endif
+
+typedef struct {
+    text_buf_t out;    // 启动时按核心数一次分配，抓取时不再分配内存
+    double* core_stats; // 各核心控制状态的副本(num_cpu_cores * CORE_STATS)，同样启动时分配
+    socket_t listen_fd;
+    unsigned long long scrapes;
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+    bool started;
+} metrics_exporter_t;
+
+metrics_exporter_t metrics_exporter = { .listen_fd = INVALID_SOCKET };
+
+// 输出指标的HELP和TYPE行
+void metrics_header(metrics_exporter_t* m, const char* name, const char* type, const char* help) {
+    text_printf(&m->out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// 输出一个无标签的指标
+void metrics_value(metrics_exporter_t* m, const char* name, const char* type, const char* help, double value) {
+    metrics_header(m, name, type, help);
+    text_printf(&m->out, "%s %.17g\n", name, value);
+}
+
+// 导出的桶上界固定为 2^(i+1) ns，i从METRICS_HIST_FIRST到METRICS_HIST_LAST(约1微秒到17秒)，
+// 每次抓取的桶集合相同；更小的值计入第一个桶，更大的值只计入+Inf
+#define METRICS_HIST_FIRST 9
+#define METRICS_HIST_LAST 33
+
+// 输出对数分桶直方图，桶上界换算为秒
+void metrics_histogram(metrics_exporter_t* m, const char* name, const char* help, const latency_hist_t* hist) {
+    metrics_header(m, name, "histogram", help);
+    unsigned long long cumulative = 0;
+    for (int i = 0; i <= METRICS_HIST_LAST; i++) {
+        cumulative += hist->buckets[i];
+        if (i < METRICS_HIST_FIRST) continue;
+        text_printf(&m->out, "%s_bucket{le=\"%.9g\"} %llu\n", name, (double)(2ULL << i) / 1e9, cumulative);
+    }
+    text_printf(&m->out, "%s_bucket{le=\"+Inf\"} %llu\n", name, hist->count);
+    text_printf(&m->out, "%s_sum %.9f\n", name, hist->sum / 1e9);
+    text_printf(&m->out, "%s_count %llu\n", name, hist->count);
+}
+
+// 生成全部指标文本
+void metrics_render(metrics_exporter_t* m) {
+    proc_snapshot_t snap;
+    sampler_get(&snap);
+    m->out.len = 0;
+    
+    // CPU控制状态读取CPU调整线程发布的副本，内存控制状态在内存控制锁内复制
+    double cpu_filtered, cpu_target;
+    core_stats_read(m->core_stats, &cpu_filtered, &cpu_target);
+    mem_lock_acquire();
+    double mem_filtered = filtered_mem_usage;
+    double mem_target = target_mem_usage_mb;
+    double mem_deficit = (double)mem_ctrl.deficit;
+    double alloc_failures = (double)mem_ctrl.failed_allocations_total;
+    double ballast_size = (double)ballast.size;
+    double ballast_resident = (double)ballast.resident;
+    double ballast_reserved = (double)ballast.reserved;
+    mem_lock_release();
+    
+    // 系统和自身
+    metrics_value(m, "cmm_system_cpu_usage_percent", "gauge", "系统整体CPU使用率", snap.cpu_usage);
+    metrics_value(m, "cmm_self_cpu_usage_percent", "gauge", "CMM自身CPU使用率(占全部核心)", snap.self_cpu_usage);
+    metrics_value(m, "cmm_cpu_filtered_percent", "gauge", "滤波后的系统CPU使用率", cpu_filtered);
+    metrics_value(m, "cmm_cpu_target_percent", "gauge", "总体CPU目标", cpu_target);
+    metrics_value(m, "cmm_memory_usage_percent", "gauge", "系统内存使用率(与free对齐)", snap.mem_usage);
+    metrics_value(m, "cmm_memory_filtered_percent", "gauge", "滤波后的内存使用率", mem_filtered);
+    metrics_value(m, "cmm_memory_target_percent", "gauge", "内存目标",
+                  snap.mem_total_kb ? mem_target * 1024.0 * 100.0 / snap.mem_total_kb : 0.0);
+    metrics_value(m, "cmm_memory_target_bytes", "gauge", "内存目标(系统已用字节数)", mem_target * 1048576.0);
+    metrics_value(m, "cmm_memory_deficit_bytes", "gauge", "内存控制缺口(目标已用 - 实际已用)", mem_deficit);
+    metrics_value(m, "cmm_memory_total_bytes", "gauge", "系统内存总量", snap.mem_total_kb * 1024.0);
+    metrics_value(m, "cmm_memory_available_bytes", "gauge", "系统可用内存", snap.mem_available_kb * 1024.0);
+    metrics_value(m, "cmm_self_rss_bytes", "gauge", "CMM自身常驻内存", snap.self_rss_kb * 1024.0);
+    metrics_value(m, "cmm_sampler_samples_total", "counter", "采样次数", (double)snap.seq);
+    
+    // 每个核心的控制状态
+    static const struct {
+        const char* name;
+        const char* help;
+        int stat;
+    } core_metrics[] = {
+        { "cmm_core_usage_percent", "核心使用率", CORE_STAT_USAGE },
+        { "cmm_core_filtered_percent", "滤波后的核心使用率", CORE_STAT_FILTERED },
+        { "cmm_core_external_percent", "外部负载估计", CORE_STAT_EXTERNAL },
+        { "cmm_core_setpoint_percent", "重新分配后的核心设定值", CORE_STAT_SETPOINT },
+        { "cmm_worker_duty_percent", "下发给工作线程的繁忙比例", CORE_STAT_BUSY },
+        { "cmm_worker_cpu_percent", "工作线程实际消耗的CPU", CORE_STAT_OWN },
+        { "cmm_pid_feed_forward_percent", "前馈项: 设定值减外部负载", CORE_STAT_FEED_FORWARD },
+        { "cmm_pid_integral_percent", "PID积分项", CORE_STAT_INTEGRAL },
+        { "cmm_pid_trim_percent", "PID比例和微分修正", CORE_STAT_TRIM },
+        { "cmm_pid_error_percent", "PID误差(设定值减滤波使用率)", CORE_STAT_ERROR },
+    };
+    for (size_t k = 0; k < sizeof(core_metrics) / sizeof(core_metrics[0]); k++) {
+        metrics_header(m, core_metrics[k].name, "gauge", core_metrics[k].help);
+        for (int i = 0; i < num_cpu_cores; i++) {
+            text_printf(&m->out, "%s{cpu=\"%d\"} %.6g\n", core_metrics[k].name, core_ctrls[i].cpu_id,
+                        m->core_stats[i * CORE_STATS + core_metrics[k].stat]);
+        }
+    }
+    metrics_header(m, "cmm_worker_cpu_seconds_total", "counter", "工作线程累计CPU时间");
+    for (int i = 0; i < num_cpu_cores; i++) {
+        unsigned long long cpu_ns = atomic_load_explicit(&workers[i].cpu_ns, memory_order_relaxed);
+        text_printf(&m->out, "cmm_worker_cpu_seconds_total{cpu=\"%d\"} %.9f\n", core_ctrls[i].cpu_id, cpu_ns / 1e9);
+    }
+    
+    // 内存压载
+    metrics_value(m, "cmm_ballast_allocated_bytes", "gauge", "压载区已分配字节", ballast_size);
+    metrics_value(m, "cmm_ballast_resident_bytes", "gauge", "压载区最近一次核实的驻留字节", ballast_resident);
+    metrics_value(m, "cmm_ballast_reserved_bytes", "gauge", "压载区预留的地址空间", ballast_reserved);
+    metrics_value(m, "cmm_ballast_alloc_failures_total", "counter", "压载增长未能全部完成的次数", alloc_failures);
+    
+    // NUMA节点
+    if (num_numa_nodes > 1 || num_node_mems > 0) {
+        metrics_header(m, "cmm_numa_memory_total_bytes", "gauge", "NUMA节点内存总量");
+        for (int i = 0; i < num_numa_nodes; i++) {
+            text_printf(&m->out, "cmm_numa_memory_total_bytes{node=\"%d\"} %.17g\n",
+                        numa_nodes[i].id, numa_nodes[i].mem_total_kb * 1024.0);
+        }
+        metrics_header(m, "cmm_numa_memory_available_bytes", "gauge", "NUMA节点可用内存(估算)");
+        for (int i = 0; i < num_numa_nodes; i++) {
+            text_printf(&m->out, "cmm_numa_memory_available_bytes{node=\"%d\"} %.17g\n",
+                        numa_nodes[i].id, numa_nodes[i].mem_available_kb * 1024.0);
+        }
+    }
+    if (num_node_mems > 0) {
+        // 节点目标和节点压载区同样由内存控制锁保护，格式化只写缓冲区，持锁时间很短
+        mem_lock_acquire();
+        metrics_header(m, "cmm_numa_memory_target_bytes", "gauge", "NUMA节点内存目标(已用字节数)");
+        for (int i = 0; i < num_node_mems; i++) {
+            text_printf(&m->out, "cmm_numa_memory_target_bytes{node=\"%d\"} %.17g\n",
+                        node_mems[i].node, (double)node_mems[i].target_bytes);
         }
+        metrics_header(m, "cmm_numa_ballast_allocated_bytes", "gauge", "绑定到NUMA节点的压载区已分配字节");
+        for (int i = 0; i < num_node_mems; i++) {
+            text_printf(&m->out, "cmm_numa_ballast_allocated_bytes{node=\"%d\"} %.17g\n",
+                        node_mems[i].node, (double)node_mems[i].arena.size);
+        }
+        mem_lock_release();
+    }
+    
+    // cgroup
+    if (cgroup.detected) {
+        metrics_value(m, "cmm_cgroup_cpu_limit_cores", "gauge", "cgroup的CPU限制(核心数)，0为不限制", cgroup.cpu_limit);
+        metrics_value(m, "cmm_cgroup_memory_max_bytes", "gauge", "cgroup的memory.max，0为不限制", (double)cgroup.memory_max);
+        metrics_value(m, "cmm_cgroup_memory_current_bytes", "gauge", "cgroup的memory.current", (double)snap.cg_memory_current);
+        metrics_value(m, "cmm_cgroup_cpu_periods_total", "counter", "cgroup的CPU配额周期数", (double)snap.cg_nr_periods);
+        metrics_value(m, "cmm_cgroup_cpu_throttled_periods_total", "counter", "cgroup被限流的周期数", (double)snap.cg_nr_throttled);
+        metrics_value(m, "cmm_cgroup_cpu_throttled_seconds_total", "counter", "cgroup被限流的累计时间", snap.cg_throttled_usec / 1e6);
+    }
+    
+    // 控制循环耗时(采样+一步CPU控制)
+    latency_hist_t hist;
+    worker_hist_copy(&control_loop_hist, &hist);
+    metrics_histogram(m, "cmm_control_loop_duration_seconds", "CPU控制循环单次耗时", &hist);
+    
+    // 工作线程每个周期的偏差，所有工作线程汇总
+    worker_hists_collect(offsetof(worker_t, wake_hist), &hist);
+    metrics_histogram(m, "cmm_worker_wakeup_overshoot_seconds", "工作线程唤醒晚于网格点的时间", &hist);
+    worker_hists_collect(offsetof(worker_t, late_hist), &hist);
+    metrics_histogram(m, "cmm_worker_cycle_lateness_seconds", "忙等结束晚于理想完成时刻的时间", &hist);
+    worker_hists_collect(offsetof(worker_t, short_hist), &hist);
+    metrics_histogram(m, "cmm_worker_cpu_shortfall_seconds", "周期内实际CPU时间少于指令的差额", &hist);
+    worker_hists_collect(offsetof(worker_t, over_hist), &hist);
+    metrics_histogram(m, "cmm_worker_cpu_excess_seconds", "周期内实际CPU时间多于指令的差额", &hist);
+    
+    // 唤醒延迟探针
+    if (wake_probe.started) {
+        latency_hist_t clear;
+        worker_hist_copy(&wake_probe.clear, &clear);
+        worker_hist_copy(&wake_probe.overlap, &hist);
+        metrics_histogram(m, "cmm_probe_wakeup_clear_seconds", "工作线程不在忙等时探针的唤醒延迟", &clear);
+        metrics_histogram(m, "cmm_probe_wakeup_overlap_seconds", "撞上工作线程忙等时探针的唤醒延迟", &hist);
+        metrics_value(m, "cmm_probe_added_latency_seconds", "gauge", "工作线程给每次唤醒平均增加的调度延迟",
+                      wake_probe_added_ns(&clear, &hist) / 1e9);
+    }
+    // 压力退让
+    if (backoff.started && backoff_stall_ms > 0) {
+        metrics_header(m, "cmm_backoff_events_total", "counter", "CPU压力退让次数");
+        text_printf(&m->out, "cmm_backoff_events_total{source=\"psi\"} %llu\n",
+                    (unsigned long long)atomic_load_explicit(&backoff.psi_events, memory_order_relaxed));
+        text_printf(&m->out, "cmm_backoff_events_total{source=\"rundelay\"} %llu\n",
+                    (unsigned long long)atomic_load_explicit(&backoff.rundelay_events, memory_order_relaxed));
+        metrics_value(m, "cmm_backoff_psi_ignored_total", "counter", "等待主要来自CMM自身而忽略的PSI事件",
+                      (double)atomic_load_explicit(&backoff.psi_ignored, memory_order_relaxed));
+        metrics_header(m, "cmm_backoff_share", "gauge", "压力退让后保留的占空比比例");
+        for (int i = 0; i < num_cpu_cores; i++) {
+            text_printf(&m->out, "cmm_backoff_share{cpu=\"%d\"} %.6g\n", core_ctrls[i].cpu_id,
+                        atomic_load_explicit(&workers[i].backoff_share, memory_order_relaxed));
+        }
+    }
+    if (backoff.started && backoff.mem_psi_fd >= 0) {
+        metrics_value(m, "cmm_mem_backoff_events_total", "counter", "内存PSI触发的压载释放次数",
+                      (double)atomic_load_explicit(&backoff.mem_events, memory_order_relaxed));
+        metrics_value(m, "cmm_mem_backoff_released_bytes_total", "counter", "内存PSI触发释放的压载字节数",
+                      (double)atomic_load_explicit(&backoff.mem_released, memory_order_relaxed));
+        metrics_value(m, "cmm_mem_backoff_ignored_total", "counter", "填充期间或刚填充完而忽略的内存PSI事件",
+                      (double)atomic_load_explicit(&backoff.mem_ignored, memory_order_relaxed));
+    }
+    if (watchdog.started) {
+        metrics_header(m, "cmm_watchdog_events_total", "counter", "内存看门狗释放压载的次数");
+        for (int i = 0; i < WATCHDOG_SOURCES; i++) {
+            text_printf(&m->out, "cmm_watchdog_events_total{source=\"%s\"} %llu\n", watchdog_source_names[i],
+                        (unsigned long long)atomic_load_explicit(&watchdog.events[i], memory_order_relaxed));
+        }
+        metrics_value(m, "cmm_watchdog_released_bytes_total", "counter", "内存看门狗累计释放的压载字节数",
+                      (double)atomic_load_explicit(&watchdog.released, memory_order_relaxed));
+        metrics_value(m, "cmm_watchdog_floor_bytes", "gauge", "可用内存余量的硬下限",
+                      (double)watchdog.floor_bytes);
+        unsigned long long headroom = atomic_load_explicit(&watchdog.headroom, memory_order_relaxed);
+        if (headroom != ULLONG_MAX) {
+            metrics_value(m, "cmm_watchdog_headroom_bytes", "gauge", "看门狗最近一次读取的可用内存余量",
+                          (double)headroom);
+        }
+    }
+    metrics_value(m, "cmm_worker_sched_failures", "gauge", "调度策略设置失败的工作线程数",
+                  (double)atomic_load_explicit(&worker_sched_failures, memory_order_relaxed));
+    
+    metrics_value(m, "cmm_metrics_scrapes_total", "counter", "指标抓取次数", (double)++m->scrapes);
+}
+
+// 发送全部数据
+bool metrics_send_all(socket_t fd, const char* data, size_t len) {
+    while (len > 0) {
+        int n = send(fd, data, (int)len, SEND_FLAGS);
+        if (n <= 0) return false;
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// 处理一个连接: 读取请求行，返回指标或404后关闭
+void metrics_serve_client(metrics_exporter_t* m, socket_t client) {
+    // 限制读取和发送时间，避免慢客户端或停止读取的抓取方占住导出线程
+#ifdef _WIN32
+    DWORD timeout = 1000;
+#else
+    struct timeval timeout = { 1, 0 };
+#endif
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+    
+    char request[1024];
+    int n = recv(client, request, sizeof(request) - 1, 0);
+    if (n <= 0) {
+        close_socket(client);
+        return;
+    }
+    request[n] = '\0';
+    
+    const char* status = "200 OK";
+    const char* body = m->out.buf;
+    size_t body_len;
+    if (strncmp(request, "GET /metrics", 12) == 0 && (request[12] == ' ' || request[12] == '?')) {
+        metrics_render(m);
+        body_len = m->out.len;
+    } else {
+        status = "404 Not Found";
+        body = "not found, try /metrics\n";
+        body_len = strlen(body);
+    }
+    
+    char header[256];
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 %s\r\n"
+                              "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                              "Content-Length: %zu\r\n"
+                              "Connection: close\r\n\r\n", status, body_len);
+    if (metrics_send_all(client, header, (size_t)header_len)) {
+        metrics_send_all(client, body, body_len);
+    }
+    close_socket(client);
+}
+
+// 导出线程: 每500ms检查一次退出标志
+#ifdef _WIN32
+DWORD WINAPI metrics_thread(LPVOID arg) {
+#else
+void* metrics_thread(void* arg) {
+#endif
+    metrics_exporter_t* m = (metrics_exporter_t*)arg;
+    while (running) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(m->listen_fd, &readable);
+        struct timeval timeout = { 0, 500 * 1000 };
+        if (select((int)m->listen_fd + 1, &readable, NULL, NULL, &timeout) <= 0) continue;
         
-        // 如果部分块分配失败，调整内存块数组大小
-        if (success_count < new_blocks) {
-            if (verbose_mode) {
-                printf("警告：请求分配 %d 个块，但只成功分配了 %d 个\n", new_blocks, success_count);
-            }
-            if (success_count > 0) {
-                char** resize_blocks = (char**)realloc(memory_blocks, success_count * sizeof(char*));
-                if (resize_blocks) {
-                    memory_blocks = resize_blocks;
-                }
-            } else {
-                free(memory_blocks);
-                memory_blocks = NULL;
-                allocated_blocks = 0;
-            }
+        socket_t client = accept(m->listen_fd, NULL, NULL);
+        if (client == INVALID_SOCKET) continue;
+        metrics_serve_client(m, client);
+    }
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+// 启动指标导出，port为0时不启用
+bool metrics_start(int port, const char* addr) {
+    metrics_exporter_t* m = &metrics_exporter;
+    if (port <= 0) return true;
+    
+    // 固定部分约20 KB(主要是直方图)，每个核心约1 KB
+    m->core_stats = (double*)calloc((size_t)num_cpu_cores * CORE_STATS, sizeof(double));
+    if (!m->core_stats || !text_buf_init(&m->out, 32768 + (size_t)num_cpu_cores * 1024)) {
+        printf("内存分配失败\n");
+        return false;
+    }
+    
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        printf("初始化Winsock失败\n");
+        return false;
+    }
+#endif
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons((unsigned short)port);
+    if (inet_pton(AF_INET, addr, &sa.sin_addr) != 1) {
+        printf("无效的指标导出地址: %s\n", addr);
+        return false;
+    }
+    
+    m->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (m->listen_fd == INVALID_SOCKET) {
+        printf("创建指标导出套接字失败\n");
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(m->listen_fd, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+    if (bind(m->listen_fd, (struct sockaddr*)&sa, sizeof(sa)) != 0 || listen(m->listen_fd, 8) != 0) {
+        printf("指标导出无法监听 %s:%d\n", addr, port);
+        close_socket(m->listen_fd);
+        m->listen_fd = INVALID_SOCKET;
+        return false;
+    }
+    
+#ifdef _WIN32
+    m->thread = CreateThread(NULL, 0, metrics_thread, m, 0, NULL);
+    m->started = m->thread != NULL;
+#else
+    m->started = pthread_create(&m->thread, NULL, metrics_thread, m) == 0;
+#endif
+    if (!m->started) {
+        printf("创建指标导出线程失败\n");
+        close_socket(m->listen_fd);
+        m->listen_fd = INVALID_SOCKET;
+        return false;
+    }
+    printf("指标导出: http://%s:%d/metrics\n", addr, port);
+    return true;
+}
+
+// 停止指标导出，调用前running已置为0
+void metrics_stop() {
+    metrics_exporter_t* m = &metrics_exporter;
+    if (m->started) {
+#ifdef _WIN32
+        WaitForSingleObject(m->thread, INFINITE);
+        CloseHandle(m->thread);
+#else
+        pthread_join(m->thread, NULL);
+#endif
+        m->started = false;
+    }
+    if (m->listen_fd != INVALID_SOCKET) {
+        close_socket(m->listen_fd);
+        m->listen_fd = INVALID_SOCKET;
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+    text_buf_free(&m->out);
+    free(m->core_stats);
+    m->core_stats = NULL;
+}
+
+// 格式化直方图的p50/p99/最大值(微秒)
+void format_hist_us(char* buf, size_t size, const latency_hist_t* hist) {
+    snprintf(buf, size, "%.1f/%.1f/%.1f",
+             hist_percentile(hist, 50) / 1000.0, hist_percentile(hist, 99) / 1000.0, hist->max / 1000.0);
+}
+
+// 追加一个进度条，colors为false时不输出颜色转义序列
+void status_bar(text_buf_t* t, double percentage, int bar_width, bool colors) {
+    int filled_width = (int)(percentage * bar_width / 100.0);
+    if (filled_width > bar_width) filled_width = bar_width;
+    if (filled_width < 0) filled_width = 0;
+    
+    // 根据百分比选择颜色: 绿色/黄色/红色
+    int color_code = percentage < 30.0 ? 32 : (percentage < 70.0 ? 33 : 31);
+    
+    text_append(t, "[", 1);
+    if (filled_width > 0) {
+        if (colors) text_printf(t, "\033[%dm", color_code);
+        for (int i = 0; i < filled_width; i++) {
+            text_append(t, "█", sizeof("█") - 1);
         }
+        if (colors) text_append(t, "\033[0m", 4);
+    }
+    for (int i = 0; i < bar_width - filled_width; i++) {
+        text_append(t, "░", sizeof("░") - 1);
     }
+    text_printf(t, "] %5.1f%%", percentage);
     
-    if (verbose_mode) {
-        printf("当前已分配内存: %llu MB (%d 个块，每块 %d MB)\n", 
-               allocated_mb, allocated_blocks, block_size_mb);
+    // 如果百分比超过阈值，添加标记
+    if (percentage > 90.0) {
+        text_append(t, " (!!)", 5);
+    } else if (percentage > 75.0) {
+        text_append(t, " (!)", 4);
     }
 }
 
-// 生成进度条字符串
-void generate_progress_bar(char* buffer, size_t buffer_size, double percentage, int bar_width) {
-    if (buffer == NULL || buffer_size < bar_width + 20) return;
-    
-    int filled_width = (int)(percentage * bar_width / 100.0);
-    if (filled_width > bar_width) filled_width = bar_width;
+// 状态画面渲染器: 整帧格式化到预分配的缓冲区，与上一帧逐行比较，
+// 只把变化的行用光标定位重写，整帧输出只调用一次write
+typedef struct {
+    text_buf_t frame;          // 本帧内容
+    text_buf_t prev;           // 上一帧内容
+    text_buf_t out;            // 本帧实际输出(转义序列和变化的行)
+    int prev_lines;
+    int frames_since_full;     // 距离上次完整重绘的帧数
+    int full_every;            // 每隔多少帧完整重绘一次，清除其他输出造成的错位
+    bool vt;                   // 终端支持光标定位和颜色；否则每帧完整输出(重定向到文件时)
+    bool drawn;
+    int rows;                  // 上一帧时的终端窗口大小，变化时完整重绘
+    int cols;
+    double* core_stats;        // 各核心控制状态的副本(num_cpu_cores * CORE_STATS)
+} status_renderer_t;
+
+status_renderer_t status_renderer = {0};
+double refresh_hz = 1.0; // 状态画面刷新频率
+
+// 初始化渲染器，缓冲区按核心数一次分配
+bool status_renderer_init(status_renderer_t* r) {
+    size_t cap = 8192 + (size_t)num_cpu_cores * 256;
+    r->core_stats = (double*)calloc((size_t)num_cpu_cores * CORE_STATS, sizeof(double));
+    if (!r->core_stats || !text_buf_init(&r->frame, cap) || !text_buf_init(&r->prev, cap) ||
+        !text_buf_init(&r->out, cap * 2)) {
+        return false;
+    }
+    // 大约每5秒完整重绘一次
+    r->full_every = (int)(refresh_hz * 5.0);
+    if (r->full_every < 1) r->full_every = 1;
+#ifdef _WIN32
+    // 开启虚拟终端处理后才支持ANSI转义序列
+    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode = 0;
+    r->vt = GetConsoleMode(console, &mode) &&
+            SetConsoleMode(console, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+#else
+    r->vt = isatty(STDOUT_FILENO);
+#endif
+    return true;
+}
+
+// 释放渲染器
+void status_renderer_free(status_renderer_t* r) {
+    text_buf_free(&r->frame);
+    text_buf_free(&r->prev);
+    text_buf_free(&r->out);
+    free(r->core_stats);
+    r->core_stats = NULL;
+}
+
+// 把整段数据写到标准输出
+void write_stdout(const char* data, size_t len) {
+#ifdef _WIN32
+    DWORD written = 0;
+    WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), data, (DWORD)len, &written, NULL);
+#else
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        data += n;
+        len -= (size_t)n;
+    }
+#endif
+}
+
+// 格式化一帧状态画面，所有数据来自同一个采样快照
+void render_status_frame(text_buf_t* f, double* core_stats, bool colors) {
+    proc_snapshot_t snap;
+    sampler_get(&snap);
+    
+    // 内存控制状态在内存控制锁内复制(压力释放线程会同时修改)，之后只按副本格式化
+    size_t node_ballast[MAX_NUMA_NODES];
+    unsigned long long node_target[MAX_NUMA_NODES];
+    mem_lock_acquire();
+    double mem_filtered = filtered_mem_usage;
+    int target_mem_mb = target_mem_usage_mb;
+    size_t pressure_cap = ballast.pressure_cap;
+    for (int k = 0; k < num_node_mems; k++) {
+        node_ballast[k] = node_mems[k].arena.size;
+        node_target[k] = node_mems[k].target_bytes;
+    }
+    mem_lock_release();
+    unsigned long long total_mem_mb = snap.mem_total_kb / 1024;
+    if (total_mem_mb == 0) total_mem_mb = 1;
+    
+    // 基本状态信息
+    text_printf(f, "\n==================== 系统状态 ====================\n");
+    
+    // 显示当前时间
+    time_t now = time(NULL);
+    struct tm *timeinfo = localtime(&now);
+    char timestr[20];
+    strftime(timestr, sizeof(timestr), "%Y-%m-%d %H:%M:%S", timeinfo);
+    text_printf(f, "当前时间: %s\n\n", timestr);
+    
+    // 获取并处理CPU使用率，当接近目标值时显示目标值
+    double display_cpu_usage = snap.cpu_usage;
+    int target_cpu_percent = (int)(get_overall_cpu_target() + 0.5);
+    if (display_cpu_usage > target_cpu_percent * 0.95 && display_cpu_usage < target_cpu_percent * 1.05) {
+        display_cpu_usage = target_cpu_percent;
+    }
     
-    // 清空缓冲区
-    memset(buffer, 0, buffer_size);
+    // 获取并处理内存使用率，当接近目标值时显示目标值
+    double display_mem_usage = snap.mem_usage;
+    int target_mem_percent = (int)(target_mem_mb * 100.0 / total_mem_mb + 0.5);
+    if (display_mem_usage > target_mem_percent * 0.95 && display_mem_usage < target_mem_percent * 1.05) {
+        display_mem_usage = target_mem_percent;
+    }
     
-    // 添加左边界
-    strcat(buffer, "[");
+    // 获取自身资源占用情况
+    double self_cpu = snap.self_cpu_usage;
+    unsigned long long self_mem_mb = snap.self_rss_kb / 1024;
+    double self_mem_percent = (double)self_mem_mb * 100.0 / total_mem_mb;
+    
+    // 计算系统占用率（不包含CMM自身）
+    double system_cpu = display_cpu_usage - self_cpu;
+    double system_mem = display_mem_usage - self_mem_percent;
+    
+    // 确保显示值不为负
+    if (system_cpu < 0) system_cpu = 0;
+    if (system_mem < 0) system_mem = 0;
+    
+    // 显示CPU和内存使用情况
+    text_append(f, "CPU: ", 5);
+    status_bar(f, display_cpu_usage, 30, colors);
+    text_printf(f, " (目标：%d%%, 系统：%.1f%%, CMM：%.1f%%)\n", target_cpu_percent, system_cpu, self_cpu);
+    text_append(f, "MEM: ", 5);
+    status_bar(f, display_mem_usage, 30, colors);
+    text_printf(f, " (目标：%d%%, 系统：%.1f%%, CMM：%.1f%%)\n", target_mem_percent, system_mem, self_mem_percent);
+    
+    // 每个NUMA节点的内存使用率，指定了节点目标时同时显示目标和该节点的压载区
+    if (num_numa_nodes > 1 || num_node_mems > 0) {
+        for (int i = 0; i < num_numa_nodes; i++) {
+            const numa_node_t* n = &numa_nodes[i];
+            double used = n->mem_total_kb ?
+                (double)(n->mem_total_kb - n->mem_available_kb) * 100.0 / n->mem_total_kb : 0.0;
+            text_printf(f, "node%-2d %5.1f%% 已用, %d个工作线程", n->id, used, n->num_cpus);
+            for (int k = 0; k < num_node_mems; k++) {
+                if (node_mems[k].node != n->id) continue;
+                text_printf(f, ", 目标 %.1f%%, 压载 %.1f MB",
+                            n->mem_total_kb ? node_target[k] * 100.0 / (n->mem_total_kb * 1024.0) : 0.0,
+                            node_ballast[k] / (1024.0 * 1024.0));
+            }
+            text_printf(f, "\n");
+        }
+    }
     
-    int color_code = 0;
+    // 按cgroup计算时显示cgroup的限制和CPU限流次数
+    if (cgroup.active) {
+        char limit_str[32] = "不限制";
+        if (cgroup.memory_max > 0) format_size(limit_str, sizeof(limit_str), cgroup.memory_max);
+        text_printf(f, "cgroup: ");
+        if (cgroup.cpu_limit > 0) text_printf(f, "CPU限制 %.2f核心", cgroup.cpu_limit);
+        else text_printf(f, "CPU不限制");
+        text_printf(f, ", 内存限制 %s, 按%s计算, 限流 %llu/%llu个周期 (%.1f秒)\n",
+                    limit_str, cgroup.active ? "cgroup" : "主机",
+                    snap.cg_nr_throttled, snap.cg_nr_periods, snap.cg_throttled_usec / 1e6);
+    }
     
-    // 根据百分比选择颜色
-    if (percentage < 30.0) {
-        color_code = 32; // 绿色
-    } else if (percentage < 70.0) {
-        color_code = 33; // 黄色
-    } else {
-        color_code = 31; // 红色
+    // 工作线程给其他进程增加的唤醒延迟: 探针负载期间与空载基准的差
+    if (wake_probe.started) {
+        latency_hist_t clear, overlap;
+        worker_hist_copy(&wake_probe.clear, &clear);
+        worker_hist_copy(&wake_probe.overlap, &overlap);
+        text_printf(f, "唤醒延迟(平均/p99, 微秒): 空闲 %.1f/%.1f, 撞上忙等 %.1f/%.1f (%.0f%%), 平均增加 %+.1f",
+                    hist_mean(&clear) / 1000.0, hist_percentile(&clear, 99) / 1000.0,
+                    hist_mean(&overlap) / 1000.0, hist_percentile(&overlap, 99) / 1000.0,
+                    wake_probe_overlap_ratio(&clear, &overlap) * 100.0,
+                    wake_probe_added_ns(&clear, &overlap) / 1000.0);
+        int failures = atomic_load_explicit(&worker_sched_failures, memory_order_relaxed);
+        if (worker_sched != WORKER_SCHED_NORMAL) {
+            text_printf(f, " [%s%s]", worker_sched_names[worker_sched], failures ? ", 部分线程设置失败" : "");
+        }
+        text_printf(f, "\n");
     }
     
-    // 使用ANSI转义序列添加彩色
-    char color_start[16] = {0};
-    char color_end[8] = {0};
+    // 压力退让: 最低的核心份额和触发次数
+    if (backoff.started && backoff_stall_ms > 0) {
+        double min_share = 1.0;
+        for (int i = 0; i < num_cpu_cores; i++) {
+            double share = atomic_load_explicit(&workers[i].backoff_share, memory_order_relaxed);
+            if (share < min_share) min_share = share;
+        }
+        text_printf(f, "CPU压力退让: 最低份额 %.0f%%, PSI触发 %llu次(忽略自身 %llu次), 运行队列等待触发 %llu次\n",
+                    min_share * 100.0,
+                    (unsigned long long)atomic_load_explicit(&backoff.psi_events, memory_order_relaxed),
+                    (unsigned long long)atomic_load_explicit(&backoff.psi_ignored, memory_order_relaxed),
+                    (unsigned long long)atomic_load_explicit(&backoff.rundelay_events, memory_order_relaxed));
+    }
+    if (backoff.started && backoff.mem_psi_fd >= 0) {
+        char cap_str[32] = "不限制";
+        if (pressure_cap > 0) snprintf(cap_str, sizeof(cap_str), "%.1f MB", pressure_cap / (1024.0 * 1024.0));
+        text_printf(f, "内存压力释放: %llu次(忽略填充期间 %llu次), 共释放 %.1f MB, 增长上限 %s\n",
+                    (unsigned long long)atomic_load_explicit(&backoff.mem_events, memory_order_relaxed),
+                    (unsigned long long)atomic_load_explicit(&backoff.mem_ignored, memory_order_relaxed),
+                    atomic_load_explicit(&backoff.mem_released, memory_order_relaxed) / (1024.0 * 1024.0), cap_str);
+    }
+    unsigned long long wd_headroom = atomic_load_explicit(&watchdog.headroom, memory_order_relaxed);
+    if (watchdog.started && wd_headroom != ULLONG_MAX) {
+        unsigned long long min_headroom = atomic_load_explicit(&watchdog.min_headroom, memory_order_relaxed);
+        text_printf(f, "内存看门狗: 余量 %.1f MB (最低 %.1f MB, 下限 %.1f MB), 触发 下限%llu次/换页%llu次/PSI%llu次, 共释放 %.1f MB\n",
+                    wd_headroom / (1024.0 * 1024.0), min_headroom / (1024.0 * 1024.0),
+                    watchdog.floor_bytes / (1024.0 * 1024.0),
+                    (unsigned long long)atomic_load_explicit(&watchdog.events[WATCHDOG_FLOOR], memory_order_relaxed),
+                    (unsigned long long)atomic_load_explicit(&watchdog.events[WATCHDOG_SWAP], memory_order_relaxed),
+                    (unsigned long long)atomic_load_explicit(&watchdog.events[WATCHDOG_PSI], memory_order_relaxed),
+                    atomic_load_explicit(&watchdog.released, memory_order_relaxed) / (1024.0 * 1024.0));
+    }
     
-#ifdef _WIN32
-    // 在Windows上检查是否支持ANSI颜色
-    HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-    DWORD mode = 0;
-    if (GetConsoleMode(hConsole, &mode)) {
-        // 设置VIRTUAL_TERMINAL_PROCESSING以支持ANSI颜色
-        mode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
-        if (SetConsoleMode(hConsole, mode)) {
-            // 支持ANSI颜色
-            sprintf(color_start, "\033[%dm", color_code);
-            strcpy(color_end, "\033[0m");
+    // 目标曲线的跟踪误差和滞后
+    if (cpu_profile.kind != PROFILE_NONE || mem_profile.kind != PROFILE_NONE) {
+        char cpu_lag_str[16], mem_lag_str[16];
+        format_profile_lag(cpu_lag_str, sizeof(cpu_lag_str), &cpu_lag);
+        format_profile_lag(mem_lag_str, sizeof(mem_lag_str), &mem_lag);
+        text_printf(f, "目标曲线: ");
+        if (cpu_profile.kind != PROFILE_NONE) {
+            text_printf(f, "CPU 设定%.1f%% 误差%+.1f%% 滞后%s  ", cpu_lag.setpoint, cpu_lag.error, cpu_lag_str);
         }
+        if (mem_profile.kind != PROFILE_NONE) {
+            text_printf(f, "MEM 设定%.1f%% 误差%+.1f%% 滞后%s", mem_lag.setpoint, mem_lag.error, mem_lag_str);
+        }
+        text_printf(f, "\n");
     }
-#else
-    // Linux默认支持ANSI颜色
-    sprintf(color_start, "\033[%dm", color_code);
-    strcpy(color_end, "\033[0m");
-#endif
     
-    // 添加填充部分(彩色)
-    if (filled_width > 0) {
-        strcat(buffer, color_start);
+    // 详细模式下显示更多信息
+    if (verbose_mode) {
+        // 核心控制状态读取CPU调整线程发布的副本
+        double cpu_filtered, cpu_target;
+        core_stats_read(core_stats, &cpu_filtered, &cpu_target);
+        text_printf(f, "详细信息: CPU占用=%6.2f%%, 控制=%3d%%, 滤波值=%.1f%%, MEM占用=%.1f%%, 滤波值=%.1f%%\n",
+                    snap.cpu_usage, busy_percentage, cpu_filtered,
+                    snap.mem_usage, mem_filtered);
+        text_printf(f, "控制参数: PID(%.2f, %.2f, %.2f), 滤波系数: %.2f, CPU核心: %d, PWM周期: %lldus%s\n",
+                    pid_kp, pid_ki, pid_kd, filter_alpha, num_cpu_cores,
+                    cycle_period_us, phase_stagger ? " (相位错开)" : "");
         
-        for (int i = 0; i < filled_width; i++) {
-            // 使用方块填充已完成部分
-            strcat(buffer, "█");
+        // 工作速率: 忙等时间内内核完成的运算次数
+        static unsigned long long prev_ops = 0, prev_busy_ns = 0;
+        static double work_rate = 0.0;
+        unsigned long long total_ops = 0, total_busy_ns = 0;
+        for (int i = 0; i < num_cpu_cores; i++) {
+            total_ops += atomic_load_explicit(&workers[i].work_ops, memory_order_relaxed);
+            total_busy_ns += atomic_load_explicit(&workers[i].busy_ns_sum, memory_order_relaxed);
+        }
+        if (total_busy_ns > prev_busy_ns) {
+            work_rate = (double)(total_ops - prev_ops) * 1000.0 / (total_busy_ns - prev_busy_ns);
+        }
+        prev_ops = total_ops;
+        prev_busy_ns = total_busy_ns;
+        text_printf(f, "CPU占用内核: %s(%s), 工作速率: %.1f Mops/s(每核心忙等时间)\n",
+                    burn_kernels[burn_kernel_index].name, burn_kernels[burn_kernel_index].variant, work_rate);
+        
+        // 每个核心: 使用率/设定值/繁忙百分比
+        text_printf(f, "核心状态(使用率/外部/设定/控制):");
+        for (int i = 0; i < num_cpu_cores; i++) {
+            if (i % 4 == 0) text_printf(f, "\n ");
+            const double* stats = &core_stats[i * CORE_STATS];
+            text_printf(f, "  cpu%-3d %5.1f/%5.1f/%5.1f/%5.1f",
+                        core_ctrls[i].cpu_id, stats[CORE_STAT_FILTERED], stats[CORE_STAT_EXTERNAL],
+                        stats[CORE_STAT_SETPOINT], stats[CORE_STAT_BUSY]);
+        }
+        text_printf(f, "\n");
+        
+        // 每个工作线程: 下发的CPU份额/线程CPU时钟测得的实际份额
+        text_printf(f, "工作线程(指令/实际CPU):");
+        for (int i = 0; i < num_cpu_cores; i++) {
+            if (i % 4 == 0) text_printf(f, "\n ");
+            const double* stats = &core_stats[i * CORE_STATS];
+            text_printf(f, "  cpu%-3d %5.1f/%5.1f      ",
+                        core_ctrls[i].cpu_id, stats[CORE_STAT_COMMANDED], stats[CORE_STAT_OWN]);
         }
+        text_printf(f, "\n");
         
-        strcat(buffer, color_end);
+        // 工作线程每个周期的偏差分布(所有线程汇总，自启动以来)
+        latency_hist_t wake, late, shortfall, excess;
+        worker_hists_collect(offsetof(worker_t, wake_hist), &wake);
+        worker_hists_collect(offsetof(worker_t, late_hist), &late);
+        worker_hists_collect(offsetof(worker_t, short_hist), &shortfall);
+        worker_hists_collect(offsetof(worker_t, over_hist), &excess);
+        char wake_str[48], late_str[48], short_str[48], excess_str[48];
+        format_hist_us(wake_str, sizeof(wake_str), &wake);
+        format_hist_us(late_str, sizeof(late_str), &late);
+        format_hist_us(short_str, sizeof(short_str), &shortfall);
+        format_hist_us(excess_str, sizeof(excess_str), &excess);
+        unsigned long long loaded = shortfall.count + excess.count;
+        text_printf(f, "工作线程周期偏差(p50/p99/最大, 微秒): 唤醒过冲 %s, 周期延迟 %s\n", wake_str, late_str);
+        text_printf(f, "  CPU不足 %s (%.1f%%周期), CPU超出 %s (%.1f%%周期)\n",
+                    short_str, loaded ? shortfall.count * 100.0 / loaded : 0.0,
+                    excess_str, loaded ? excess.count * 100.0 / loaded : 0.0);
     }
     
-    // 添加未填充部分
-    for (int i = 0; i < bar_width - filled_width; i++) {
-        strcat(buffer, "░");
+    text_printf(f, "\n=====================================================\n");
+}
+
+// 查询终端窗口的行数和列数，失败时按80x24
+void status_window_size(int* rows, int* cols) {
+    *rows = 24;
+    *cols = 80;
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi)) {
+        *rows = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
+        *cols = csbi.srWindow.Right - csbi.srWindow.Left + 1;
+    }
+#else
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0) {
+        *rows = ws.ws_row;
+        *cols = ws.ws_col;
+    }
+#endif
+}
+
+// 字符在终端中占的列数: 中日韩文字和全角符号占2列，其他占1列
+int status_char_width(unsigned int cp) {
+    if ((cp >= 0x1100 && cp <= 0x115F) || (cp >= 0x2E80 && cp <= 0xA4CF) || (cp >= 0xAC00 && cp <= 0xD7A3) ||
+        (cp >= 0xF900 && cp <= 0xFAFF) || (cp >= 0xFE30 && cp <= 0xFE4F) || (cp >= 0xFF00 && cp <= 0xFF60) ||
+        (cp >= 0xFFE0 && cp <= 0xFFE6)) {
+        return 2;
+    }
+    return 1;
+}
+
+// 截取一行中不超过max_cols列的部分，返回字节数；颜色等转义序列不占列
+size_t status_clip_line(const char* line, size_t len, int max_cols, bool* clipped) {
+    int cols = 0;
+    size_t i = 0;
+    *clipped = false;
+    while (i < len) {
+        unsigned char c = (unsigned char)line[i];
+        if (c == 0x1B) {
+            // CSI序列到结束字母为止
+            size_t j = i + 1;
+            if (j < len && line[j] == '[') {
+                j++;
+                while (j < len && !isalpha((unsigned char)line[j])) j++;
+            }
+            i = j < len ? j + 1 : len;
+            continue;
+        }
+        size_t n = 1;
+        unsigned int cp = c;
+        if (c >= 0xF0) { n = 4; cp = c & 0x07; }
+        else if (c >= 0xE0) { n = 3; cp = c & 0x0F; }
+        else if (c >= 0xC0) { n = 2; cp = c & 0x1F; }
+        if (i + n > len) n = len - i;
+        for (size_t k = 1; k < n; k++) cp = (cp << 6) | ((unsigned char)line[i + k] & 0x3F);
+        int w = status_char_width(cp);
+        if (cols + w > max_cols) {
+            *clipped = true;
+            return i;
+        }
+        cols += w;
+        i += n;
+    }
+    return len;
+}
+
+// 输出一帧: 终端上只重写与上一帧不同的行，否则整帧追加输出
+// 每行截断到窗口宽度以内(不自动折行，行号与屏幕行一一对应)，超出窗口高度的行不输出
+void status_render(status_renderer_t* r) {
+    text_buf_t* frame = &r->frame;
+    text_buf_t* out = &r->out;
+    frame->len = 0;
+    render_status_frame(frame, r->core_stats, r->vt);
+    
+    // 先输出其他地方用printf缓冲的内容，保持先后顺序
+    fflush(stdout);
+    
+    if (!r->vt) {
+#ifdef _WIN32
+        clear_screen();
+#endif
+        write_stdout(frame->buf, frame->len);
+        return;
     }
     
-    // 添加右边界和百分比
-    char percentStr[16];
-    sprintf(percentStr, "] %5.1f%%", percentage);
-    strcat(buffer, percentStr);
+    int lines = 0;
+    for (size_t i = 0; i < frame->len; i++) {
+        if (frame->buf[i] == '\n') lines++;
+    }
+    int rows, cols;
+    status_window_size(&rows, &cols);
+    bool full = !r->drawn || lines != r->prev_lines || rows != r->rows || cols != r->cols ||
+                ++r->frames_since_full >= r->full_every;
+    r->rows = rows;
+    r->cols = cols;
+    // 最后一行留给光标，最后一列不写，避免终端滚屏或折行
+    int max_lines = rows - 1;
+    
+    out->len = 0;
+    if (full) {
+        text_append(out, "\033[H\033[2J", 7);
+        r->frames_since_full = 0;
+    }
     
-    // 如果百分比超过阈值，添加标记
-    if (percentage > 90.0) {
-        strcat(buffer, " (!!)");
-    } else if (percentage > 75.0) {
-        strcat(buffer, " (!)");
+    // 逐行比较，行号从1开始
+    const char* cur = frame->buf;
+    const char* cur_end = frame->buf + frame->len;
+    const char* old = r->prev.buf;
+    const char* old_end = r->prev.buf + r->prev.len;
+    for (int line = 1; cur < cur_end && line <= max_lines; line++) {
+        const char* nl = (const char*)memchr(cur, '\n', (size_t)(cur_end - cur));
+        size_t len = nl ? (size_t)(nl - cur) : (size_t)(cur_end - cur);
+        bool changed = true;
+        if (old < old_end) {
+            const char* old_nl = (const char*)memchr(old, '\n', (size_t)(old_end - old));
+            size_t old_len = old_nl ? (size_t)(old_nl - old) : (size_t)(old_end - old);
+            changed = old_len != len || memcmp(old, cur, len) != 0;
+            old += old_len + 1;
+        }
+        if (full || changed) {
+            bool clipped;
+            size_t shown = status_clip_line(cur, len, cols - 1, &clipped);
+            text_printf(out, "\033[%d;1H", line);
+            text_append(out, cur, shown);
+            // 截断处可能在颜色序列中间，恢复默认颜色
+            if (clipped) text_append(out, "\033[0m", 4);
+            text_append(out, "\033[K", 3);
+        }
+        cur += len + 1;
     }
+    
+    // 光标停在画面下方，同时清除其他输出留在画面下方的内容
+    text_printf(out, "\033[%d;1H\033[J", (lines < max_lines ? lines : max_lines) + 1);
+    write_stdout(out->buf, out->len);
+    
+    // 本帧成为下一帧的比较对象
+    text_buf_t tmp = r->prev;
+    r->prev = r->frame;
+    r->frame = tmp;
+    r->prev_lines = lines;
+    r->drawn = true;
 }
 
 void print_usage() {
     printf("用法: ./cmm -c <cpu_usage> -m <memory_usage> [选项]\n");
     printf("必选参数 (或使用配置文件):\n");
     printf("  -c <cpu_usage>    目标CPU使用率(百分比, 0-100)\n");
-    printf("  -m <memory_usage> 目标内存使用率(百分比, 0-100)\n");
+    printf("  -m <memory_usage> 目标内存: 百分比(0-100)，绝对值(如64G)，或保留空闲内存(如free:8G)\n");
+    printf("  --mem-rate <size> 每秒最多增长的压载内存(如2G，默认: 内存总量的一半)\n");
+    printf("  --mem-floor <size> 可用内存硬下限(百分比或如512M)，设置后启用内存看门狗，低于时立即释放压载(默认不启用)\n");
+    printf("  --scope <scope>   目标范围: auto(默认，有cgroup限制时按cgroup)、host或cgroup\n");
+    printf("  --cgroup <dir>    指定cgroup v2目录(默认从/proc/self/cgroup查找)\n");
+    printf("  --numa <policy>   压载区NUMA策略: interleave(多节点时默认)、local或bind:<节点列表>\n");
+    printf("  --mem-node <spec> 按NUMA节点设置内存目标，例如 0:60,1:free:4G (代替-m)\n");
+    printf("  --cpu-node <spec> 按NUMA节点设置CPU目标，例如 0:80,1:20\n");
     printf("可选参数:\n");
+    printf("  --cpu-groups <spec> 按核心分组设置目标, 例如 0-7:80,8-63:20 (其余核心使用 -c)\n");
+    printf("  --cpu-profile <spec> CPU目标曲线, 代替 -c (见下)\n");
+    printf("  --mem-profile <spec> 内存目标曲线, 代替 -m\n");
     printf("  -v                详细输出模式\n");
     printf("  -l <file>         加载配置文件\n");
     printf("  -s [file]         保存配置到文件 (默认: cmm.conf)\n");
     printf("  -d                以守护进程/后台模式运行\n");
     printf("  -k                查找并终止所有正在运行的CMM进程\n");
+    printf("  --period <us>     工作线程PWM周期(微秒, 默认: 5000)\n");
+    printf("  --stagger         错开各工作线程的相位，避免同时唤醒\n");
+    printf("  --kernel <name>   CPU占用内核: scalar(默认), fma, int, branch, pause\n");
+    printf("  --worker-sched <policy> 工作线程调度策略: normal(默认), idle(SCHED_IDLE), nice(nice 19)\n");
+    printf("  --probe <hz>      唤醒延迟探针频率(默认: 0, 不启用)\n");
+    printf("  --backoff <ms>    其他任务每500ms的CPU等待超过该值时立即退让(PSI和/proc/schedstat)\n");
+    printf("  --mlock           锁定压载内存，防止被换出(需要足够的RLIMIT_MEMLOCK)\n");
+    printf("  --fill <mode>     压载内容: random(默认, 不可压缩/去重), touch(只触发缺页)\n");
+    printf("  --ballast <type>  压载内存来源: anon(默认, 匿名内存), memfd(shmem，打洞释放)\n");
+    printf("  --mem-backoff <ms> 每500ms的内存等待超过该值时立即释放一半压载(内存PSI)\n");
+    printf("  --unmergeable     将压载区标记为MADV_UNMERGEABLE，禁止KSM合并\n");
+    printf("  --fill-threads <n> 压载后台填充线程数(默认: 核心数，最多8)\n");
+    printf("  --record <file>   把每次采样的原始计数录制到轨迹文件\n");
+    printf("  --replay <file>   从轨迹文件回放指标(与 -B controller 一起使用时加速回放)\n");
+    printf("  --proc-root <dir> 从其他目录读取stat/meminfo/self/stat (默认: /proc)\n");
+    printf("  --refresh <hz>    状态画面刷新频率(默认: 1，最高50)\n");
+    printf("  --metrics-port <port> 在该端口提供Prometheus指标 (/metrics)\n");
+    printf("  --metrics-addr <addr> 指标导出监听地址 (默认: 127.0.0.1)\n");
+    printf("  -B <name>         运行基准测试后退出 (sync, pwm, kernels, fill, release, controller, hist 或 all)\n");
     printf("  -h                显示此帮助信息\n");
+    printf("目标曲线 (百分比/秒): ramp:起点:终点:时长, sine:最小:最大:周期,\n");
+    printf("  diurnal:最小:最大[:周期] (按本地时间04:00最低), square:低:高:周期[:占比],\n");
+    printf("  file:<路径> (每行\"秒 值\"，线性插值，含repeat行时循环)\n");
     printf("例子: ./cmm -c 50 -m 50 -v\n");
     printf("      ./cmm -l my_config.conf\n");
     printf("      ./cmm -c 50 -m 50 -d\n");
+    printf("      ./cmm -c 30 -m 50 --cpu-groups 0-7:80\n");
+    printf("      ./cmm --cpu-profile sine:20:80:600 --mem-profile diurnal:30:70\n");
     printf("      ./cmm -k      # 终止所有正在运行的CMM进程\n");
 }
 
@@ -1123,9 +5472,118 @@ bool load_config(const char* filename) {
             if (strcmp(key, "cpu_usage") == 0) {
                 target_cpu_usage = atoi(value);
             } else if (strcmp(key, "mem_usage") == 0) {
-                double mem_percent = atof(value); // 使用atof获取更精确的值
-                unsigned long long total_system_memory_mb = get_total_system_memory();
-                target_mem_usage_mb = (int)(mem_percent * total_system_memory_mb / 100.0 + 0.5); // 加0.5进行四舍五入
+                if (!parse_mem_target(value, &mem_target)) {
+                    printf("配置文件中的内存目标无效: %s\n", value);
+                    fclose(fp);
+                    return false;
+                }
+            } else if (strcmp(key, "mem_node") == 0) {
+                if (!parse_mem_node_targets(value)) {
+                    fclose(fp);
+                    return false;
+                }
+            } else if (strcmp(key, "cpu_node") == 0) {
+                if (!parse_cpu_node_targets(value)) {
+                    fclose(fp);
+                    return false;
+                }
+            } else if (strcmp(key, "scope") == 0) {
+                if (!parse_target_scope(value)) {
+                    printf("配置文件中的目标范围无效: %s\n", value);
+                    fclose(fp);
+                    return false;
+                }
+            } else if (strcmp(key, "numa") == 0) {
+                if (!parse_numa_policy(value)) {
+                    printf("配置文件中的NUMA策略无效: %s\n", value);
+                    fclose(fp);
+                    return false;
+                }
+            } else if (strcmp(key, "mem_rate") == 0) {
+                if (!parse_size(value, &mem_rate_bytes)) {
+                    mem_rate_bytes = 0;
+                }
+            } else if (strcmp(key, "mem_floor") == 0) {
+                if (!parse_mem_floor(value)) {
+                    printf("配置文件中的可用内存下限无效: %s\n", value);
+                    fclose(fp);
+                    return false;
+                }
+            } else if (strcmp(key, "cpu_groups") == 0) {
+                if (!parse_cpu_groups(value)) {
+                    fclose(fp);
+                    return false;
+                }
+            } else if (strcmp(key, "cpu_profile") == 0) {
+                if (!parse_target_profile(&cpu_profile, value)) {
+                    fclose(fp);
+                    return false;
+                }
+            } else if (strcmp(key, "mem_profile") == 0) {
+                if (!parse_target_profile(&mem_profile, value)) {
+                    fclose(fp);
+                    return false;
+                }
+            } else if (strcmp(key, "period_us") == 0) {
+                long long period = atoll(value);
+                if (period >= 500 && period <= 1000000) {
+                    cycle_period_us = period;
+                }
+            } else if (strcmp(key, "kernel") == 0) {
+                int kernel = find_burn_kernel(value);
+                if (kernel >= 0) {
+                    burn_kernel_index = kernel;
+                }
+            } else if (strcmp(key, "worker_sched") == 0) {
+                if (!parse_worker_sched(value)) {
+                    printf("配置文件中的工作线程调度策略无效: %s\n", value);
+                    fclose(fp);
+                    return false;
+                }
+            } else if (strcmp(key, "probe") == 0) {
+                double hz = atof(value);
+                if (hz >= 0 && hz <= 1000) {
+                    probe_hz = hz;
+                }
+            } else if (strcmp(key, "backoff") == 0) {
+                double ms = atof(value);
+                if (ms >= 0 && ms < 500) {
+                    backoff_stall_ms = ms;
+                }
+            } else if (strcmp(key, "stagger") == 0) {
+                phase_stagger = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
+            } else if (strcmp(key, "mlock") == 0) {
+                ballast_mlock = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
+            } else if (strcmp(key, "ballast") == 0) {
+                if (strcmp(value, "anon") == 0) ballast_backing = BALLAST_ANON;
+                else if (strcmp(value, "memfd") == 0) ballast_backing = BALLAST_MEMFD;
+            } else if (strcmp(key, "mem_backoff") == 0) {
+                double ms = atof(value);
+                if (ms >= 0 && ms < 500) {
+                    mem_backoff_stall_ms = ms;
+                }
+            } else if (strcmp(key, "fill") == 0) {
+                if (strcmp(value, "random") == 0) ballast_fill_mode = FILL_RANDOM;
+                else if (strcmp(value, "touch") == 0) ballast_fill_mode = FILL_TOUCH;
+            } else if (strcmp(key, "fill_threads") == 0) {
+                int threads = atoi(value);
+                if (threads >= 1 && threads <= MAX_FILL_THREADS) {
+                    fill_threads = threads;
+                }
+            } else if (strcmp(key, "unmergeable") == 0) {
+                ballast_unmergeable = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
+            } else if (strcmp(key, "refresh") == 0) {
+                double hz = atof(value);
+                if (hz >= 0.1 && hz <= 50) {
+                    refresh_hz = hz;
+                }
+            } else if (strcmp(key, "metrics_port") == 0) {
+                int port = atoi(value);
+                if (port >= 0 && port <= 65535) {
+                    metrics_port = port;
+                }
+            } else if (strcmp(key, "metrics_addr") == 0) {
+                snprintf(metrics_addr, sizeof(metrics_addr), "%.63s", value);
             } else if (strcmp(key, "verbose") == 0) {
                 verbose_mode = (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
             }
@@ -1150,187 +5608,1078 @@ bool save_config_to_file(const char* filename) {
     
     fprintf(fp, "# 目标CPU和内存使用率\n");
     fprintf(fp, "cpu_usage=%d\n", target_cpu_usage);
-    fprintf(fp, "mem_usage=%d\n\n", (int)(target_mem_usage_mb * 100.0 / get_total_system_memory() + 0.5)); // 加0.5进行四舍五入
+    char mem_target_str[64];
+    format_mem_target(mem_target_str, sizeof(mem_target_str), &mem_target);
+    fprintf(fp, "mem_usage=%s\n\n", mem_target_str);
+    
+    if (cpu_node_spec[0]) {
+        fprintf(fp, "# NUMA节点CPU目标\n");
+        fprintf(fp, "cpu_node=%s\n\n", cpu_node_spec);
+    } else if (num_cpu_groups > 0) {
+        fprintf(fp, "# 核心分组目标\n");
+        fprintf(fp, "cpu_groups=%s\n\n", cpu_groups_spec);
+    }
+    
+    fprintf(fp, "# 目标范围(auto/host/cgroup)\n");
+    fprintf(fp, "scope=%s\n\n", target_scope == SCOPE_HOST ? "host" : (target_scope == SCOPE_CGROUP ? "cgroup" : "auto"));
+    
+    fprintf(fp, "# NUMA\n");
+    char numa_str[128];
+    format_numa_policy(numa_str, sizeof(numa_str));
+    fprintf(fp, "numa=%s\n", numa_str);
+    if (num_node_mems > 0) fprintf(fp, "mem_node=%s\n", mem_node_spec);
+    fprintf(fp, "\n");
+    
+    if (cpu_profile.kind != PROFILE_NONE || mem_profile.kind != PROFILE_NONE) {
+        fprintf(fp, "# 目标曲线\n");
+        if (cpu_profile.kind != PROFILE_NONE) fprintf(fp, "cpu_profile=%s\n", cpu_profile.spec);
+        if (mem_profile.kind != PROFILE_NONE) fprintf(fp, "mem_profile=%s\n", mem_profile.spec);
+        fprintf(fp, "\n");
+    }
+    
+    fprintf(fp, "# 工作线程PWM调度\n");
+    fprintf(fp, "period_us=%lld\n", cycle_period_us);
+    fprintf(fp, "stagger=%s\n", phase_stagger ? "true" : "false");
+    fprintf(fp, "kernel=%s\n", burn_kernels[burn_kernel_index].name);
+    fprintf(fp, "worker_sched=%s\n", worker_sched_names[worker_sched]);
+    fprintf(fp, "probe=%g\n", probe_hz);
+    fprintf(fp, "backoff=%g\n\n", backoff_stall_ms);
+    
+    fprintf(fp, "# 内存压载\n");
+    fprintf(fp, "mlock=%s\n", ballast_mlock ? "true" : "false");
+    fprintf(fp, "fill=%s\n", ballast_fill_mode == FILL_RANDOM ? "random" : "touch");
+    fprintf(fp, "ballast=%s\n", ballast_backing == BALLAST_MEMFD ? "memfd" : "anon");
+    fprintf(fp, "mem_backoff=%g\n", mem_backoff_stall_ms);
+    fprintf(fp, "unmergeable=%s\n", ballast_unmergeable ? "true" : "false");
+    fprintf(fp, "fill_threads=%d\n", fill_threads);
+    char mem_rate_str[32];
+    format_size(mem_rate_str, sizeof(mem_rate_str), mem_rate_bytes);
+    fprintf(fp, "mem_rate=%s\n", mem_rate_str);
+    char mem_floor_str[64];
+    format_mem_target(mem_floor_str, sizeof(mem_floor_str), &mem_floor);
+    fprintf(fp, "mem_floor=%s\n\n", mem_floor_str);
+    
+    fprintf(fp, "# Prometheus指标导出(端口0为不启用)\n");
+    fprintf(fp, "metrics_port=%d\n", metrics_port);
+    fprintf(fp, "metrics_addr=%s\n\n", metrics_addr);
     
     fprintf(fp, "# 其他设置\n");
     fprintf(fp, "verbose=%s\n", verbose_mode ? "true" : "false");
+    fprintf(fp, "refresh=%g\n", refresh_hz);
     
     fclose(fp);
     printf("配置已保存到: %s\n", filename);
     return true;
 }
 
-// 获取CMM自身的CPU使用率
-double get_self_cpu_usage() {
-#ifdef _WIN32
-    static ULARGE_INTEGER last_time = {0};
-    static ULARGE_INTEGER last_system_time = {0};
+#ifndef _WIN32
+// 控制线程到工作线程同步机制的基准测试: 读线程
+typedef struct {
+    worker_t* worker;                 // seqlock模式下读取的命令
+    pthread_mutex_t* mutex;           // 互斥锁模式下的锁(为NULL时使用seqlock)
+    volatile double* shared_value;    // 互斥锁模式下的共享值
+    const unsigned long long* publish_ns; // 每个版本的发布时间
+    atomic_int* stop;
+    unsigned long long reads;         // 读取次数
+    latency_hist_t latency;           // 发布到读取的延迟分布
+} sync_bench_reader_t;
+
+void* bench_sync_reader(void* arg) {
+    sync_bench_reader_t* reader = (sync_bench_reader_t*)arg;
+    double last = 0.0;
+    
+    while (!atomic_load_explicit(reader->stop, memory_order_relaxed)) {
+        double value;
+        if (reader->mutex) {
+            pthread_mutex_lock(reader->mutex);
+            value = *reader->shared_value;
+            pthread_mutex_unlock(reader->mutex);
+        } else {
+            worker_cmd_t cmd;
+            worker_read_cmd(reader->worker, &cmd);
+            value = cmd.duty;
+        }
+        reader->reads++;
+        
+        // 值即版本号，看到新版本时记录延迟
+        if (value != last) {
+            hist_record(&reader->latency, get_time_ns() - reader->publish_ns[(int)value]);
+            last = value;
+        }
+    }
+    return NULL;
+}
+
+// 控制线程到工作线程同步机制的基准测试: 对比原来的全局互斥锁和每线程seqlock
+void bench_sync() {
+    const int worker_counts[] = { 1, 16, 256 };
+    const int versions = 500;         // 每轮最多发布的版本数
+    const long publish_interval_us = 1000;
+    const unsigned long long max_round_ns = 2000000000ULL; // 每轮最长2秒，防止锁竞争严重时耗时过长
+    
+    printf("\n== 同步机制基准测试 (控制线程 -> 工作线程) ==\n");
+    printf("每轮最多发布 %d 次(最长2秒)，间隔 %ld us，读线程持续轮询\n", versions, publish_interval_us);
+    printf("%-8s %-8s %14s %14s %12s %12s %12s\n",
+           "线程数", "模式", "读取次数/秒", "发布耗时(ns)", "延迟均值(us)", "延迟P99(us)", "延迟最大(us)");
+    
+    unsigned long long* publish_ns = (unsigned long long*)calloc(versions + 1, sizeof(unsigned long long));
+    if (!publish_ns) return;
+    
+    for (size_t c = 0; c < sizeof(worker_counts) / sizeof(worker_counts[0]); c++) {
+        int count = worker_counts[c];
+        
+        for (int use_mutex = 1; use_mutex >= 0; use_mutex--) {
+            pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+            volatile double shared_value = 0.0;
+            atomic_int stop;
+            atomic_init(&stop, 0);
+            
+            worker_t* bench_workers = alloc_workers(count);
+            sync_bench_reader_t* readers = (sync_bench_reader_t*)alloc_cache_aligned(count * sizeof(sync_bench_reader_t));
+            pthread_t* threads = (pthread_t*)malloc(count * sizeof(pthread_t));
+            if (!bench_workers || !readers || !threads) {
+                printf("内存分配失败\n");
+                free_cache_aligned(bench_workers);
+                free_cache_aligned(readers);
+                free(threads);
+                free(publish_ns);
+                return;
+            }
+            
+            int started = 0;
+            for (int i = 0; i < count; i++) {
+                memset(&readers[i], 0, sizeof(readers[i]));
+                readers[i].worker = &bench_workers[i];
+                readers[i].mutex = use_mutex ? &mutex : NULL;
+                readers[i].shared_value = &shared_value;
+                readers[i].publish_ns = publish_ns;
+                readers[i].stop = &stop;
+                if (pthread_create(&threads[i], NULL, bench_sync_reader, &readers[i]) != 0) break;
+                started++;
+            }
+            
+            // 控制线程: 逐个发布新版本并统计发布耗时
+            unsigned long long publish_cost = 0;
+            unsigned long long start_ns = get_time_ns();
+            int published = 0;
+            for (int v = 1; v <= versions && get_time_ns() - start_ns < max_round_ns; v++) {
+                unsigned long long t0 = get_time_ns();
+                publish_ns[v] = t0;
+                if (use_mutex) {
+                    pthread_mutex_lock(&mutex);
+                    shared_value = v;
+                    pthread_mutex_unlock(&mutex);
+                } else {
+                    worker_cmd_t cmd = { .duty = (double)v, .period_ns = 1000000ULL };
+                    for (int i = 0; i < count; i++) {
+                        worker_publish_cmd(&bench_workers[i], &cmd);
+                    }
+                }
+                publish_cost += get_time_ns() - t0;
+                published++;
+                usleep(publish_interval_us);
+            }
+            double elapsed = (get_time_ns() - start_ns) / 1e9;
+            
+            atomic_store(&stop, 1);
+            latency_hist_t total;
+            memset(&total, 0, sizeof(total));
+            unsigned long long reads = 0;
+            for (int i = 0; i < started; i++) {
+                pthread_join(threads[i], NULL);
+                hist_merge(&total, &readers[i].latency);
+                reads += readers[i].reads;
+            }
+            
+            printf("%-8d %-8s %14.0f %14.0f %12.1f %12.1f %12.1f\n",
+                   count, use_mutex ? "mutex" : "seqlock",
+                   reads / elapsed, published ? (double)publish_cost / published : 0.0,
+                   total.count ? (double)total.sum / total.count / 1000.0 : 0.0,
+                   hist_percentile(&total, 99.0) / 1000.0, total.max / 1000.0);
+            
+            free_cache_aligned(bench_workers);
+            free_cache_aligned(readers);
+            free(threads);
+        }
+    }
+    
+    free(publish_ns);
+}
+// 读取RAPL封装能耗计数器(微焦)，不可用时返回false
+bool read_rapl_energy_uj(unsigned long long* energy) {
+    FILE* fp = fopen("/sys/class/powercap/intel-rapl:0/energy_uj", "r");
+    if (!fp) return false;
+    bool ok = fscanf(fp, "%llu", energy) == 1;
+    fclose(fp);
+    return ok;
+}
+
+// CPU占用内核基准测试: 单线程满负载运行每个内核，报告工作速率和功耗
+void bench_kernels() {
+    const unsigned long long round_ns = 500000000ULL;
+    
+    printf("\n== CPU占用内核基准测试 (单线程满负载, 每个内核 %.1f 秒) ==\n", round_ns / 1e9);
+    printf("%-8s %-8s %10s %14s %14s %10s  %s\n",
+           "内核", "实现", "批次", "速率(Mops/s)", "每批耗时(us)", "功耗(W)", "说明");
+    
+    for (int k = 0; k < NUM_BURN_KERNELS; k++) {
+        burn_kernel_t* kernel = &burn_kernels[k];
+        unsigned long long energy_start = 0, energy_end = 0;
+        bool has_energy = read_rapl_energy_uj(&energy_start);
+        
+        unsigned long long ops = 0, batches = 0;
+        unsigned long long start = get_time_ns(), now;
+        do {
+            ops += kernel->fn(kernel->batch);
+            batches++;
+            now = get_time_ns();
+        } while (now - start < round_ns);
+        double elapsed = (now - start) / 1e9;
+        
+        char power[16] = "-";
+        if (has_energy && read_rapl_energy_uj(&energy_end) && energy_end > energy_start) {
+            snprintf(power, sizeof(power), "%.1f", (energy_end - energy_start) / 1e6 / elapsed);
+        }
+        
+        printf("%-8s %-8s %10llu %14.1f %14.2f %10s  %s\n",
+               kernel->name, kernel->variant, kernel->batch, ops / elapsed / 1e6,
+               elapsed * 1e6 / batches, power, kernel->description);
+    }
+}
+
+// 压载填充方式
+typedef struct {
+    const char* name;
+    fill_fn_t fn;      // 为NULL时使用memset常量填充
+} bench_fill_case_t;
+
+// 用指定方式填充整个缓冲区，返回耗时(秒)
+double bench_fill_run(const bench_fill_case_t* c, char* buf, size_t bytes, size_t page_size, uint64_t seed) {
+    unsigned long long start = get_time_ns();
+    if (c->fn) {
+        c->fn(buf, bytes, page_size, 0, seed);
+    } else {
+        memset(buf, 0xAA, bytes);
+    }
+    return (get_time_ns() - start) / 1e9;
+}
+
+// 压载填充基准测试: 比较memset常量填充与随机填充的吞吐量，分别测量首次写入(含缺页)和已驻留内存
+void bench_fill() {
+    const size_t bytes = 256 * 1024 * 1024;
+    const int repeats = 4;
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    
+    bench_fill_case_t cases[3] = {
+        { "memset", NULL },
+        { "random-scalar", fill_random_scalar },
+        { NULL, NULL },
+    };
+    int num_cases = 2;
+#if (defined(__x86_64__) || defined(__i386__))
+    if (__builtin_cpu_supports("avx2")) {
+        cases[num_cases].name = "random-avx2";
+        cases[num_cases].fn = fill_random_avx2;
+        num_cases++;
+    }
+#endif
     
-    FILETIME creation_time, exit_time, kernel_time, user_time;
-    HANDLE process = GetCurrentProcess();
+    printf("\n== 压载填充基准测试 (%zu MB, 已驻留内存重复 %d 次取最好) ==\n", bytes >> 20, repeats);
+    printf("%-14s %16s %16s\n", "方式", "首次写入(GB/s)", "已驻留(GB/s)");
     
-    if (!GetProcessTimes(process, &creation_time, &exit_time, &kernel_time, &user_time)) {
-        return 0.0;
+    for (int c = 0; c < num_cases; c++) {
+        char* buf = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buf == MAP_FAILED) {
+            printf("映射测试缓冲区失败: %s\n", strerror(errno));
+            return;
+        }
+        
+        // 首次写入包含缺页开销，对应压载区增长时的实际代价
+        double first = bench_fill_run(&cases[c], buf, bytes, page_size, 1);
+        double best = first;
+        for (int r = 0; r < repeats; r++) {
+            double t = bench_fill_run(&cases[c], buf, bytes, page_size, r + 2);
+            if (t < best) best = t;
+        }
+        
+        printf("%-14s %16.2f %16.2f\n", cases[c].name, bytes / first / 1e9, bytes / best / 1e9);
+        munmap(buf, bytes);
+    }
+}
+
+// 释放基准测试: 读取MemAvailable和自身RSS(KB)
+void bench_release_sample(int meminfo_fd, int statm_fd, unsigned long long* avail_kb, unsigned long long* rss_kb) {
+    char buf[4096];
+    if (read_proc_fd(meminfo_fd, buf, sizeof(buf)) > 0) {
+        const char* p = strstr(buf, "MemAvailable:");
+        if (p) {
+            p += 13;
+            *avail_kb = parse_ull(&p);
+        }
+    }
+    if (read_proc_fd(statm_fd, buf, sizeof(buf)) > 0) {
+        const char* p = buf;
+        parse_ull(&p);
+        *rss_kb = parse_ull(&p) * (unsigned long long)(sysconf(_SC_PAGESIZE) / 1024);
+    }
+}
+
+// 压载释放基准测试: 比较各种释放方式的调用耗时，以及MemAvailable回升和RSS下降所需的时间
+void bench_release() {
+    const char* names[4] = { "anon-dontneed", "memfd-punch", "madv-free", "munmap" };
+    int meminfo_fd = open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+    int statm_fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    if (meminfo_fd < 0 || statm_fd < 0) {
+        printf("打开/proc/meminfo或/proc/self/statm失败: %s\n", strerror(errno));
+        if (meminfo_fd >= 0) close(meminfo_fd);
+        if (statm_fd >= 0) close(statm_fd);
+        return;
+    }
+    
+    // 默认1GB，可用内存不足时取可用内存的1/3
+    unsigned long long avail_kb = 0, rss_kb = 0;
+    bench_release_sample(meminfo_fd, statm_fd, &avail_kb, &rss_kb);
+    size_t bytes = (size_t)1 << 30;
+    if (avail_kb > 0 && avail_kb * 1024 / 3 < bytes) bytes = (size_t)(avail_kb * 1024 / 3);
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    bytes -= bytes % page_size;
+    
+    int saved_backing = ballast_backing;
+    int saved_fill = ballast_fill_mode;
+    bool saved_mlock = ballast_mlock;
+    ballast_fill_mode = FILL_TOUCH;
+    ballast_mlock = false;
+    
+    printf("\n== 压载释放基准测试 (%zu MB) ==\n", bytes >> 20);
+    printf("释放后每100us采样一次，最长等待1秒，超时记为\"-\"\n");
+    printf("%-14s %12s %12s %18s %16s\n", "方式", "调用(ms)", "调用(ms/GB)", "可用内存回升(ms)", "RSS下降(ms)");
+    
+    for (int c = 0; c < 4; c++) {
+        ballast_t b = {0};
+        char* buf = NULL;
+        unsigned long long avail_before = 0, rss_before = 0;
+        usleep(100000);
+        bench_release_sample(meminfo_fd, statm_fd, &avail_before, &rss_before);
+        if (c < 2) {
+            ballast_backing = c == 0 ? BALLAST_ANON : BALLAST_MEMFD;
+            if (!ballast_init(&b, bytes) || ballast_grow(&b, bytes) != bytes) {
+                printf("%-14s 准备压载区失败\n", names[c]);
+                ballast_destroy(&b);
+                continue;
+            }
+        } else {
+            buf = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (buf == MAP_FAILED) {
+                printf("映射测试缓冲区失败: %s\n", strerror(errno));
+                break;
+            }
+            for (size_t offset = 0; offset < bytes; offset += page_size) buf[offset] = (char)0xAA;
+        }
+        
+        // 等待填充后的统计稳定下来
+        usleep(100000);
+        unsigned long long avail0 = 0, rss0 = 0;
+        bench_release_sample(meminfo_fd, statm_fd, &avail0, &rss0);
+        
+        unsigned long long start = get_time_ns();
+        bool ok = true;
+        if (c < 2) {
+            ok = ballast_shrink(&b, bytes) == bytes;
+        } else if (c == 2) {
+#ifdef MADV_FREE
+            ok = madvise(buf, bytes, MADV_FREE) == 0;
+#else
+            ok = false;
+#endif
+        } else {
+            ok = munmap(buf, bytes) == 0;
+            buf = NULL;
+        }
+        double call_ms = (get_time_ns() - start) / 1e6;
+        if (!ok) {
+            printf("%-14s 释放失败: %s\n", names[c], strerror(errno));
+        } else {
+            // 回升/下降达到填充时变化量的90%视为完成
+            // (MemAvailable扣除了水位线等，填充时的下降量可能小于填充大小)
+            unsigned long long avail_goal_kb = avail_before > avail0 ? (avail_before - avail0) / 10 * 9 : 0;
+            unsigned long long rss_goal_kb = rss0 > rss_before ? (rss0 - rss_before) / 10 * 9 : 0;
+            double avail_ms = -1, rss_ms = -1;
+            while (get_time_ns() - start < 1000000000ULL && (avail_ms < 0 || rss_ms < 0)) {
+                unsigned long long avail = avail0, rss = rss0;
+                bench_release_sample(meminfo_fd, statm_fd, &avail, &rss);
+                double t = (get_time_ns() - start) / 1e6;
+                if (avail_ms < 0 && avail >= avail0 + avail_goal_kb) avail_ms = t;
+                if (rss_ms < 0 && rss + rss_goal_kb <= rss0) rss_ms = t;
+                if (avail_ms < 0 || rss_ms < 0) usleep(100);
+            }
+            char avail_str[16] = "-", rss_str[16] = "-";
+            if (avail_ms >= 0) snprintf(avail_str, sizeof(avail_str), "%.2f", avail_ms);
+            if (rss_ms >= 0) snprintf(rss_str, sizeof(rss_str), "%.2f", rss_ms);
+            printf("%-14s %12.2f %12.2f %18s %16s\n", names[c], call_ms,
+                   call_ms * (double)(1ULL << 30) / bytes, avail_str, rss_str);
+        }
+        
+        if (c < 2) ballast_destroy(&b);
+        else if (buf) munmap(buf, bytes);
+    }
+    
+    ballast_backing = saved_backing;
+    ballast_fill_mode = saved_fill;
+    ballast_mlock = saved_mlock;
+    close(meminfo_fd);
+    close(statm_fd);
+}
+
+// PWM调度基准测试: 单个工作线程
+typedef struct {
+    worker_t* worker;
+    int legacy;                       // 1表示原来基于usleep的相对睡眠调度
+    double duty;
+    unsigned long long cpu_ns;        // 线程消耗的CPU时间
+    unsigned long long wall_ns;       // 线程运行的墙钟时间
+} pwm_bench_thread_t;
+
+// 原来的调度方式: 忙等后usleep剩余时间，用于对比
+void bench_pwm_legacy_loop(worker_t* worker, double duty, unsigned long long period_ns) {
+    unsigned long long expected = get_time_ns();
+    while (!atomic_load_explicit(&worker->stop, memory_order_relaxed)) {
+        unsigned long long start = get_time_ns();
+        if (start > expected) {
+            unsigned long long late = start - expected;
+            counter_add(&worker->late_ns_sum, late);
+            counter_max(&worker->late_ns_max, late);
+        }
+        
+        unsigned long long work_ns = (unsigned long long)(duty * period_ns);
+        unsigned long long now;
+        do {
+            spinCPU(1000);
+            now = get_time_ns();
+        } while (now - start < work_ns);
+        counter_add(&worker->busy_ns_sum, now - start);
+        
+        long long sleep_us = (long long)(period_ns - (now - start)) / 1000;
+        if (sleep_us > 100) {
+            usleep(sleep_us);
+        }
+        expected = start + period_ns;
+        atomic_fetch_add_explicit(&worker->cycles, 1, memory_order_relaxed);
+    }
+}
+
+void* bench_pwm_thread(void* arg) {
+    pwm_bench_thread_t* bench = (pwm_bench_thread_t*)arg;
+    struct timespec cpu_start, cpu_end;
+    
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+    unsigned long long wall_start = get_time_ns();
+    
+    if (bench->legacy) {
+        worker_cmd_t cmd;
+        worker_read_cmd(bench->worker, &cmd);
+        bench_pwm_legacy_loop(bench->worker, bench->duty, cmd.period_ns);
+    } else {
+        worker_run(bench->worker);
     }
     
-    ULARGE_INTEGER now_kernel, now_user, now_system;
-    now_kernel.LowPart = kernel_time.dwLowDateTime;
-    now_kernel.HighPart = kernel_time.dwHighDateTime;
-    now_user.LowPart = user_time.dwLowDateTime;
-    now_user.HighPart = user_time.dwHighDateTime;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+    bench->wall_ns = get_time_ns() - wall_start;
+    bench->cpu_ns = (unsigned long long)(cpu_end.tv_sec - cpu_start.tv_sec) * 1000000000ULL +
+                    (unsigned long long)(cpu_end.tv_nsec - cpu_start.tv_nsec);
+    return NULL;
+}
+
+// PWM调度基准测试: 不同周期、调度方式和相位错开下的唤醒抖动与占空比误差
+void bench_pwm() {
+    const long long periods_us[] = { 1000, 5000, 20000 };
+    const double duty = 0.5;
+    const unsigned long long round_ns = 1500000000ULL;
+    int count = num_cpu_cores;
+    
+    printf("\n== PWM调度基准测试 (%d 个工作线程, 占空比 %.0f%%, 每轮 %.1f 秒) ==\n",
+           count, duty * 100, round_ns / 1e9);
+    printf("%-10s %-10s %-6s %12s %12s %10s %12s %12s\n",
+           "周期(us)", "调度", "错开", "唤醒均值(us)", "唤醒最大(us)", "错过周期",
+           "实际CPU(%)", "占空比误差");
+    
+    worker_t* bench_workers = alloc_workers(count);
+    pwm_bench_thread_t* threads = (pwm_bench_thread_t*)calloc(count, sizeof(pwm_bench_thread_t));
+    pthread_t* handles = (pthread_t*)malloc(count * sizeof(pthread_t));
+    if (!bench_workers || !threads || !handles) {
+        printf("内存分配失败\n");
+        free_cache_aligned(bench_workers);
+        free(threads);
+        free(handles);
+        return;
+    }
     
-    ULARGE_INTEGER now_time;
-    now_time.QuadPart = now_kernel.QuadPart + now_user.QuadPart;
+    long long saved_period = cycle_period_us;
+    bool saved_stagger = phase_stagger;
     
-    FILETIME sys_idle_time, sys_kernel_time, sys_user_time;
-    if (!GetSystemTimes(&sys_idle_time, &sys_kernel_time, &sys_user_time)) {
-        return 0.0;
+    for (size_t p = 0; p < sizeof(periods_us) / sizeof(periods_us[0]); p++) {
+        // 0: 原来的usleep调度, 1: 绝对截止时间, 2: 绝对截止时间 + 相位错开
+        for (int mode = 0; mode < 3; mode++) {
+            cycle_period_us = periods_us[p];
+            phase_stagger = (mode == 2);
+            pwm_epoch_ns = get_time_ns();
+            
+            memset(bench_workers, 0, count * sizeof(worker_t));
+            int started = 0;
+            for (int i = 0; i < count; i++) {
+                worker_cmd_t cmd = make_worker_cmd(i, count, duty);
+                worker_publish_cmd(&bench_workers[i], &cmd);
+                threads[i].worker = &bench_workers[i];
+                threads[i].legacy = (mode == 0);
+                threads[i].duty = duty;
+                if (pthread_create(&handles[i], NULL, bench_pwm_thread, &threads[i]) != 0) break;
+                started++;
+            }
+            
+            usleep(round_ns / 1000);
+            for (int i = 0; i < started; i++) {
+                atomic_store(&bench_workers[i].stop, 1);
+            }
+            
+            unsigned long long cycles = 0, late_sum = 0, late_max = 0, missed = 0;
+            double cpu_share = 0.0;
+            for (int i = 0; i < started; i++) {
+                pthread_join(handles[i], NULL);
+                cycles += atomic_load(&bench_workers[i].cycles);
+                late_sum += atomic_load(&bench_workers[i].late_ns_sum);
+                if (atomic_load(&bench_workers[i].late_ns_max) > late_max) late_max = atomic_load(&bench_workers[i].late_ns_max);
+                missed += atomic_load(&bench_workers[i].missed_cycles);
+                if (threads[i].wall_ns > 0) {
+                    cpu_share += (double)threads[i].cpu_ns / threads[i].wall_ns;
+                }
+            }
+            if (started > 0) cpu_share /= started;
+            
+            printf("%-10lld %-10s %-6s %12.1f %12.1f %10llu %12.1f %+12.1f\n",
+                   periods_us[p], mode == 0 ? "usleep" : "abstime", mode == 2 ? "是" : "否",
+                   cycles ? late_sum / 1000.0 / cycles : 0.0, late_max / 1000.0, missed,
+                   cpu_share * 100, (cpu_share - duty) * 100);
+        }
+    }
+    
+    cycle_period_us = saved_period;
+    phase_stagger = saved_stagger;
+    free_cache_aligned(bench_workers);
+    free(threads);
+    free(handles);
+}
+#endif
+
+// 控制器闭环模拟场景: 外部负载(CPU为各核心使用率，内存为占总内存的百分比)随时间变化
+typedef struct {
+    const char* name;
+    const char* description;
+    double duration;      // 模拟时长(秒)
+    double event_time;    // 扰动发生时刻(秒)，指标从此刻开始统计
+    double before;        // 扰动前的外部负载(%)
+    double after;         // 扰动后的外部负载(%)
+    double ramp;          // 线性过渡时长(秒)，0为阶跃
+    double noise;         // 测量噪声/页缓存波动幅度(%)
+    double skew;          // 第一个核心额外的外部负载(%)，模拟负载分布不均
+    const char* target_profile; // 目标曲线，为NULL时使用固定目标
+    const double* trace_time; // 轨迹回放: 各点时刻(秒)，为NULL时使用上面的参数
+    const double* trace_load; // 轨迹回放: 各点的外部负载(%)
+    int trace_len;
+} sim_scenario_t;
+
+// 单个场景的统计结果
+typedef struct {
+    double settle;        // 调节时间(秒)，误差最后一次超出容差带的时刻，-1表示未稳定
+    double overshoot;     // 第一次穿越目标后反方向的最大误差(%)
+    double steady_error;  // 最后25%时间内的平均绝对误差(%)
+    double effort;        // 控制输出的累计变化量: CPU为各核心平均繁忙比例变化的绝对值之和，内存为压载变化占总量的比例之和(%)
+    double lag;           // 跟踪滞后(秒)，负值表示实际使用率领先设定值
+    bool tracking;        // 设定值是否移动过，固定目标时lag无意义
+} sim_result_t;
+
+// 模拟使用的确定性随机数，每个场景开始时重置
+uint64_t sim_rng_state = 0;
+
+// 返回[-1, 1]之间的均匀随机数
+double sim_noise() {
+    sim_rng_state += 0x9E3779B97F4A7C15ULL;
+    return (double)(splitmix64(sim_rng_state) >> 11) / (double)(1ULL << 52) - 1.0;
+}
+
+// 场景在t时刻的外部负载
+double sim_external_load(const sim_scenario_t* sc, double t) {
+    if (sc->trace_len > 0) {
+        // 取t时刻之前最近的一个轨迹点
+        int lo = 0, hi = sc->trace_len - 1;
+        while (lo < hi) {
+            int mid = (lo + hi + 1) / 2;
+            if (sc->trace_time[mid] <= t) lo = mid; else hi = mid - 1;
+        }
+        return sc->trace_load[lo];
+    }
+    if (t < sc->event_time) return sc->before;
+    if (sc->ramp > 0 && t < sc->event_time + sc->ramp) {
+        return sc->before + (sc->after - sc->before) * (t - sc->event_time) / sc->ramp;
+    }
+    return sc->after;
+}
+
+// 累计一个采样点的误差，用于计算调节时间、超调和稳态误差
+typedef struct {
+    double band;          // 容差带(%)
+    int initial_sign;     // 扰动后第一个超出容差带的误差方向
+    bool crossed;         // 是否已经穿越目标
+    double steady_sum;
+    int steady_count;
+    double prev_target;   // 上一个采样点的设定值，NAN表示尚无
+    double lag_cross;     // 误差与设定值变化率乘积之和
+    double lag_slope_sq;  // 设定值变化率平方和
+} sim_tracker_t;
+
+// 记录t时刻的误差(实际值 - 目标值)
+void sim_track(sim_tracker_t* tr, sim_result_t* r, const sim_scenario_t* sc, double t, double error) {
+    if (t < sc->event_time) return;
+    if (fabs(error) > tr->band) {
+        r->settle = t - sc->event_time;
+        if (tr->initial_sign == 0) tr->initial_sign = error > 0 ? 1 : -1;
+    }
+    if (tr->initial_sign != 0 && error * tr->initial_sign < 0) tr->crossed = true;
+    if (tr->crossed && -error * tr->initial_sign > r->overshoot) {
+        r->overshoot = -error * tr->initial_sign;
+    }
+    if (t >= sc->duration * 0.75) {
+        tr->steady_sum += fabs(error);
+        tr->steady_count++;
+    }
+}
+
+// 累计设定值移动期间的跟踪误差；误差 ≈ -滞后 × 变化率，按最小二乘拟合滞后
+// 模拟中误差取真实使用率而不是控制器的在线估计，领先时得到负值而不是被截到0
+void sim_track_lag(sim_tracker_t* tr, double dt, double target, double error) {
+    if (!isnan(tr->prev_target)) {
+        double slope = (target - tr->prev_target) / dt;
+        if (fabs(slope) > 0.005) {
+            tr->lag_cross += error * slope;
+            tr->lag_slope_sq += slope * slope;
+        }
+    }
+    tr->prev_target = target;
+}
+
+// 结束统计；最后一个点仍在容差带外时视为未稳定
+void sim_finish(sim_tracker_t* tr, sim_result_t* r, const sim_scenario_t* sc, double dt) {
+    if (r->settle >= sc->duration - sc->event_time - dt * 1.5) r->settle = -1;
+    r->steady_error = tr->steady_count > 0 ? tr->steady_sum / tr->steady_count : 0.0;
+    r->tracking = tr->lag_slope_sq > 0;
+    r->lag = r->tracking ? -tr->lag_cross / tr->lag_slope_sq : 0.0;
+}
+
+// CPU控制器模拟: 4个核心，目标50%，每150ms一步
+// 工作线程按下发的占空比获得CPU，外部负载与工作线程之和超过100%时按比例分享
+sim_result_t sim_cpu_scenario(const sim_scenario_t* sc) {
+    const int cores = 4;
+    const double dt = 0.15;
+    double target = 50.0;
+    sim_result_t r = {0};
+    sim_tracker_t tr = { 2.0, 0, false, 0.0, 0, NAN, 0.0, 0.0 };
+    sim_rng_state = 1;
+    
+    memset(&cpu_lag, 0, sizeof(cpu_lag));
+    if (sc->target_profile) {
+        parse_target_profile(&cpu_profile, sc->target_profile);
+        target = profile_value(&cpu_profile, 0.0);
     }
     
-    ULARGE_INTEGER sys_kernel, sys_user;
-    sys_kernel.LowPart = sys_kernel_time.dwLowDateTime;
-    sys_kernel.HighPart = sys_kernel_time.dwHighDateTime;
-    sys_user.LowPart = sys_user_time.dwLowDateTime;
-    sys_user.HighPart = sys_user_time.dwHighDateTime;
-    
-    now_system.QuadPart = sys_kernel.QuadPart + sys_user.QuadPart;
-    
-    if (last_time.QuadPart == 0) {
-        last_time = now_time;
-        last_system_time = now_system;
-        return 0.0;
+    for (int i = 0; i < cores; i++) {
+        memset(&core_ctrls[i], 0, sizeof(core_ctrl_t));
+        core_ctrls[i].cpu_id = i;
+        core_ctrls[i].target = target;
+        atomic_store(&workers[i].cpu_ns, 0);
+        atomic_store(&workers[i].cmd_ns_sum, 0);
     }
-    
-    ULONGLONG time_diff = now_time.QuadPart - last_time.QuadPart;
-    ULONGLONG system_diff = now_system.QuadPart - last_system_time.QuadPart;
-    
-    last_time = now_time;
-    last_system_time = now_system;
-    
-    if (system_diff == 0) return 0.0;
-    
-    // 修复CPU使用率计算，不除以核心数，这样得到的是进程使用的总CPU百分比
-    // 系统总CPU使用率计算没有除以核心数，所以这里也保持一致
-    double cpu_usage = (double)(time_diff * 100.0) / system_diff;
-    
-    // 限制在合理范围内
-    if (isnan(cpu_usage) || cpu_usage < 0) {
-        return 0.0;
+    cpu_controller_reset();
+    
+    // 每个核心的工作线程上一区间下发的繁忙比例和实际消耗
+    double busy[4] = {0};
+    double t = 0.0, interval = 1.0; // 第一个区间为1秒预热
+    bool started = false;
+    while (t < sc->duration) {
+        // 工作线程在区间内执行上一次下发的占空比
+        double total = 0.0, actual = 0.0;
+        for (int i = 0; i < cores; i++) {
+            double external = sim_external_load(sc, t) + (i == 0 ? sc->skew : 0.0);
+            if (external > 100) external = 100;
+            double own = busy[i];
+            if (external + own > 100) {
+                own = own * 100.0 / (external + own);
+                external = 100.0 - own;
+            }
+            atomic_fetch_add(&workers[i].cpu_ns, (unsigned long long)(own / 100.0 * interval * 1e9));
+            atomic_fetch_add(&workers[i].cmd_ns_sum, (unsigned long long)(busy[i] / 100.0 * interval * 1e9));
+            
+            double usage = external + own + sc->noise * sim_noise();
+            if (usage < 0) usage = 0;
+            if (usage > 100) usage = 100;
+            core_ctrls[i].usage = usage;
+            total += usage;
+            actual += external + own;
+        }
+        t += interval;
+        if (cpu_profile.kind != PROFILE_NONE) {
+            cpu_profile_update(t, total / cores);
+            target = get_overall_cpu_target();
+        }
+        sim_track(&tr, &r, sc, t, actual / cores - target);
+        sim_track_lag(&tr, interval, target, actual / cores - target);
+        
+        if (!started) {
+            cpu_controller_start(total / cores, interval * 1e9);
+            started = true;
+        } else {
+            cpu_controller_step(total / cores, interval * 1e9);
+        }
+        
+        // 每一次下发的变化都计入，斜坡跟踪中的小步调整也不会被漏掉
+        for (int i = 0; i < cores; i++) {
+            r.effort += fabs(core_ctrls[i].busy - busy[i]) / cores;
+            busy[i] = core_ctrls[i].busy;
+        }
+        interval = dt;
     }
-    if (cpu_usage > 100.0) {
-        return 100.0;
+    sim_finish(&tr, &r, sc, dt);
+    free_target_profile(&cpu_profile);
+    return r;
+}
+
+// 内存控制器模拟: 16 GB主机，目标60%，每秒一步；压载区只记账
+// 页缓存波动以噪声形式叠加在已用内存上
+sim_result_t sim_memory_scenario(const sim_scenario_t* sc) {
+    const unsigned long long total_kb = 16ULL * 1024 * 1024;
+    const double dt = 1.0;
+    sim_result_t r = {0};
+    sim_tracker_t tr = { 2.0, 0, false, 0.0, 0, NAN, 0.0, 0.0 };
+    sim_rng_state = 2;
+    
+    mem_target.kind = MEM_TARGET_PERCENT;
+    mem_target.value = 60.0;
+    memset(&mem_lag, 0, sizeof(mem_lag));
+    if (sc->target_profile) parse_target_profile(&mem_profile, sc->target_profile);
+    memset(&mem_ctrl, 0, sizeof(mem_ctrl));
+    filtered_mem_usage = 0.0;
+    memset(&ballast, 0, sizeof(ballast));
+    ballast.simulated = true;
+    ballast.page_size = 4096;
+    ballast.reserved = (size_t)total_kb * 1024;
+    
+    proc_snapshot_t snap;
+    memset(&snap, 0, sizeof(snap));
+    snap.mem_total_kb = total_kb;
+    
+    for (double t = dt; t <= sc->duration; t += dt) {
+        double external_kb = sim_external_load(sc, t) * total_kb / 100.0;
+        double churn_kb = sc->noise * sim_noise() * total_kb / 100.0;
+        double used_kb = external_kb + churn_kb + ballast.size / 1024.0;
+        if (used_kb > total_kb) used_kb = total_kb;
+        if (used_kb < 0) used_kb = 0;
+        
+        snap.seq++;
+        snap.timestamp = t;
+        snap.mem_available_kb = total_kb - (unsigned long long)used_kb;
+        snap.mem_free_kb = snap.mem_available_kb;
+        snap.mem_usage = used_kb * 100.0 / total_kb;
+        snap.self_rss_kb = ballast.size / 1024;
+        double target = mem_profile.kind != PROFILE_NONE ? profile_value(&mem_profile, t) : 60.0;
+        sim_track(&tr, &r, sc, t, snap.mem_usage - target);
+        sim_track_lag(&tr, dt, target, snap.mem_usage - target);
+        
+        size_t before = ballast.size;
+        memory_controller_step(&snap, t);
+        double change = ballast.size > before ? (double)(ballast.size - before) : (double)(before - ballast.size);
+        r.effort += change * 100.0 / ((double)total_kb * 1024.0);
     }
-    
-    return cpu_usage;
-#else    // Linux实现 - 使用/proc/self/stat获取更准确的数据
-    static unsigned long long last_utime = 0, last_stime = 0;
-    static unsigned long long last_total_time = 0;
-    
-    // 获取系统总时间
-    FILE* fp = fopen("/proc/stat", "r");
-    if (fp == NULL) return 0.0;
-    
-    char buffer[1024];
-    if (fgets(buffer, sizeof(buffer), fp) == NULL) {
-        fclose(fp);
-        return 0.0;
+    sim_finish(&tr, &r, sc, dt);
+    free_target_profile(&mem_profile);
+    return r;
+}
+
+// 轨迹中的外部负载序列
+typedef struct {
+    double* time;         // 相对第一次采样的时刻(秒)
+    double* cpu;          // 整体CPU使用率减去录制进程自身的份额(%)
+    double* mem;          // 内存使用率减去录制进程的RSS(%)
+    int len;
+} trace_series_t;
+
+// 从轨迹文件提取外部负载序列，相邻两次采样得到一个点
+bool trace_load_series(const char* path, trace_series_t* ts) {
+    memset(ts, 0, sizeof(*ts));
+    FILE* fp = trace_open(path);
+    if (!fp) return false;
+    
+    proc_raw_t raw;
+    memset(&raw, 0, sizeof(raw));
+    unsigned long long prev_idle = 0, prev_total = 0, prev_self = 0;
+    double start = 0.0;
+    int capacity = 0;
+    bool first = true;
+    bool ok = true;
+    while (trace_read_record(fp, &raw)) {
+        if (first) {
+            start = raw.time;
+        } else if (raw.cpu_total > prev_total) {
+            if (ts->len == capacity) {
+                capacity = capacity ? capacity * 2 : 256;
+                double* time = (double*)realloc(ts->time, capacity * sizeof(double));
+                if (time) ts->time = time;
+                double* cpu = (double*)realloc(ts->cpu, capacity * sizeof(double));
+                if (cpu) ts->cpu = cpu;
+                double* mem = (double*)realloc(ts->mem, capacity * sizeof(double));
+                if (mem) ts->mem = mem;
+                if (!time || !cpu || !mem) {
+                    printf("内存分配失败\n");
+                    ok = false;
+                    break;
+                }
+            }
+            double total = (double)(raw.cpu_total - prev_total);
+            double cpu = 100.0 * (1.0 - (double)(raw.cpu_idle - prev_idle) / total) -
+                         100.0 * (double)(raw.self_time - prev_self) / total;
+            double mem = 0.0;
+            if (raw.mem_total_kb > 0) {
+                mem = ((double)raw.mem_total_kb - (double)raw.mem_available_kb - (double)raw.self_rss_kb) *
+                      100.0 / raw.mem_total_kb;
+            }
+            ts->time[ts->len] = raw.time - start;
+            ts->cpu[ts->len] = cpu < 0 ? 0 : (cpu > 100 ? 100 : cpu);
+            ts->mem[ts->len] = mem < 0 ? 0 : (mem > 100 ? 100 : mem);
+            ts->len++;
+        }
+        prev_idle = raw.cpu_idle;
+        prev_total = raw.cpu_total;
+        prev_self = raw.self_time;
+        first = false;
     }
+    proc_raw_free(&raw);
     fclose(fp);
     
-    unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
-    sscanf(buffer, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", 
-           &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal);
-    
-    unsigned long long total_time = user + nice + system + idle + iowait + irq + softirq + steal;
-    
-    // 获取进程CPU时间
-    fp = fopen("/proc/self/stat", "r");
-    if (fp == NULL) return 0.0;
-    
-    if (fgets(buffer, sizeof(buffer), fp) == NULL) {
-        fclose(fp);
-        return 0.0;
+    if (ok && ts->len < 2) {
+        printf("轨迹文件中的采样太少: %s\n", path);
+        ok = false;
     }
-    fclose(fp);
-    
-    // 解析/proc/self/stat获取utime和stime (字段14和15)
-    char* p = buffer;
-    for (int i = 0; i < 13; i++) {
-        p = strchr(p + 1, ' ');
-        if (!p) return 0.0;
+    if (!ok) {
+        free(ts->time);
+        free(ts->cpu);
+        free(ts->mem);
+        memset(ts, 0, sizeof(*ts));
     }
-    
-    unsigned long long utime, stime;
-    if (sscanf(p, " %llu %llu", &utime, &stime) != 2) {
-        return 0.0;
+    return ok;
+}
+
+// 输出一行模拟结果
+void sim_print_result(const char* kind, const sim_scenario_t* sc, const sim_result_t* r) {
+    char settle[16], lag[16];
+    if (r->settle < 0) {
+        snprintf(settle, sizeof(settle), "未稳定");
+    } else {
+        snprintf(settle, sizeof(settle), "%.2f", r->settle);
     }
-    
-    unsigned long long process_time = utime + stime;
-    
-    // 首次调用，初始化基准值
-    if (last_utime == 0 || last_total_time == 0) {
-        last_utime = utime;
-        last_stime = stime;
-        last_total_time = total_time;
-        return 0.0;
+    if (!r->tracking) {
+        snprintf(lag, sizeof(lag), "-");
+    } else {
+        snprintf(lag, sizeof(lag), "%.2f", r->lag);
     }
-    
-    // 计算使用率: 进程时间变化 / 系统总时间变化 * 100
-    unsigned long long process_time_diff = process_time - (last_utime + last_stime);
-    unsigned long long total_time_diff = total_time - last_total_time;
-    
-    // 更新历史值
-    last_utime = utime;
-    last_stime = stime;
-    last_total_time = total_time;
-    
-    if (total_time_diff == 0) return 0.0;
-    
-    double cpu_usage = (double)process_time_diff * 100.0 / total_time_diff;
-    
-    // 限制在合理范围内
-    if (isnan(cpu_usage) || cpu_usage < 0) {
-        return 0.0;
+    printf("%-4s %-10s %12s %10.2f %12.2f %12.1f %8s  %s\n",
+           kind, sc->name, settle, r->overshoot, r->steady_error, r->effort, lag, sc->description);
+}
+
+// 控制器基准测试: 用确定性的模拟负载驱动CPU和内存控制器，快于实时运行
+// 报告调节时间、超调、稳态误差和控制输出累计变化量(容差带±2%)
+void bench_controller() {
+    static const sim_scenario_t cpu_scenarios[] = {
+        { .name = "startup",   .description = "外部负载10%，从空载启动",
+          .duration = 20,  .event_time = 0,  .before = 10, .after = 10 },
+        { .name = "step-up",   .description = "外部负载10%→40%阶跃",
+          .duration = 30,  .event_time = 10, .before = 10, .after = 40 },
+        { .name = "step-down", .description = "外部负载40%→5%阶跃",
+          .duration = 30,  .event_time = 10, .before = 40, .after = 5 },
+        { .name = "ramp",      .description = "外部负载0%→40%，10秒线性上升",
+          .duration = 40,  .event_time = 10, .before = 0,  .after = 40, .ramp = 10 },
+        { .name = "noise",     .description = "外部负载20%，测量噪声±8%",
+          .duration = 30,  .event_time = 10, .before = 20, .after = 20, .noise = 8.0 },
+        { .name = "skew",      .description = "cpu0额外外部负载70%",
+          .duration = 30,  .event_time = 10, .before = 10, .after = 10, .skew = 70 },
+        { .name = "ramp-tgt",  .description = "目标20%→80%，30秒线性上升",
+          .duration = 40,  .event_time = 0,  .before = 10, .after = 10, .target_profile = "ramp:20:80:30" },
+        { .name = "sine-tgt",  .description = "目标30%~70%正弦，周期60秒",
+          .duration = 120, .event_time = 0,  .before = 10, .after = 10, .target_profile = "sine:30:70:60" },
+    };
+    static const sim_scenario_t mem_scenarios[] = {
+        { .name = "startup",   .description = "外部占用20%，从零压载启动",
+          .duration = 120,  .event_time = 0,  .before = 20, .after = 20 },
+        { .name = "step-up",   .description = "外部占用20%→35%阶跃",
+          .duration = 180,  .event_time = 60, .before = 20, .after = 35 },
+        { .name = "step-down", .description = "外部占用35%→15%阶跃",
+          .duration = 180,  .event_time = 60, .before = 35, .after = 15 },
+        { .name = "churn",     .description = "外部占用25%，页缓存波动±1.5%",
+          .duration = 180,  .event_time = 60, .before = 25, .after = 25, .noise = 1.5 },
+        { .name = "ramp-tgt",  .description = "目标30%→70%，300秒线性上升",
+          .duration = 400,  .event_time = 0,  .before = 20, .after = 20, .target_profile = "ramp:30:70:300" },
+        { .name = "sine-tgt",  .description = "目标40%~70%正弦，周期600秒",
+          .duration = 1200, .event_time = 0,  .before = 20, .after = 20, .target_profile = "sine:40:70:600" },
+    };
+    
+    // 模拟期间替换核心控制状态和压载区，结束后恢复
+    int saved_cores = num_cpu_cores;
+    core_ctrl_t* saved_ctrls = core_ctrls;
+    worker_t* saved_workers = workers;
+    ballast_t saved_ballast = ballast;
+    int saved_target_mem = target_mem_usage_mb;
+    mem_target_t saved_mem_target = mem_target;
+    double saved_share_scale = cpu_share_scale;
+    cpu_share_scale = 1.0;
+    target_profile_t saved_cpu_profile = cpu_profile;
+    target_profile_t saved_mem_profile = mem_profile;
+    int saved_groups = num_cpu_groups;
+    bool saved_verbose = verbose_mode;
+    verbose_mode = false;
+    
+    memset(&cpu_profile, 0, sizeof(cpu_profile));
+    memset(&mem_profile, 0, sizeof(mem_profile));
+    num_cpu_groups = 0;
+    num_cpu_cores = 4;
+    core_ctrls = (core_ctrl_t*)calloc(num_cpu_cores, sizeof(core_ctrl_t));
+    workers = alloc_workers(num_cpu_cores);
+    if (!core_ctrls || !workers) {
+        printf("内存分配失败\n");
+    } else {
+        printf("\n== 控制器闭环模拟 (CPU: 4核心/目标50%%/150ms; 内存: 16 GB/目标60%%/1s; 容差带±2%%) ==\n");
+        printf("%-4s %-10s %12s %10s %12s %12s %8s  %s\n",
+               "类型", "场景", "调节时间(s)", "超调(%)", "稳态误差(%)", "累计调整(%)", "滞后(s)", "说明");
+        for (size_t i = 0; i < sizeof(cpu_scenarios) / sizeof(cpu_scenarios[0]); i++) {
+            sim_result_t r = sim_cpu_scenario(&cpu_scenarios[i]);
+            sim_print_result("CPU", &cpu_scenarios[i], &r);
+        }
+        for (size_t i = 0; i < sizeof(mem_scenarios) / sizeof(mem_scenarios[0]); i++) {
+            sim_result_t r = sim_memory_scenario(&mem_scenarios[i]);
+            sim_print_result("MEM", &mem_scenarios[i], &r);
+        }
+        
+        // 指定--replay时，用录制的外部负载驱动控制器，按模拟步长加速回放
+        trace_series_t ts;
+        if (replay_file[0] && trace_load_series(replay_file, &ts)) {
+            sim_scenario_t sc;
+            memset(&sc, 0, sizeof(sc));
+            sc.name = "trace";
+            sc.description = replay_file;
+            sc.duration = ts.time[ts.len - 1];
+            sc.trace_time = ts.time;
+            sc.trace_len = ts.len;
+            sc.trace_load = ts.cpu;
+            sim_result_t r = sim_cpu_scenario(&sc);
+            sim_print_result("CPU", &sc, &r);
+            sc.trace_load = ts.mem;
+            r = sim_memory_scenario(&sc);
+            sim_print_result("MEM", &sc, &r);
+            free(ts.time);
+            free(ts.cpu);
+            free(ts.mem);
+        }
     }
-    // 多核系统下，进程CPU使用率可能超过100%
-    if (cpu_usage > 100.0 * num_cpu_cores) {
-        return 100.0 * num_cpu_cores;
+    
+    free(core_ctrls);
+    free_cache_aligned(workers);
+    num_cpu_cores = saved_cores;
+    core_ctrls = saved_ctrls;
+    workers = saved_workers;
+    ballast = saved_ballast;
+    target_mem_usage_mb = saved_target_mem;
+    mem_target = saved_mem_target;
+    cpu_share_scale = saved_share_scale;
+    cpu_profile = saved_cpu_profile;
+    mem_profile = saved_mem_profile;
+    num_cpu_groups = saved_groups;
+    verbose_mode = saved_verbose;
+    filtered_cpu_usage = 0.0;
+    filtered_mem_usage = 0.0;
+    memset(&mem_ctrl, 0, sizeof(mem_ctrl));
+}
+
+// 工作线程热路径直方图的记录开销: 每个周期记录3次(唤醒过冲、周期延迟、CPU差额)
+void bench_hist() {
+    const unsigned long long iterations = 20000000;
+    worker_t* worker = alloc_workers(1);
+    if (!worker) {
+        printf("内存分配失败\n");
+        return;
     }
     
-    return cpu_usage;
-#endif
+    // 值覆盖0到约1ms，落在不同的桶里
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+    unsigned long long start = get_time_ns();
+    for (unsigned long long i = 0; i < iterations; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        worker_hist_record(&worker->wake_hist, x & 0xFFFFF);
+    }
+    unsigned long long elapsed = get_time_ns() - start;
+    
+    double per_record = (double)elapsed / iterations;
+    double per_cycle = per_record * 3;
+    printf("\n== 工作线程直方图记录开销 ==\n");
+    printf("每次记录: %.2f ns, 每个周期(3次): %.1f ns, 占 %lld us 周期的 %.5f%%\n",
+           per_record, per_cycle, cycle_period_us, per_cycle * 100.0 / (cycle_period_us * 1000.0));
+    free_cache_aligned(worker);
 }
 
-// 获取CMM自身的内存使用量（MB）
-unsigned long long get_self_memory_usage_mb() {
+// 运行基准测试，name为测试名称或"all"
+int run_benchmark(const char* name) {
+    bool all = strcmp(name, "all") == 0;
+    bool matched = false;
+    
+    // 控制器模拟不依赖平台
+    if (all || strcmp(name, "controller") == 0) {
+        bench_controller();
+        matched = true;
+    }
+    if (all || strcmp(name, "hist") == 0) {
+        bench_hist();
+        matched = true;
+    }
 #ifdef _WIN32
-    PROCESS_MEMORY_COUNTERS_EX pmc;
-    HANDLE process = GetCurrentProcess();
-    
-    if (!GetProcessMemoryInfo(process, (PROCESS_MEMORY_COUNTERS*)&pmc, sizeof(pmc))) {
-        return 0;
+    if (!matched) {
+        printf("该基准测试仅支持Linux: %s\n", name);
+        return 1;
     }
-    
-    return (unsigned long long)pmc.WorkingSetSize / (1024 * 1024);
+    return 0;
 #else
-    // Linux实现
-    FILE* file = fopen("/proc/self/status", "r");
-    if (file == NULL) {
-        return 0;
-    }
-    
-    unsigned long vmsize = 0;
-    char line[128];
     
-    while (fgets(line, 128, file) != NULL) {
-        if (strncmp(line, "VmRSS:", 6) == 0) {
-            sscanf(line, "VmRSS: %lu", &vmsize);
-            break;
-        }
+    if (all || strcmp(name, "sync") == 0) {
+        bench_sync();
+        matched = true;
+    }
+    if (all || strcmp(name, "pwm") == 0) {
+        bench_pwm();
+        matched = true;
+    }
+    if (all || strcmp(name, "kernels") == 0) {
+        bench_kernels();
+        matched = true;
+    }
+    if (all || strcmp(name, "fill") == 0) {
+        bench_fill();
+        matched = true;
+    }
+    if (all || strcmp(name, "release") == 0) {
+        bench_release();
+        matched = true;
     }
     
-    fclose(file);
-    return vmsize / 1024; // VmRSS以KB为单位，转换为MB
+    if (!matched) {
+        printf("未知的基准测试: %s\n", name);
+        return 1;
+    }
+    return 0;
 #endif
 }
 
@@ -1439,38 +6788,66 @@ int main(int argc, char *argv[]) {
 #ifdef _WIN32
     // Windows设置UTF-8输出
     SetConsoleOutputCP(65001);
-    // 初始化临界区
-    InitializeCriticalSection(&cpu_load_cs);
 #else
     // Linux设置本地化
     setlocale(LC_ALL, "");
-    // 初始化互斥锁
-    pthread_mutex_init(&cpu_load_mutex, NULL);
 #endif
     
     // 获取CPU核心数
     num_cpu_cores = get_cpu_cores();
     
-    // 参数解析
+    // 帮助和终止其他进程不需要校准和采样，先行处理
     if (argc < 2) {
         print_usage();
         return 1;
     }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0) {
+            print_usage();
+            return 0;
+        } else if (strcmp(argv[i], "-k") == 0) {
+            return kill_all_cmm_processes() ? 0 : 1;
+        }
+    }
+    
+    // 根据CPUID选择内核实现并校准
+    init_burn_kernels();
+    init_fill_kernel();
+    
+    // 指标源参数先行处理: 采样器要在参数解析之前初始化，换算内存目标时需要总内存
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--proc-root") == 0) {
+            strncpy(proc_root, argv[++i], sizeof(proc_root) - 1);
+        } else if (strcmp(argv[i], "--replay") == 0) {
+            strncpy(replay_file, argv[++i], sizeof(replay_file) - 1);
+        } else if (strcmp(argv[i], "--record") == 0) {
+            strncpy(record_file, argv[++i], sizeof(record_file) - 1);
+        }
+    }
+    
+    // 初始化采样器，参数解析中换算内存目标时需要总内存
+    if (!sampler_init()) {
+        printf("采样器初始化失败\n");
+        return 1;
+    }
     
+    // 参数解析
     bool cpu_set = false;
     bool mem_set = false;
     bool load_config_specified = false;
+    const char* bench_name = NULL;
     
-    for (int i = 1; i < argc; i++) {        if (strcmp(argv[i], "-h") == 0) {
-            print_usage();
-            return 0;
-        } else if (strcmp(argv[i], "-v") == 0) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
             verbose_mode = true;
         } else if (strcmp(argv[i], "-d") == 0) {
             daemon_mode = true;
-        } else if (strcmp(argv[i], "-k") == 0) {
-            // 终止所有CMM进程
-            return kill_all_cmm_processes() ? 0 : 1;
+        } else if (strcmp(argv[i], "--stagger") == 0) {
+            phase_stagger = true;
+        } else if (strcmp(argv[i], "--mlock") == 0) {
+            ballast_mlock = true;
+        } else if (strcmp(argv[i], "--unmergeable") == 0) {
+            ballast_unmergeable = true;
         } else if (strcmp(argv[i], "-s") == 0) {
             save_config = true;
             if (i + 1 < argc && argv[i + 1][0] != '-') {
@@ -1478,7 +6855,16 @@ int main(int argc, char *argv[]) {
                 i++;
             }
         } else if (i + 1 < argc) {
-            if (strcmp(argv[i], "-l") == 0) {
+            if (strcmp(argv[i], "-B") == 0) {
+                // 基准测试在参数解析完成后运行，以便同时指定--replay等参数
+                bench_name = argv[i + 1];
+                i++;
+            } else if (strcmp(argv[i], "--proc-root") == 0 ||
+                       strcmp(argv[i], "--replay") == 0 ||
+                       strcmp(argv[i], "--record") == 0) {
+                // 已在初始化采样器前处理
+                i++;
+            } else if (strcmp(argv[i], "-l") == 0) {
                 if (!load_config(argv[i + 1])) {
                     return 1;
                 }
@@ -1495,16 +6881,152 @@ int main(int argc, char *argv[]) {
                 cpu_set = true;
                 i++;
             } else if (strcmp(argv[i], "-m") == 0) {
-                unsigned long long total_system_memory_mb = get_total_system_memory();
-                double mem_percent = atof(argv[i + 1]);
-                if (mem_percent < 0 || mem_percent > 100) {
-                    printf("内存使用率必须在0-100之间\n");
+                if (!parse_mem_target(argv[i + 1], &mem_target)) {
+                    printf("内存目标无效: %s (百分比0-100，如50；绝对值如64G；保留空闲如free:8G)\n", argv[i + 1]);
+                    return 1;
+                }
+                mem_set = true;
+                i++;
+            } else if (strcmp(argv[i], "--mem-node") == 0) {
+                if (!parse_mem_node_targets(argv[i + 1])) {
+                    return 1;
+                }
+                mem_set = true;
+                i++;
+            } else if (strcmp(argv[i], "--cpu-node") == 0) {
+                if (!parse_cpu_node_targets(argv[i + 1])) {
+                    return 1;
+                }
+                i++;
+            } else if (strcmp(argv[i], "--scope") == 0) {
+                if (!parse_target_scope(argv[i + 1])) {
+                    printf("目标范围无效: %s (auto、host或cgroup)\n", argv[i + 1]);
+                    return 1;
+                }
+                i++;
+            } else if (strcmp(argv[i], "--cgroup") == 0) {
+                snprintf(cgroup_dir, sizeof(cgroup_dir), "%s", argv[i + 1]);
+                i++;
+            } else if (strcmp(argv[i], "--numa") == 0) {
+                if (!parse_numa_policy(argv[i + 1])) {
+                    printf("NUMA策略无效: %s (local、interleave或bind:<节点列表>)\n", argv[i + 1]);
+                    return 1;
+                }
+                i++;
+            } else if (strcmp(argv[i], "--mem-rate") == 0) {
+                if (!parse_size(argv[i + 1], &mem_rate_bytes)) {
+                    printf("内存增长速率无效: %s (如2G，表示每秒2 GB；0为自动)\n", argv[i + 1]);
+                    return 1;
+                }
+                i++;
+            } else if (strcmp(argv[i], "--mem-floor") == 0) {
+                if (!parse_mem_floor(argv[i + 1])) {
+                    printf("可用内存下限无效: %s (百分比如2，或绝对值如512M；0为不启用)\n", argv[i + 1]);
+                    return 1;
+                }
+                i++;
+            } else if (strcmp(argv[i], "--period") == 0) {
+                cycle_period_us = atoll(argv[i + 1]);
+                if (cycle_period_us < 500 || cycle_period_us > 1000000) {
+                    printf("PWM周期必须在500-1000000微秒之间\n");
+                    return 1;
+                }
+                i++;
+            } else if (strcmp(argv[i], "--fill-threads") == 0) {
+                fill_threads = atoi(argv[i + 1]);
+                if (fill_threads < 1 || fill_threads > MAX_FILL_THREADS) {
+                    printf("压载填充线程数必须在1-%d之间\n", MAX_FILL_THREADS);
+                    return 1;
+                }
+                i++;
+            } else if (strcmp(argv[i], "--fill") == 0) {
+                if (strcmp(argv[i + 1], "random") == 0) {
+                    ballast_fill_mode = FILL_RANDOM;
+                } else if (strcmp(argv[i + 1], "touch") == 0) {
+                    ballast_fill_mode = FILL_TOUCH;
+                } else {
+                    printf("未知的压载填充方式: %s\n", argv[i + 1]);
+                    return 1;
+                }
+                i++;
+            } else if (strcmp(argv[i], "--ballast") == 0) {
+                if (strcmp(argv[i + 1], "anon") == 0) {
+                    ballast_backing = BALLAST_ANON;
+                } else if (strcmp(argv[i + 1], "memfd") == 0) {
+                    ballast_backing = BALLAST_MEMFD;
+                } else {
+                    printf("未知的压载内存来源: %s\n", argv[i + 1]);
+                    return 1;
+                }
+                i++;
+            } else if (strcmp(argv[i], "--mem-backoff") == 0) {
+                mem_backoff_stall_ms = atof(argv[i + 1]);
+                if (mem_backoff_stall_ms <= 0 || mem_backoff_stall_ms >= 500) {
+                    printf("内存释放阈值必须在0-500毫秒之间\n");
+                    return 1;
+                }
+                i++;
+            } else if (strcmp(argv[i], "--kernel") == 0) {
+                burn_kernel_index = find_burn_kernel(argv[i + 1]);
+                if (burn_kernel_index < 0) {
+                    printf("未知的CPU占用内核: %s\n", argv[i + 1]);
+                    return 1;
+                }
+                i++;
+            } else if (strcmp(argv[i], "--worker-sched") == 0) {
+                if (!parse_worker_sched(argv[i + 1])) {
+                    printf("未知的工作线程调度策略: %s (normal、idle或nice)\n", argv[i + 1]);
+                    return 1;
+                }
+                i++;
+            } else if (strcmp(argv[i], "--probe") == 0) {
+                probe_hz = atof(argv[i + 1]);
+                if (probe_hz < 0 || probe_hz > 1000) {
+                    printf("探针频率必须在0-1000 Hz之间\n");
+                    return 1;
+                }
+                i++;
+            } else if (strcmp(argv[i], "--backoff") == 0) {
+                backoff_stall_ms = atof(argv[i + 1]);
+                if (backoff_stall_ms <= 0 || backoff_stall_ms >= 500) {
+                    printf("退让阈值必须在0-500毫秒之间\n");
+                    return 1;
+                }
+                i++;
+            } else if (strcmp(argv[i], "--cpu-profile") == 0) {
+                if (!parse_target_profile(&cpu_profile, argv[i + 1])) {
+                    return 1;
+                }
+                cpu_set = true;
+                i++;
+            } else if (strcmp(argv[i], "--mem-profile") == 0) {
+                if (!parse_target_profile(&mem_profile, argv[i + 1])) {
                     return 1;
                 }
-                // 转换百分比为MB，但不使用int强制转换
-                target_mem_usage_mb = (int)(mem_percent * total_system_memory_mb / 100.0 + 0.5); // 加0.5进行四舍五入
                 mem_set = true;
                 i++;
+            } else if (strcmp(argv[i], "--refresh") == 0) {
+                refresh_hz = atof(argv[i + 1]);
+                if (refresh_hz < 0.1 || refresh_hz > 50) {
+                    printf("刷新频率必须在0.1-50 Hz之间\n");
+                    return 1;
+                }
+                i++;
+            } else if (strcmp(argv[i], "--metrics-port") == 0) {
+                metrics_port = atoi(argv[i + 1]);
+                if (metrics_port < 1 || metrics_port > 65535) {
+                    printf("指标导出端口必须在1-65535之间\n");
+                    return 1;
+                }
+                i++;
+            } else if (strcmp(argv[i], "--metrics-addr") == 0) {
+                strncpy(metrics_addr, argv[i + 1], sizeof(metrics_addr) - 1);
+                i++;
+            } else if (strcmp(argv[i], "--cpu-groups") == 0) {
+                if (!parse_cpu_groups(argv[i + 1])) {
+                    return 1;
+                }
+                i++;
                 // 已移除 -p, -i, -d(old), -f, -u 参数的处理
             } else {
                 printf("未知参数: %s\n", argv[i]);
@@ -1518,6 +7040,13 @@ int main(int argc, char *argv[]) {
         }
     }
     
+    // 运行基准测试
+    if (bench_name) {
+        int ret = run_benchmark(bench_name);
+        sampler_close();
+        return ret;
+    }
+    
     // 检查必需参数
     if (!load_config_specified && (!cpu_set || !mem_set)) {
         printf("错误: 必须指定CPU和内存使用率或加载配置文件\n");
@@ -1525,8 +7054,34 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
-    // 设置信号处理
+    // 检测cgroup限制；按cgroup计算时重新采样，内存总量等改为cgroup的数值
+    cgroup_init();
+    if (cgroup.detected) {
+        char limit_str[32] = "不限制";
+        if (cgroup.memory_max > 0) format_size(limit_str, sizeof(limit_str), cgroup.memory_max);
+        printf("cgroup: %s (CPU限制: ", cgroup.path);
+        if (cgroup.cpu_limit > 0) printf("%.2f核心", cgroup.cpu_limit);
+        else printf("不限制");
+        printf(", 内存限制: %s)，目标按%s计算\n", limit_str, cgroup.active ? "cgroup" : "主机");
+        if (cgroup.active) sampler_update();
+    } else if (target_scope == SCOPE_CGROUP) {
+        printf("未检测到cgroup v2，目标按主机计算\n");
+    }
+    
+    // 有目标曲线时以曲线起点的值作为初始目标
+    if (cpu_profile.kind != PROFILE_NONE) {
+        target_cpu_usage = (int)(profile_value(&cpu_profile, 0.0) + 0.5);
+    }
+    if (mem_profile.kind != PROFILE_NONE) {
+        mem_target.kind = MEM_TARGET_PERCENT;
+        mem_target.value = profile_value(&mem_profile, 0.0);
+    }
+    unsigned long long total_system_memory_mb = get_total_system_memory();
+    target_mem_usage_mb = (int)(mem_target_bytes(&mem_target, total_system_memory_mb * 1024) / (1024 * 1024));
+    
+    // 设置信号处理，-k发送的SIGTERM同样正常退出，恢复调整过的设置
     signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
     
     // 处理后台运行模式
     if (daemon_mode) {
@@ -1586,23 +7141,139 @@ int main(int argc, char *argv[]) {
         open("/dev/null", O_RDWR);
         dup(0);
         dup(0);
+        
+        sampler_reopen_self();
 #endif
     }
     
-    printf("目标: CPU使用率 %d%%, MEM使用率 %d%%\n", 
-           target_cpu_usage, 
-           (int)(target_mem_usage_mb * 100.0 / get_total_system_memory() + 0.5)); // 加0.5进行四舍五入
+    char mem_target_str[64];
+    format_mem_target(mem_target_str, sizeof(mem_target_str), &mem_target);
+    printf("目标: CPU使用率 %d%%, MEM %s (%d MB, %.1f%%)\n",
+           target_cpu_usage, mem_target_str, target_mem_usage_mb,
+           total_system_memory_mb ? target_mem_usage_mb * 100.0 / total_system_memory_mb : 0.0);
+    if (num_node_mems == 0 && mem_profile.kind == PROFILE_NONE) {
+        mem_floor_clamp((unsigned long long)target_mem_usage_mb * 1024 * 1024, total_system_memory_mb * 1024, "");
+    }
+    
+    // 初始化每个核心的控制状态；cgroup的CPU配额只够ceil(配额)个核心，多出的工作线程只会被限流
+    int max_workers = 0;
+    if (cgroup.detected && cgroup.cpu_limit > 0) max_workers = (int)ceil(cgroup.cpu_limit);
+    if (!init_core_ctrls(max_workers)) {
+        printf("内存分配失败\n");
+        return 1;
+    }
     
+    cgroup_set_capacity(num_cpu_cores);
     printf("检测到CPU核心数: %d\n", num_cpu_cores);
+    if (cgroup.active) {
+        printf("cgroup CPU容量: %.2f核心，每个工作线程最多占用核心的%.0f%%\n",
+               cgroup.capacity, cpu_share_scale * 100.0);
+    }
+    numa_init();
+    if (num_numa_nodes > 1) {
+        printf("NUMA节点:");
+        for (int i = 0; i < num_numa_nodes; i++) {
+            printf(" node%d(%d核心, %.1f GB)", numa_nodes[i].id, numa_nodes[i].num_cpus,
+                   numa_nodes[i].mem_total_kb / (1024.0 * 1024.0));
+        }
+        printf("\n");
+    }
+    if (num_node_mems > 0) {
+        if (mem_profile.kind != PROFILE_NONE) {
+            printf("--mem-node不能与内存目标曲线同时使用\n");
+            return 1;
+        }
+        for (int i = 0; i < num_node_mems; i++) {
+            if (find_numa_node(node_mems[i].node) < 0) {
+                printf("NUMA节点%d不存在\n", node_mems[i].node);
+                return 1;
+            }
+        }
+        printf("节点内存目标: %s (代替-m)\n", mem_node_spec);
+    }
+    if (num_cpu_groups > 0) {
+        printf("核心分组目标: %s (总体目标: %.1f%%)\n", cpu_groups_spec, get_overall_cpu_target());
+    }
+    if (cpu_profile.kind != PROFILE_NONE) printf("CPU目标曲线: %s\n", cpu_profile.spec);
+    if (mem_profile.kind != PROFILE_NONE) printf("内存目标曲线: %s\n", mem_profile.spec);
     
     // 预热CPU使用率检测
-    get_system_cpu_usage();
+    sampler_update();
 #ifdef _WIN32
     Sleep(1000);
 #else
     usleep(1000 * 1000);
 #endif
-      // 创建CPU负载调整线程
+
+    // 回放轨迹或读取其他proc目录时指标不反映本进程的占用，压载区只记账，不占用本机内存
+    if (replay_file[0] || strcmp(proc_root, "/proc") != 0) {
+        ballast.simulated = true;
+        printf("指标源: %s (%s)，压载区仅记账\n", sampler.source->name,
+               replay_file[0] ? replay_file : proc_root);
+    }
+    
+    // 内存耗尽时让OOM killer首先选中CMM，压载随进程一起释放
+    if (!ballast.simulated && memory_target_enabled()) oom_harden();
+    
+    // 预留与物理内存等大的压载区地址空间，后续按页增长和收缩
+#ifdef _WIN32
+    if (ballast_backing == BALLAST_MEMFD) {
+        printf("Windows上不支持memfd压载，使用匿名内存\n");
+        ballast_backing = BALLAST_ANON;
+    }
+#endif
+    if (!ballast_init(&ballast, (size_t)get_total_system_memory() * 1024 * 1024)) {
+        printf("预留内存压载区失败\n");
+        return 1;
+    }
+#ifndef _WIN32
+    if (ballast.fd >= 0) {
+        printf("压载内存来源: memfd (/proc/%d/fd/%d)\n", (int)getpid(), ballast.fd);
+    }
+#endif
+    
+    // 多个NUMA节点时压载页默认交错分布，避免全部落在某一个节点上
+    unsigned long long memory_nodes = 0;
+    for (int i = 0; i < num_numa_nodes; i++) {
+        if (numa_nodes[i].mem_total_kb > 0) memory_nodes |= 1ULL << numa_nodes[i].id;
+    }
+    if (numa_policy == NUMA_POLICY_INTERLEAVE ||
+        (numa_policy == NUMA_POLICY_DEFAULT && num_numa_nodes > 1 && (memory_nodes & (memory_nodes - 1)))) {
+        if (ballast_set_mempolicy(&ballast, MPOL_INTERLEAVE, memory_nodes ? memory_nodes : 1) && verbose_mode) {
+            printf("压载区交错分布到所有有内存的NUMA节点\n");
+        }
+    } else if (numa_policy == NUMA_POLICY_BIND) {
+        if (!ballast_set_mempolicy(&ballast, MPOL_BIND, numa_bind_mask)) {
+            return 1;
+        }
+    }
+    
+    // 每个指定了目标的节点使用独立的压载区，绑定到该节点
+    for (int i = 0; i < num_node_mems; i++) {
+        node_mem_t* nm = &node_mems[i];
+        const numa_node_t* n = &numa_nodes[find_numa_node(nm->node)];
+        if (ballast.simulated) {
+            printf("回放或读取其他proc目录时不支持--mem-node\n");
+            return 1;
+        }
+        if (!ballast_init(&nm->arena, (size_t)n->mem_total_kb * 1024) ||
+            !ballast_set_mempolicy(&nm->arena, MPOL_BIND, 1ULL << nm->node)) {
+            printf("预留NUMA节点%d的压载区失败\n", nm->node);
+            return 1;
+        }
+    }
+    if (!fill_pool_start(fill_threads)) {
+        return 1;
+    }
+    if (!metrics_start(metrics_port, metrics_addr)) {
+        return 1;
+    }
+
+    // 所有工作线程共用同一个截止时间网格原点，目标曲线也从此刻开始
+    pwm_epoch_ns = get_time_ns();
+    profile_epoch = get_monotonic_time();
+    
+    // 创建CPU负载调整线程
 #ifdef _WIN32
     HANDLE adjust_thread = CreateThread(NULL, 0, 
                                  (LPTHREAD_START_ROUTINE)adjust_cpu_load_thread, 
@@ -1619,6 +7290,12 @@ int main(int argc, char *argv[]) {
     }
 #endif
     
+    // 让出CPU的工作线程还需要避开自动分组的会话间平分
+    if (worker_sched != WORKER_SCHED_NORMAL) {
+        printf("工作线程调度策略: %s\n", worker_sched_names[worker_sched]);
+        autogroup_yield();
+    }
+    
     // 创建多个CPU占用线程，每个核心一个
 #ifdef _WIN32
     HANDLE *cpu_threads = (HANDLE *)malloc(num_cpu_cores * sizeof(HANDLE));
@@ -1659,81 +7336,32 @@ int main(int argc, char *argv[]) {
         }
     }
 #endif
-      // 主循环，处理内存分配并显示状态
+    wake_probe_start();
+    backoff_start();
+    watchdog_start();
+    
+    // 主循环: 内存控制每update_interval秒一步，状态画面按--refresh频率刷新
+    if (!daemon_mode && !status_renderer_init(&status_renderer)) {
+        printf("内存分配失败\n");
+        return 1;
+    }
+    double next_memory_step = 0.0;
     while (running) {
-        allocate_memory();
+        double now = get_monotonic_time();
+        if (now >= next_memory_step) {
+            allocate_memory();
+            next_memory_step = now + update_interval;
+        }
         
         // 非后台模式下显示状态
         if (!daemon_mode) {
-            // 清屏以更新状态显示
-            clear_screen();
-              // 生成CPU和内存进度条
-            char cpu_bar[128] = {0};
-            char mem_bar[128] = {0};
-            
-            // 基本状态信息
-            printf("\n==================== 系统状态 ====================\n");
-            
-            // 显示当前时间
-            time_t now = time(NULL);
-            struct tm *timeinfo = localtime(&now);
-            char timestr[20];
-            strftime(timestr, sizeof(timestr), "%Y-%m-%d %H:%M:%S", timeinfo);
-            printf("当前时间: %s\n\n", timestr);
-            
-            // 获取并处理CPU使用率，当接近目标值时显示目标值
-            double display_cpu_usage = current_cpu_load;
-            if (display_cpu_usage > target_cpu_usage * 0.95 && display_cpu_usage < target_cpu_usage * 1.05) {
-                display_cpu_usage = target_cpu_usage;
-            }
-            
-            // 获取并处理内存使用率，当接近目标值时显示目标值
-            double display_mem_usage = get_system_mem_usage();
-            int target_mem_percent = (int)(target_mem_usage_mb * 100.0 / get_total_system_memory() + 0.5);
-            if (display_mem_usage > target_mem_percent * 0.95 && display_mem_usage < target_mem_percent * 1.05) {
-                display_mem_usage = target_mem_percent;
-            }
-            
-            // 生成进度条
-            generate_progress_bar(cpu_bar, sizeof(cpu_bar), display_cpu_usage, 30);
-            generate_progress_bar(mem_bar, sizeof(mem_bar), display_mem_usage, 30);
-            
-            // 获取自身资源占用情况
-            double self_cpu = get_self_cpu_usage();
-            unsigned long long self_mem_mb = get_self_memory_usage_mb();
-            unsigned long long total_mem_mb = get_total_system_memory();
-            double self_mem_percent = (double)self_mem_mb * 100.0 / total_mem_mb;
-            
-            // 计算系统占用率（不包含CMM自身）
-            double system_cpu = display_cpu_usage - self_cpu;
-            double system_mem = display_mem_usage - self_mem_percent;
-            
-            // 确保显示值不为负
-            if (system_cpu < 0) system_cpu = 0;
-            if (system_mem < 0) system_mem = 0;
-            
-            // 显示CPU和内存使用情况
-            printf("CPU: %s (目标：%d%%, 系统：%.1f%%, CMM：%.1f%%)\n", 
-                   cpu_bar, target_cpu_usage, system_cpu, self_cpu);
-            printf("MEM: %s (目标：%d%%, 系统：%.1f%%, CMM：%.1f%%)\n",
-                   mem_bar, target_mem_percent, system_mem, self_mem_percent);
-            
-            // 详细模式下显示更多信息
-            if (verbose_mode) {                printf("详细信息: CPU占用=%6.2f%%, 控制=%3d%%, 滤波值=%.1f%%, MEM占用=%.1f%%, 滤波值=%.1f%%\n",
-                       current_cpu_load, busy_percentage, filtered_cpu_usage, 
-                       get_system_mem_usage(), filtered_mem_usage);
-                printf("控制参数: PID(%.2f, %.2f, %.2f), 滤波系数: %.2f, CPU核心: %d\n",
-                       pid_kp, pid_ki, pid_kd, filter_alpha, num_cpu_cores);
-            }
-            
-            printf("\n=====================================================\n");
+            status_render(&status_renderer);
         }
         
-        // 使用配置的更新间隔
 #ifdef _WIN32
-        Sleep(update_interval * 1000); 
+        Sleep((DWORD)(1000.0 / refresh_hz));
 #else
-        sleep(update_interval);
+        usleep((useconds_t)(1000000.0 / refresh_hz));
 #endif
     }
     
@@ -1748,21 +7376,38 @@ int main(int argc, char *argv[]) {
     for (int i = 0; i < num_cpu_cores; i++) {
         CloseHandle(cpu_threads[i]);
     }
-    DeleteCriticalSection(&cpu_load_cs);
 #else
     pthread_join(adjust_thread, NULL);
     for (int i = 0; i < num_cpu_cores; i++) {
         pthread_cancel(cpu_threads[i]);
         pthread_join(cpu_threads[i], NULL);
     }
-    pthread_mutex_destroy(&cpu_load_mutex);
 #endif
+    watchdog_stop();
+    backoff_stop();
+    wake_probe_stop();
+    autogroup_restore();
+    metrics_stop();
+    sampler_close();
+    cgroup_close();
+    fill_pool_stop();
+    ballast_destroy(&ballast);
+    for (int i = 0; i < num_node_mems; i++) {
+        ballast_destroy(&node_mems[i].arena);
+    }
 
     // 释放内存
     if (cpu_threads != NULL) {
         free(cpu_threads);
         cpu_threads = NULL;
     }
+    free(core_ctrls);
+    core_ctrls = NULL;
+    free_cache_aligned(workers);
+    workers = NULL;
+    free_target_profile(&cpu_profile);
+    free_target_profile(&mem_profile);
+    status_renderer_free(&status_renderer);
     
     printf("\n程序已退出\n");    
     return 0;